@@ -0,0 +1,127 @@
+/*==============================================================================
+ * GPIO_Bench.cpp -- Microbenchmark of the GPIO_Class.h pin classes on a 32-pin
+ * component.  Not a C-Block; build & run it as a console program, e.g.:
+ *
+ *   cl /O2 /EHsc /std:c++17 GPIO_Bench.cpp
+ *   GPIO_Bench
+ *
+ * Each pass toggles the TRIS & latch of all 32 pins and reads them back (the
+ * usual evaluation function pattern) through:
+ *
+ *   - GPIO_Pin_T via makeGpioPinPtr() (heap-allocated, virtual calls),
+ *   - GPIO_PinS (by value, CRTP -- no virtual calls),
+ *   - GPIO_PinV (by value, std::variant dispatch), and
+ *   - GPIO_Port<double, uint32_t> (whole-port register writes).
+ *
+ * Note:  Requires C++17 or newer.
+ *============================================================================*/
+#include <chrono>
+#include <cstdio>
+
+#include "GPIO_Class.h"
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const int NbrPins   = 32;
+const int NbrPasses = 2000000;
+
+/*------------------------------------------------------------------------------
+ * Port data -- laid out like the QSpice uData array (input, output, control
+ * for each pin, then VCC).
+ *----------------------------------------------------------------------------*/
+struct PinData {
+  double in;
+  double out;
+  bool   ctl;
+};
+
+PinData pins[NbrPins];
+double  vcc = 3.3;
+
+// defeat the optimizer -- results go here
+volatile unsigned int sink;
+
+/*------------------------------------------------------------------------------
+ * timeIt() -- run pass(i) NbrPasses times and report ns per pin update.
+ *----------------------------------------------------------------------------*/
+template <typename F> double timeIt(const char *name, F pass) {
+  auto         start = std::chrono::steady_clock::now();
+  unsigned int acc   = 0;
+  for (int i = 0; i < NbrPasses; i++) acc += pass(i);
+  auto stop = std::chrono::steady_clock::now();
+  sink      = acc;
+
+  double ns = std::chrono::duration<double, std::nano>(stop - start).count() /
+              (double(NbrPasses) * NbrPins);
+  printf("%-28s %6.2f ns/pin\n", name, ns);
+  return ns;
+}
+
+int main() {
+  // pin inputs alternate high/low
+  for (int n = 0; n < NbrPins; n++) pins[n].in = n & 1 ? vcc : 0.0;
+
+  // current virtual pins
+  GPIO_Pin_Ptr vPins[NbrPins];
+  for (int n = 0; n < NbrPins; n++)
+    vPins[n] = makeGpioPinPtr(pins[n].in, pins[n].out, pins[n].ctl, vcc);
+
+  // by-value pins
+  GPIO_PinS<double> sPins[NbrPins];
+  GPIO_PinV         xPins[NbrPins];
+  for (int n = 0; n < NbrPins; n++) {
+    sPins[n].bind(pins[n].in, pins[n].out, pins[n].ctl, vcc);
+    xPins[n].bind(pins[n].in, pins[n].out, pins[n].ctl, vcc);
+  }
+
+  // whole port
+  GPIO_Port<double, uint32_t> port;
+  for (int n = 0; n < NbrPins; n++)
+    port.bindPin(n, pins[n].in, pins[n].out, pins[n].ctl, vcc);
+
+  printf("%d pins, %d passes\n", NbrPins, NbrPasses);
+
+  double tV = timeIt("GPIO_Pin_T (virtual)", [&](int i) {
+    unsigned int val = 0;
+    for (int n = 0; n < NbrPins; n++) {
+      vPins[n]->setTris((i + n) & 1);
+      vPins[n]->writePort((i >> 1) & 1);
+      val += vPins[n]->readPort();
+    }
+    return val;
+  });
+
+  double tS = timeIt("GPIO_PinS (CRTP)", [&](int i) {
+    unsigned int val = 0;
+    for (int n = 0; n < NbrPins; n++) {
+      sPins[n].setTris((i + n) & 1);
+      sPins[n].writePort((i >> 1) & 1);
+      val += sPins[n].readPort();
+    }
+    return val;
+  });
+
+  double tX = timeIt("GPIO_PinV (variant)", [&](int i) {
+    unsigned int val = 0;
+    for (int n = 0; n < NbrPins; n++) {
+      xPins[n].setTris((i + n) & 1);
+      xPins[n].writePort((i >> 1) & 1);
+      val += xPins[n].readPort();
+    }
+    return val;
+  });
+
+  double tP = timeIt("GPIO_Port (registers)", [&](int i) {
+    port.writeTris(i & 1 ? 0xaaaaaaaa : 0x55555555);
+    port.writeLatch((i >> 1) & 1 ? 0xffffffff : 0);
+    return unsigned(port.readPort());
+  });
+
+  printf("speedup vs virtual:  CRTP %.1fx, variant %.1fx, port %.1fx\n",
+      tV / tS, tV / tX, tV / tP);
+  return 0;
+}
+/*==============================================================================
+ * End of GPIO_Bench.cpp
+ *============================================================================*/
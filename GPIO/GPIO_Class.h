@@ -14,7 +14,9 @@
 #ifndef GPIO_CLASS_H
 #define GPIO_CLASS_H
 
+#include <cstdint>
 #include <memory>
+#include <variant>
 
 /*------------------------------------------------------------------------------
  * I'm following Microchip PIC uC conventions for TRIS direction and including a
@@ -95,6 +97,474 @@ GPIO_Pin_Ptr makeGpioPinPtr(
   return GPIO_Pin_Ptr(new GPIO_Pin_T(inPort, outPort, ctlPort, refPort));
 }
 
+/*------------------------------------------------------------------------------
+ * GPIO_PinBase class template -- CRTP base for GPIO pins stored by value (e.g.,
+ * as InstData members).  Same semantics as GPIO_Pin_T but calls are resolved
+ * at compile time (no vtable) and there's no heap allocation per pin.  The
+ * derived class provides sense(), drive(), and control() for its port types.
+ *----------------------------------------------------------------------------*/
+template <typename Derived> class GPIO_PinBase {
+public:
+  inline void setTris(bool dir) {
+    tris = dir;
+    self().control(dir);
+  }
+
+  inline bool readPort() const { return self().sense(); }
+
+  inline bool readLatch() const { return latch; }
+
+  inline void writePort(bool state) {
+    latch = state;
+    self().drive(state);
+  }
+
+protected:
+  inline Derived       &self() { return static_cast<Derived &>(*this); }
+  inline const Derived &self() const {
+    return static_cast<const Derived &>(*this);
+  }
+
+  bool tris  = TRIS_IN;
+  bool latch = false;
+};
+
+/*------------------------------------------------------------------------------
+ * GPIO_PinS class template -- by-value pin for port data type T.  Since
+ * InstData is allocated before the ports are known, ports are attached with
+ * bind() rather than the constructor.
+ *----------------------------------------------------------------------------*/
+template <typename T> class GPIO_PinS : public GPIO_PinBase<GPIO_PinS<T>> {
+  friend class GPIO_PinBase<GPIO_PinS<T>>;
+
+public:
+  GPIO_PinS() {}
+
+  void bind(const T &inPort, T &outPort, bool &ctlPort, const double &refPort) {
+    this->inPort  = &inPort;
+    this->outPort = &outPort;
+    this->ctlPort = &ctlPort;
+    this->refPort = &refPort;
+    this->setTris(TRIS_IN);
+  }
+
+protected:
+  inline bool sense() const { return double(*inPort) > (*refPort / 2.0); }
+  inline void drive(bool state) { *outPort = T(state * *refPort); }
+  inline void control(bool dir) { *ctlPort = dir; }
+
+  const T      *inPort  = nullptr;
+  T            *outPort = nullptr;
+  bool         *ctlPort = nullptr;
+  const double *refPort = nullptr;
+};
+
+/*------------------------------------------------------------------------------
+ * GPIO_PinV class -- by-value pin of any of the common port data types for
+ * arrays of mixed pins.  Calls dispatch through std::visit (a switch on the
+ * held type) rather than a vtable.
+ *----------------------------------------------------------------------------*/
+class GPIO_PinV {
+public:
+  GPIO_PinV() {}
+
+  template <typename T>
+  void bind(const T &inPort, T &outPort, bool &ctlPort, const double &refPort) {
+    pin.emplace<GPIO_PinS<T>>().bind(inPort, outPort, ctlPort, refPort);
+  }
+
+  inline void setTris(bool dir) {
+    std::visit([dir](auto &p) { p.setTris(dir); }, pin);
+  }
+
+  inline bool readPort() const {
+    return std::visit([](const auto &p) { return p.readPort(); }, pin);
+  }
+
+  inline bool readLatch() const {
+    return std::visit([](const auto &p) { return p.readLatch(); }, pin);
+  }
+
+  inline void writePort(bool state) {
+    std::visit([state](auto &p) { p.writePort(state); }, pin);
+  }
+
+protected:
+  std::variant<GPIO_PinS<double>, GPIO_PinS<float>, GPIO_PinS<bool>,
+      GPIO_PinS<int>>
+      pin;
+};
+
+/*------------------------------------------------------------------------------
+ * Interrupt-on-change edge selection (PIC IOCxP/IOCxN style).  (Note the
+ * "IOC_" prefix -- the SpiIO PinIO.h header claims RISING/FALLING.)
+ *----------------------------------------------------------------------------*/
+enum GPIO_IocEdge { IOC_OFF, IOC_RISING, IOC_FALLING, IOC_BOTH };
+
+/*------------------------------------------------------------------------------
+ * GPIO_Event -- a captured pin edge.  The time is the interpolated threshold
+ * crossing, not the evaluation time at which the edge was seen.
+ *----------------------------------------------------------------------------*/
+struct GPIO_Event {
+  double t;        // edge time
+  int    pin;      // pin (register bit) #
+  bool   rising;   // true = rising edge, false = falling edge
+};
+
+/*------------------------------------------------------------------------------
+ * GPIO_EventQueue class template -- fixed-size (power of 2) ring buffer of
+ * edge events.  When full, new events are dropped and counted.
+ *----------------------------------------------------------------------------*/
+template <int Size = 64> class GPIO_EventQueue {
+  static_assert((Size & (Size - 1)) == 0, "Size must be a power of 2");
+
+public:
+  inline bool     isEmpty() const { return head == tail; }
+  inline int      count() const { return int(head - tail); }
+  inline uint32_t getOverflows() const { return overflows; }
+
+  bool push(const GPIO_Event &ev) {
+    if (count() == Size) {
+      overflows++;
+      return false;
+    }
+    buf[head++ & (Size - 1)] = ev;
+    return true;
+  }
+
+  bool pop(GPIO_Event &ev) {
+    if (isEmpty()) return false;
+    ev = buf[tail++ & (Size - 1)];
+    return true;
+  }
+
+  void clear() { head = tail = 0; }
+
+protected:
+  GPIO_Event buf[Size];
+  uint32_t   head      = 0;
+  uint32_t   tail      = 0;
+  uint32_t   overflows = 0;
+};
+
+/*------------------------------------------------------------------------------
+ * GPIO_Port class template -- a whole port of up to 8/16/32 pins (register type
+ * R) with PIC-style TRIS, LAT, and PORT registers.  Bit n of each register is
+ * pin n.
+ *
+ * Pin port references are kept in contiguous arrays and there are no virtual
+ * calls.  Register writes update only the pins whose bits changed, all in one
+ * pass, so firmware-style register writes (e.g., LATA = 0x05 or TRISA &= ~0x03)
+ * map directly to one call.  Pin semantics are the same as GPIO_Pin_T:  the
+ * output port follows the latch and the control port follows TRIS.
+ *
+ * Interrupt-on-change:  IOCP/IOCN select rising/falling edge capture per pin.
+ * Call scanIoc() once per evaluation; it checks only the IOC-enabled pins,
+ * sets their IOCF flag bits, and queues timestamped edge events for the
+ * component to drain with popEvent().
+ *----------------------------------------------------------------------------*/
+template <typename T, typename R = uint8_t> class GPIO_Port {
+public:
+  static const int maxPins = int(sizeof(R) * 8);
+
+  GPIO_Port() {}
+
+  // bind pin n to its ports; the pin starts as an input
+  void bindPin(int n, const T &inPort, T &outPort, bool &ctlPort,
+      const double &refPort) {
+    if (n < 0 || n >= maxPins) return;
+    this->inPort[n]  = &inPort;
+    this->outPort[n] = &outPort;
+    this->ctlPort[n] = &ctlPort;
+    this->refPort[n] = &refPort;
+    bound |= R(1) << n;
+    tris |= R(1) << n;
+    ctlPort = TRIS_IN;
+  }
+
+  /*----------------------------------------------------------------------------
+   * TRIS register (1 = input, 0 = output)
+   *--------------------------------------------------------------------------*/
+  void writeTris(R val) { updateTris(val); }
+
+  void writeTris(R mask, R val) { updateTris((tris & ~mask) | (val & mask)); }
+
+  void setTris(R mask) { updateTris(tris | mask); }
+
+  void clearTris(R mask) { updateTris(tris & ~mask); }
+
+  R readTris() const { return tris; }
+
+  /*----------------------------------------------------------------------------
+   * LAT register.  (Writing PORT writes the latch as on a PIC.)
+   *--------------------------------------------------------------------------*/
+  void writeLatch(R val) { updateLatch(val); }
+
+  void writeLatch(R mask, R val) {
+    updateLatch((latch & ~mask) | (val & mask));
+  }
+
+  void setLatch(R mask) { updateLatch(latch | mask); }
+
+  void clearLatch(R mask) { updateLatch(latch & ~mask); }
+
+  void toggleLatch(R mask) { updateLatch(latch ^ mask); }
+
+  R readLatch() const { return latch; }
+
+  void writePort(R val) { updateLatch(val); }
+
+  /*----------------------------------------------------------------------------
+   * PORT register -- the (possibly loaded) states present on the pins
+   *--------------------------------------------------------------------------*/
+  R readPort() const {
+    R val = 0;
+    for (int n = 0; n < maxPins; n++)
+      if (bound & (R(1) << n))
+        val |= R(double(*inPort[n]) > (*refPort[n] / 2.0)) << n;
+    return val;
+  }
+
+  /*----------------------------------------------------------------------------
+   * IOCP/IOCN (edge enables) & IOCF (edge flags) registers
+   *--------------------------------------------------------------------------*/
+  void writeIocPos(R val) { iocp = val; }
+
+  void writeIocNeg(R val) { iocn = val; }
+
+  void setIoc(int n, GPIO_IocEdge edge) {
+    R bit = R(1) << n;
+    iocp  = edge == IOC_RISING || edge == IOC_BOTH ? iocp | bit : iocp & ~bit;
+    iocn  = edge == IOC_FALLING || edge == IOC_BOTH ? iocn | bit : iocn & ~bit;
+  }
+
+  R readIocPos() const { return iocp; }
+
+  R readIocNeg() const { return iocn; }
+
+  R readIocFlags() const { return iocf; }
+
+  void clearIocFlags(R mask) { iocf &= ~mask; }
+
+  /*----------------------------------------------------------------------------
+   * scanIoc() -- detect edges on the IOC-enabled pins since the last scan.
+   * Edge times are interpolated linearly between the last & current samples
+   * of the pin voltage.  Returns the # of edges queued.
+   *--------------------------------------------------------------------------*/
+  int scanIoc(double t) {
+    R          enabled = (iocp | iocn) & bound;
+    GPIO_Event edges[maxPins];
+    int        nbrEdges = 0;
+
+    for (int n = 0; n < maxPins && (enabled >> n); n++) {
+      R bit = R(1) << n;
+      if (!(enabled & bit)) continue;
+
+      double v     = double(*inPort[n]);
+      double vTh   = *refPort[n] / 2.0;
+      bool   state = v > vTh;
+      bool   last  = (iocState & bit) != 0;
+      double vLast = iocV[n];
+      iocV[n]      = v;
+      if (!(iocTracked & bit) || state == last) {   // new pin or no edge
+        iocState = state ? iocState | bit : iocState & ~bit;
+        continue;
+      }
+      iocState ^= bit;
+
+      if (!((state ? iocp : iocn) & bit)) continue;
+
+      double tc = t;
+      if (t > iocT && v != vLast)
+        tc = iocT + (vTh - vLast) / (v - vLast) * (t - iocT);
+      iocf |= bit;
+
+      // insertion sort -- events are queued in time order
+      int i = nbrEdges++;
+      for (; i > 0 && edges[i - 1].t > tc; i--) edges[i] = edges[i - 1];
+      edges[i] = {tc, n, state};
+    }
+    iocT       = t;
+    iocTracked = enabled;
+
+    for (int i = 0; i < nbrEdges; i++) events.push(edges[i]);
+    return nbrEdges;
+  }
+
+  inline bool popEvent(GPIO_Event &ev) { return events.pop(ev); }
+
+  inline bool hasEvents() const { return !events.isEmpty(); }
+
+  inline uint32_t getEventOverflows() const { return events.getOverflows(); }
+
+  // rewrite all outputs (e.g., after the reference voltage changes)
+  void refresh() {
+    for (int n = 0; n < maxPins; n++) {
+      if (!(bound & (R(1) << n))) continue;
+      *outPort[n] = T(((latch >> n) & 1) * *refPort[n]);
+      *ctlPort[n] = (tris >> n) & 1;
+    }
+  }
+
+protected:
+  void updateTris(R val) {
+    R changed = (val ^ tris) & bound;
+    tris      = val;
+    for (int n = 0; changed; n++, changed >>= 1)
+      if (changed & 1) *ctlPort[n] = (tris >> n) & 1;
+  }
+
+  void updateLatch(R val) {
+    R changed = (val ^ latch) & bound;
+    latch     = val;
+    for (int n = 0; changed; n++, changed >>= 1)
+      if (changed & 1) *outPort[n] = T(((latch >> n) & 1) * *refPort[n]);
+  }
+
+  const T      *inPort[maxPins]  = {};
+  T            *outPort[maxPins] = {};
+  bool         *ctlPort[maxPins] = {};
+  const double *refPort[maxPins] = {};
+  R             bound            = 0;   // pins bound to ports
+  R             tris             = 0;
+  R             latch            = 0;
+
+  // interrupt-on-change
+  R                   iocp          = 0;    // rising edge enables
+  R                   iocn          = 0;    // falling edge enables
+  R                   iocf          = 0;    // edge flags
+  R                   iocState      = 0;    // pin states at last scan
+  R                   iocTracked    = 0;    // pins sampled at last scan
+  double              iocV[maxPins] = {};   // pin voltages at last scan
+  double              iocT          = 0;    // time of last scan
+  GPIO_EventQueue<64> events;               // captured edges
+};
+
+/*------------------------------------------------------------------------------
+ * GPIO_Pwm class template -- PWM peripheral driving a pin, or a complementary
+ * pair of pins with dead time, of pin type P (GPIO_PinS, GPIO_PinV, or
+ * GPIO_Pin).
+ *
+ * Period, duty, and dead time are in ticks of the PWM clock.  Per period:
+ *
+ *   tick 0              low-side pin off
+ *   tick deadTime       high-side pin on
+ *   tick duty           high-side pin off
+ *   tick duty+deadTime  low-side pin on
+ *   tick period         (next period)
+ *
+ * i.e., dead time delays each pin's turn-on.  Duty & period changes take
+ * effect at the start of the next period (like double-buffered hardware).
+ *
+ * Edge times are calculated from the tick count (t0 + tick / tickFreq) so
+ * there's no drift.  Return nextEdgeTime() - t from MaxExtStepSize() and clip
+ * the Trunc() timestep to it and the edges land exactly without a fast clock
+ * waveform driving the solver.
+ *----------------------------------------------------------------------------*/
+template <typename P> class GPIO_Pwm {
+public:
+  void init(
+      double tickFreq, uint32_t period, uint32_t duty, uint32_t deadTime) {
+    this->tickFreq = tickFreq;
+    this->deadTime = deadTime;
+    setPeriod(period);
+    setDuty(duty);
+  }
+
+  // attach the output pin(s) and set them as outputs (off)
+  void attach(P *pinH, P *pinL = nullptr) {
+    this->pinH = pinH;
+    this->pinL = pinL;
+    for (P *pin : {pinH, pinL}) {
+      if (!pin) continue;
+      pin->writePort(false);
+      pin->setTris(TRIS_OUT);
+    }
+  }
+
+  void setPeriod(uint32_t period) { nextPeriod = period ? period : 1; }
+
+  void setDuty(uint32_t duty) { nextDuty = duty; }
+
+  // start a period at time t
+  void start(double t) {
+    t0      = t;
+    running = true;
+    lOn     = false;
+    startPeriod(0);
+  }
+
+  // stop with both pins off
+  void stop() {
+    running = false;
+    lOn     = false;
+    drive(pinH, false);
+    drive(pinL, false);
+  }
+
+  inline bool isRunning() const { return running; }
+
+  inline double nextEdgeTime() const {
+    return running ? t0 + edges[edge] / tickFreq : eternity;
+  }
+
+  // process all edges at or before t
+  void update(double t) {
+    while (running && t >= t0 + (edges[edge] - tickTol) / tickFreq) {
+      switch (edge) {
+      case 0: drive(pinH, true); break;
+      case 1: drive(pinH, false); break;
+      case 2: drive(pinL, true); break;
+      case 3: startPeriod(edges[3]); continue;
+      }
+      edge++;
+    }
+  }
+
+protected:
+  static constexpr double eternity = 1.7e308;
+  static constexpr double tickTol  = 1e-6;   // edge time tolerance (ticks)
+
+  // latch duty & period and schedule the edges for the period at tick.  the
+  // dead time precedes an output's on edge only if the complementary output
+  // was on, i.e., not at 0%/100% duty or without a low-side pin.
+  void startPeriod(uint64_t tick) {
+    period = nextPeriod;
+    duty   = nextDuty < period ? nextDuty : period;
+
+    drive(pinL, false);
+    edges[0] = tick + (lOn ? deadTime : 0);
+    edges[1] = tick + duty;
+    edges[2] = tick + duty + (pinL && duty ? deadTime : 0);
+    edges[3] = tick + period;
+
+    // skip edges swallowed by the dead time (or 0%/100% duty) -- an on edge
+    // at the off edge's tick is undone in the same update()
+    if (edges[0] >= edges[1]) edges[0] = edges[1];
+    if (edges[2] >= edges[3]) edges[2] = edges[3];
+    lOn  = pinL && edges[2] < edges[3];
+    edge = 0;
+  }
+
+  inline void drive(P *pin, bool state) {
+    if (pin) pin->writePort(state);
+  }
+
+  P       *pinH       = nullptr;
+  P       *pinL       = nullptr;
+  double   tickFreq   = 1.0;
+  double   t0         = 0.0;
+  uint32_t period     = 1;
+  uint32_t duty       = 0;
+  uint32_t deadTime   = 0;
+  uint32_t nextPeriod = 1;
+  uint32_t nextDuty   = 0;
+  uint64_t edges[4]   = {};   // edge ticks for this period
+  int      edge       = 0;    // next edge
+  bool     lOn        = false; // low-side pin on this period
+  bool     running    = false;
+};
+
 #endif GPIO_CLASS_H
 /*==============================================================================
  * End of GPIO_Class.h
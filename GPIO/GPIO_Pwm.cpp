@@ -0,0 +1,126 @@
+/*==============================================================================
+ * GPIO_Pwm.cpp -- Proof of Concept GPIO PWM peripheral QSpice C-Block.
+ *
+ * Drives a complementary pair of GPIO pins (high-side/low-side) with dead time
+ * from the GPIO_Pwm class.  Edges are scheduled on an internal tick clock and
+ * exported through MaxExtStepSize()/Trunc() so no external clock is needed.
+ *
+ * Note:  Compiles with MSVC.  Does not compile with DMC.
+ * Requires C++17 or newer.
+ *============================================================================*/
+#include <cstdint>
+#include <cstdlib>
+
+/*------------------------------------------------------------------------------
+ * Versioning Information
+ *----------------------------------------------------------------------------*/
+#define PROGRAM_NAME    "GPIO_Pwm"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+// must follow above versioning information
+#include "Cblock.h"
+
+#include "GPIO_Class.h"
+
+/*------------------------------------------------------------------------------
+ * Per-instance Data
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  bool                        lastEn = false;
+  double                      incrT  = 0;   // time to next edge (last eval)
+  GPIO_PinS<double>           pinH;         // high-side output
+  GPIO_PinS<double>           pinL;         // low-side output
+  GPIO_Pwm<GPIO_PinS<double>> pwm;
+};
+
+/*------------------------------------------------------------------------------
+ * UDATA() definition -- regenerate the template with QSpice and revise this
+ * whenever ports/attributes change; make input/attribute parameters const&
+ *----------------------------------------------------------------------------*/
+#define UDATA(data)                                                            \
+  const bool   &En       = data[0].b;  /* input */                             \
+  const double &Vcc      = data[1].d;  /* input */                             \
+  const double &TickFreq = data[2].d;  /* attribute */                         \
+  const int    &Period   = data[3].i;  /* attribute */                         \
+  const int    &Duty     = data[4].i;  /* attribute */                         \
+  const int    &DeadTime = data[5].i;  /* attribute */                         \
+  double       &OutH     = data[6].d;  /* output */                            \
+  bool         &CtlH     = data[7].b;  /* output */                            \
+  double       &OutL     = data[8].d;  /* output */                            \
+  bool         &CtlL     = data[9].b;  /* output */
+
+/*------------------------------------------------------------------------------
+ * Evaluation Function
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void gpio_pwm(
+    InstData **opaque, double t, uData data[]) {
+
+  UDATA(data);
+
+  InstData *inst = *opaque;
+
+  if (!*opaque) {
+    *opaque = new InstData;
+    inst    = *opaque;
+
+    if (!*opaque) {
+      // terminate with prejudice
+      msg("Memory allocation failure.  Terminating simulation.\n");
+      exit(1);
+    }
+
+    // output-only pins read back their own output ports
+    inst->pinH.bind(OutH, OutH, CtlH, Vcc);
+    inst->pinL.bind(OutL, OutL, CtlL, Vcc);
+
+    double tickFreq = TickFreq > 0 ? TickFreq : 1e6;
+    inst->pwm.init(tickFreq, Period > 0 ? Period : 1, Duty > 0 ? Duty : 0,
+        DeadTime > 0 ? DeadTime : 0);
+    inst->pwm.attach(&inst->pinH, &inst->pinL);
+
+    // if important, output component parameters
+    msg("TickFreq=%g, Period=%d, Duty=%d, DeadTime=%d (ticks).\n", tickFreq,
+        Period, Duty, DeadTime);
+  }
+
+  // start/stop on enable edges
+  if (En != inst->lastEn) {
+    inst->lastEn = En;
+    if (En) inst->pwm.start(t);
+    else inst->pwm.stop();
+  }
+
+  inst->pwm.update(t);
+  inst->incrT = inst->pwm.nextEdgeTime() - t;
+}
+
+/*------------------------------------------------------------------------------
+ * MaxExtStepSize() -- step to the next PWM edge
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) double MaxExtStepSize(InstData *inst) {
+  if (!inst || !inst->pwm.isRunning() || inst->incrT <= 0) return 1e308;
+  return inst->incrT;
+}
+
+/*------------------------------------------------------------------------------
+ * Trunc() -- force simulation to trigger on PWM edges
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Trunc(
+    InstData *inst, double t, uData *data, double *timestep) {
+  if (!inst) return;
+
+  double nextT = inst->pwm.nextEdgeTime();
+  if (t < nextT && *timestep > nextT - t) *timestep = nextT - t;
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy()
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(InstData *inst) {
+  // free allocated memory
+  delete inst;
+}
+/*==============================================================================
+ * End of GPIO_Pwm.cpp
+ *============================================================================*/
@@ -0,0 +1,85 @@
+/*==============================================================================
+ * GPIO_PwmTest.cpp -- Regression check of the GPIO_Pwm dead time.  Not a
+ * C-Block; build & run it as a console program, e.g.:
+ *
+ *   cl /O2 /EHsc /std:c++17 GPIO_PwmTest.cpp
+ *   GPIO_PwmTest
+ *
+ * Runs a complementary pair with dead time at 0%, 50%, and 100% duty, samples
+ * the pins at every tick, and compares them with the expected pattern.  The
+ * dead time may only appear where the complementary output actually switches:
+ * at 0% duty L stays on and at 100% duty H stays on.  Returns 0 if all pass.
+ *
+ * Note:  Requires C++17 or newer.
+ *============================================================================*/
+#include <cstdio>
+
+#include "GPIO_Class.h"
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const uint32_t Period   = 10;
+const uint32_t DeadTime = 2;
+const int      Periods  = 3;
+
+/*------------------------------------------------------------------------------
+ * Port data -- laid out like the QSpice uData array
+ *----------------------------------------------------------------------------*/
+double vcc = 3.3;
+double outH, outL;
+bool   ctlH, ctlL;
+
+/*------------------------------------------------------------------------------
+ * expected pin states at tick k for the duty cycle
+ *----------------------------------------------------------------------------*/
+bool expectH(uint32_t duty, uint32_t k) {
+  uint32_t p = k % Period;
+  if (duty >= Period) return true;
+  uint32_t on = k < Period || !duty ? 0 : DeadTime;   // L on in last period
+  return p >= on && p < duty;
+}
+
+bool expectL(uint32_t duty, uint32_t k) {
+  uint32_t p = k % Period;
+  if (duty >= Period) return false;
+  return p >= duty + (duty ? DeadTime : 0);
+}
+
+/*------------------------------------------------------------------------------
+ * runDuty() -- run Periods periods and return the number of mismatches
+ *----------------------------------------------------------------------------*/
+int runDuty(uint32_t duty) {
+  GPIO_PinS<double>            pinH, pinL;
+  GPIO_Pwm<GPIO_PinS<double>> pwm;
+
+  pinH.bind(outH, outH, ctlH, vcc);
+  pinL.bind(outL, outL, ctlL, vcc);
+  pwm.init(1.0, Period, duty, DeadTime);
+  pwm.attach(&pinH, &pinL);
+  pwm.start(0.0);
+
+  int  errors = 0;
+  char gotH[Periods * Period + 1] = {}, gotL[Periods * Period + 1] = {};
+  for (uint32_t k = 0; k < Periods * Period; k++) {
+    pwm.update(double(k));
+    bool h = outH > vcc / 2, l = outL > vcc / 2;
+    gotH[k] = h ? 'H' : '_';
+    gotL[k] = l ? 'L' : '_';
+    if (h != expectH(duty, k) || l != expectL(duty, k)) errors++;
+  }
+
+  printf("duty %2u/%u, dead time %u:  %s  %s\n", duty, Period, DeadTime, gotH,
+      errors ? "FAIL" : "ok");
+  printf("%26s%s\n", "", gotL);
+  return errors;
+}
+
+int main() {
+  int errors = runDuty(0) + runDuty(Period / 2) + runDuty(Period);
+  printf(errors ? "%d mismatches\n" : "All passed\n", errors);
+  return errors ? 1 : 0;
+}
+/*==============================================================================
+ * End of GPIO_PwmTest.cpp
+ *============================================================================*/
@@ -11,13 +11,14 @@
  * Note:  Compiles with MSVC.  Does not compile with DMC.
  * Requires C++17 or newer.
  *============================================================================*/
+#include <cstdint>
 #include <cstdlib>
 
 /*------------------------------------------------------------------------------
  * Versioning Information
  *----------------------------------------------------------------------------*/
 #define PROGRAM_NAME    "GPIO_uC"
-#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_VERSION "v0.2"
 #define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
 
 // must follow above versioning information
@@ -29,15 +30,33 @@
  * Per-instance Data
  *----------------------------------------------------------------------------*/
 struct InstData {
-  bool         lastClk;
-  unsigned int ctr;
+  bool         lastClk = false;
+  unsigned int ctr     = 0;
 
-  GPIO_Pin_Ptr p1;
-  GPIO_Pin_Ptr p2;
-  GPIO_Pin_Ptr p3;
-  GPIO_Pin_Ptr p4;
+  GPIO_Port<double> port;   // pins 1-3 (bits 0-2)
+  GPIO_PinS<bool>   p4;     // by value, no virtual calls
 };
 
+/*------------------------------------------------------------------------------
+ * Charlieplexing TRIS & LAT register values for pins 1-3 (bits 0-2) -- two
+ * pins driven (one high, one low) and one pin high-impedance per LED.
+ *----------------------------------------------------------------------------*/
+struct PlexState {
+  uint8_t tris;
+  uint8_t latch;
+};
+
+const PlexState plexStates[] = {
+    {0b100, 0b001},   // p1=1, p2=0
+    {0b100, 0b010},   // p1=0, p2=1
+    {0b001, 0b010},   // p2=1, p3=0
+    {0b001, 0b100},   // p2=0, p3=1
+    {0b010, 0b001},   // p1=1, p3=0
+    {0b010, 0b100},   // p1=0, p3=1
+};
+
+const unsigned int NbrPlexStates = sizeof(plexStates) / sizeof(plexStates[0]);
+
 /*------------------------------------------------------------------------------
  * UDATA() definition -- regenerate the template with QSpice and revise this
  * whenever ports/attributes change; make input/attribute parameters const&
@@ -69,7 +88,7 @@ extern "C" __declspec(dllexport) void gpio_uc(
   InstData *inst = *opaque;
 
   if (!*opaque) {
-    *opaque = new InstData;
+    *opaque = new InstData();
     inst    = *opaque;
 
     if (!*opaque) {
@@ -79,13 +98,13 @@ extern "C" __declspec(dllexport) void gpio_uc(
     }
 
     // create pins
-    inst->p1 = makeGpioPinPtr(PIn1, POut1, PCtl1, Vcc);
-    inst->p2 = makeGpioPinPtr(PIn2, POut2, PCtl2, Vcc);
-    inst->p3 = makeGpioPinPtr(PIn3, POut3, PCtl3, Vcc);
-    inst->p4 = makeGpioPinPtr(PIn4, POut4, PCtl4, Vcc);
+    inst->port.bindPin(0, PIn1, POut1, PCtl1, Vcc);
+    inst->port.bindPin(1, PIn2, POut2, PCtl2, Vcc);
+    inst->port.bindPin(2, PIn3, POut3, PCtl3, Vcc);
+    inst->p4.bind(PIn4, POut4, PCtl4, Vcc);
 
     // set p4 for output
-    inst->p4->setTris(TRIS_OUT);
+    inst->p4.setTris(TRIS_OUT);
 
     // if important, output component parameters
     msg("Component loaded.\n");
@@ -99,70 +118,28 @@ extern "C" __declspec(dllexport) void gpio_uc(
   // demonstrate tri-state on boolean p4
   switch (inst->ctr % 3) {
   case 0:
-    inst->p4->setTris(TRIS_IN);
+    inst->p4.setTris(TRIS_IN);
     break;
   case 1:
-    inst->p4->setTris(TRIS_OUT);
-    inst->p4->writePort(0);
+    inst->p4.setTris(TRIS_OUT);
+    inst->p4.writePort(0);
     break;
   case 2:
-    inst->p4->setTris(TRIS_OUT);
-    inst->p4->writePort(1);
+    inst->p4.setTris(TRIS_OUT);
+    inst->p4.writePort(1);
     break;
   default:
     msg("Error -- should not get here!\n");
   }
 
-  // charlie-plex LEDs on GPIO pins 1-3
-  // set GPIO 1-3 for high-impedance (inputs)
-  inst->p1->setTris(TRIS_IN);
-  inst->p2->setTris(TRIS_IN);
-  inst->p3->setTris(TRIS_IN);
-
-  // set plexing
-  switch (inst->ctr) {
-  case 0:
-    inst->p1->setTris(TRIS_OUT);
-    inst->p1->writePort(1);
-    inst->p2->setTris(TRIS_OUT);
-    inst->p2->writePort(0);
-    break;
-  case 1:
-    inst->p1->setTris(TRIS_OUT);
-    inst->p1->writePort(0);
-    inst->p2->setTris(TRIS_OUT);
-    inst->p2->writePort(1);
-    break;
-  case 2:
-    inst->p2->setTris(TRIS_OUT);
-    inst->p2->writePort(1);
-    inst->p3->setTris(TRIS_OUT);
-    inst->p3->writePort(0);
-    break;
-  case 3:
-    inst->p2->setTris(TRIS_OUT);
-    inst->p2->writePort(0);
-    inst->p3->setTris(TRIS_OUT);
-    inst->p3->writePort(1);
-    break;
-  case 4:
-    inst->p1->setTris(TRIS_OUT);
-    inst->p1->writePort(1);
-    inst->p3->setTris(TRIS_OUT);
-    inst->p3->writePort(0);
-    break;
-  case 5:
-    inst->p1->setTris(TRIS_OUT);
-    inst->p1->writePort(0);
-    inst->p3->setTris(TRIS_OUT);
-    inst->p3->writePort(1);
-    break;
-  default:
-    msg("Error -- should not get here!\n");
-  }
+  // charlie-plex LEDs on GPIO pins 1-3 -- one register write each for the
+  // latch & TRIS updates all three pins
+  const PlexState &plex = plexStates[inst->ctr % NbrPlexStates];
+  inst->port.writeLatch(plex.latch);
+  inst->port.writeTris(plex.tris);
 
   inst->ctr++;
-  inst->ctr %= 6;
+  inst->ctr %= NbrPlexStates;
 }
 
 /*------------------------------------------------------------------------------
@@ -0,0 +1,176 @@
+// pid_bank.cpp -- Bank of discrete PID controllers (e.g., one per phase of a
+// multiphase converter) sharing one sample clock.  Same PID algorithm as
+// pid_controller.cpp.
+//
+// To build with Digital Mars C++ Compiler:
+//
+//    dmc -mn -WD pid_bank.cpp kernel32.lib
+
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "sample_clock.h"
+
+extern "C" __declspec(dllexport) int (*Display)(const char *format, ...) = 0; // works like printf()
+extern "C" __declspec(dllexport) const double *DegreesC                  = 0; // pointer to current circuit temperature
+
+union uData
+{
+   bool b;
+   char c;
+   unsigned char uc;
+   short s;
+   unsigned short us;
+   int i;
+   unsigned int ui;
+   float f;
+   double d;
+   long long int i64;
+   unsigned long long int ui64;
+   char *str;
+   unsigned char *bytes;
+};
+
+// int DllMain() must exist and return 1 for a process to load the .DLL
+// See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more information.
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) { return 1; }
+
+void bzero(void *ptr, unsigned int count)
+{
+   unsigned char *first = (unsigned char *) ptr;
+   unsigned char *last  = first + count;
+   while(first < last)
+      *first++ = '\0';
+}
+
+// #undef pin names lest they collide with names in any header file(s) you might include.
+#undef clk
+
+// ports:  clk, setpt0-11, fb0-11 (inputs), ctrl0-11 (outputs).  the setpt, fb,
+// and ctrl ports are consecutive data[] entries so each group can be used
+// directly as an array of doubles (uData is 8 bytes).
+#define MAXCH      12
+#define SETPT(ch)  data[1 + (ch)].d
+#define FB(ch)     data[1 + MAXCH + (ch)].d
+#define CTRL(ch)   data[1 + 2 * MAXCH + 4 + (ch)].d
+
+struct sPID_BANK
+{
+  struct sSampleClock clock;   // shared sample clock
+
+  // integration:  errorI = errorI[n-1] + Ts * (ia * error + ib * error[n-1])
+  double ia, ib;               // rectangular:  1, 0; trapezoidal:  0.5, 0.5
+
+  // per-channel gains & state -- struct-of-arrays so the update loop vectorizes
+  int    nch;                  // # of channels
+  double Kp[MAXCH];
+  double Ki[MAXCH];
+  double Kd[MAXCH];
+  double Kv[MAXCH];
+  double error_n1[MAXCH];      // error[n-1]
+  double errorI_n1[MAXCH];     // errorI[n-1]
+};
+
+// load per-channel gains from a text file of "Kp Ki Kd Kv" lines, one line per
+// channel (lines starting with # are comments).  channels without a line get
+// the gains of the last line read (all channels get 1 0 0 1 if no file).
+int loadGains(struct sPID_BANK *inst, const char *path)
+{
+   double Kp = 1, Ki = 0, Kd = 0, Kv = 1;
+   int    nread = 0;
+
+   FILE *file = path && *path ? fopen(path, "r") : 0;
+   if(path && *path && !file)
+      Display("pid_bank: Unable to open CoefFile=\"%s\"\n", path);
+
+   char line[256];
+   for(int ch = 0; ch < inst->nch; ch++)
+   {
+      while(file && fgets(line, sizeof(line), file))
+      {
+         if(*line == '#') continue;
+         double p, i, d, v = 1;
+         if(sscanf(line, "%lf %lf %lf %lf", &p, &i, &d, &v) >= 3)
+         {
+            Kp = p, Ki = i, Kd = d, Kv = v;
+            nread++;
+            break;
+         }
+      }
+      inst->Kp[ch] = Kp;
+      inst->Ki[ch] = Ki;
+      inst->Kd[ch] = Kd;
+      inst->Kv[ch] = Kv;
+   }
+
+   if(file) fclose(file);
+   return nread;
+}
+
+extern "C" __declspec(dllexport) void pid_bank(struct sPID_BANK **opaque, double t, union uData *data)
+{
+   bool        clk      = data[0].b;                  // input
+   int         Channels = data[1 + 2 * MAXCH].i;      // input parameter
+   const char *CoefFile = data[2 + 2 * MAXCH].str;    // input parameter
+   double      Fs       = data[3 + 2 * MAXCH].d;      // input parameter
+   bool        Itype    = data[4 + 2 * MAXCH].b;      // input parameter
+
+   if(!*opaque)
+   {
+      *opaque = (struct sPID_BANK *) malloc(sizeof(struct sPID_BANK));
+      bzero(*opaque, sizeof(struct sPID_BANK));
+      struct sPID_BANK *inst = *opaque;
+
+      inst->nch = Channels < 1 ? 1 : Channels > MAXCH ? MAXCH : Channels;
+      inst->ia  = Itype ? 0.5 : 1.0;
+      inst->ib  = Itype ? 0.5 : 0.0;
+      int nread = loadGains(inst, CoefFile);
+
+      // Fs > 0 selects the internal sample clock (clk input ignored)
+      sampleClockInit(&inst->clock, Fs);
+
+      Display("pid_bank: Channels=%d, gain lines read=%d, Integration Method=%s, Clock=%s\n", inst->nch, nread, Itype ? "Trapezoidal" : "Rectangular", Fs > 0 ? "internal" : "clk");
+      for(int ch = 0; ch < inst->nch; ch++)
+         Display("pid_bank: ch%d Kp=%f, Ki=%f, Kd=%f, Kv=%f\n", ch, inst->Kp[ch], inst->Ki[ch], inst->Kd[ch], inst->Kv[ch]);
+   }
+   struct sPID_BANK *inst = *opaque;
+
+  // sample now?  internal clock tick or rising edge of clk -- one test for
+  // all channels
+  double Tsampling;
+  if (!sampleClockTick(&inst->clock, t, clk, &Tsampling)) return;
+
+  // update all channels in one branch-free pass over the arrays
+  const double  ia = inst->ia * Tsampling, ib = inst->ib * Tsampling;
+  const double  rTs = 1 / Tsampling;
+  const double *setpt = &SETPT(0);
+  const double *fb    = &FB(0);
+  for (int ch = 0; ch < inst->nch; ch++)
+  {
+    double error  = inst->Kv[ch] * (setpt[ch] - fb[ch]);
+    double errorI = inst->errorI_n1[ch] + ia * error + ib * inst->error_n1[ch];
+    double errorD = (error - inst->error_n1[ch]) * rTs;   // matlab : matched
+
+    CTRL(ch) = inst->Kp[ch] * error + inst->Ki[ch] * errorI + inst->Kd[ch] * errorD;
+
+    inst->error_n1[ch]  = error;
+    inst->errorI_n1[ch] = errorI;
+  }
+}
+
+extern "C" __declspec(dllexport) double MaxExtStepSize(struct sPID_BANK *inst)
+{
+   return sampleClockMaxStep(inst ? &inst->clock : 0);
+}
+
+extern "C" __declspec(dllexport) void Trunc(struct sPID_BANK *inst, double t, union uData *data, double *timestep)
+{ // one clock test for the whole bank
+   if(inst)
+      sampleClockTrunc(&inst->clock, t, data[0].b, timestep);
+}
+
+extern "C" __declspec(dllexport) void Destroy(struct sPID_BANK *inst)
+{
+   free(inst);
+}
@@ -5,6 +5,12 @@
 //    dmc -mn -WD pid_controller.cpp kernel32.lib
 
 #include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_clock.h"
 
 extern "C" __declspec(dllexport) int (*Display)(const char *format, ...) = 0; // works like printf()
 extern "C" __declspec(dllexport) const double *DegreesC                  = 0; // pointer to current circuit temperature
@@ -43,28 +49,272 @@ void bzero(void *ptr, unsigned int count)
 #undef ctrl
 #undef clk
 #undef fb
+#undef sch1
+#undef sch2
+
+#define MAXGRID 32   // max gain schedule grid points per axis
 
 struct sPID_CONTROLLER
 {
   // declare the structure here
-  bool   clk_n1;      // clk[n-1]
+  struct sSampleClock clock;   // clk input or internal sample clock (Fs > 0)
+
   double error_n1;    // error[n-1]
   double errorI_n1;   // errorI[n-1]
   double errorD_n1;   // errorD[n-1]
-  double lastT;
+
+  // relay autotune (Tune > 0)
+  int    tune;        // tuning rule while the relay experiment runs (0 = not tuning)
+  bool   relayHigh;   // relay output state
+  int    crossings;   // rising zero crossings of error
+  double lastCross;   // time of last rising zero crossing
+  double emax, emin;  // error extremes this period
+  double sumPu, sumA; // sums of measured periods & amplitudes
+  int    nmeas;       // # of periods measured
+  bool   tuned;       // true to use the tuned gains below
+  double tKp, tKi, tKd;
+
+  // gain schedule (GainTable) -- Kp/Ki/Kd tables on a grid of sch1 (x) by
+  // sch2 (y) values; ny = 1 for a 1-D table
+  int    nx, ny;
+  double gx[MAXGRID], gy[MAXGRID];       // grid points (ascending)
+  double rdx, rdy;                       // 1/spacing for uniform grids, else 0
+  double sKp[MAXGRID * MAXGRID];         // tables, row (y) major
+  double sKi[MAXGRID * MAXGRID];
+  double sKd[MAXGRID * MAXGRID];
+
+  // gains used for the last sample (to detect gain changes)
+  bool   gainsSet;
+  double uKp, uKi, uKd;
 };
 
+// relay autotune
+enum { TUNE_OFF, TUNE_ZN, TUNE_TL, TUNE_SIMC };
+const int TuneSettle  = 2;   // relay periods ignored while the oscillation settles
+const int TuneMeasure = 3;   // relay periods averaged for Ku & Pu
+
+/*------------------------------------------------------------------------------
+ * relayTune() -- one sample of the Astrom-Hagglund relay experiment.  The relay
+ * drives the output to Bias +/- Relay by the sign of the error; the resulting
+ * limit cycle gives the ultimate period Pu (time between rising zero crossings
+ * of the error, interpolated between samples) and ultimate gain
+ * Ku = 4 * Relay / (pi * a) where a is the error amplitude.  When done, the
+ * tuned gains are computed by the selected rule:
+ *
+ *   ZN   (Ziegler-Nichols PID):  Kp = 0.6 Ku,    Ti = Pu / 2,   Td = Pu / 8
+ *   TL   (Tyreus-Luyben PID):    Kp = Ku / 2.2,  Ti = 2.2 Pu,   Td = Pu / 6.3
+ *   SIMC (PI, integrating process with delay, tau_c = delay):
+ *                                Kp = Ku / pi,   Ti = 2 Pu
+ *
+ * Returns the relay output.
+ *----------------------------------------------------------------------------*/
+double relayTune(struct sPID_CONTROLLER *inst, double t, double error, double Tsampling, double Relay, double Bias)
+{
+  if (error > 0 && !inst->relayHigh)   // rising zero crossing
+  {
+    double tc = t;
+    if (inst->error_n1 <= 0 && error != inst->error_n1)
+      tc = t - Tsampling * error / (error - inst->error_n1);
+
+    if (++inst->crossings > TuneSettle + 1)
+    {
+      inst->sumPu += tc - inst->lastCross;
+      inst->sumA  += (inst->emax - inst->emin) / 2;
+      inst->nmeas++;
+    }
+    inst->lastCross = tc;
+    inst->emax = inst->emin = error;
+    inst->relayHigh = true;
+  }
+  else if (error < 0 && inst->relayHigh)
+    inst->relayHigh = false;
+
+  if (error > inst->emax) inst->emax = error;
+  if (error < inst->emin) inst->emin = error;
+
+  if (inst->nmeas == TuneMeasure)
+  {
+    const double pi = 3.14159265358979;
+    double Pu = inst->sumPu / inst->nmeas;
+    double a  = inst->sumA / inst->nmeas;
+    double Ku = a > 0 ? 4 * Relay / (pi * a) : 0;
+    double Ti, Td;
+    const char *rule;
+    switch (inst->tune)
+    {
+    case TUNE_TL:   rule = "Tyreus-Luyben"; inst->tKp = Ku / 2.2; Ti = 2.2 * Pu; Td = Pu / 6.3; break;
+    case TUNE_SIMC: rule = "SIMC";          inst->tKp = Ku / pi;  Ti = 2 * Pu;   Td = 0;        break;
+    default:        rule = "Ziegler-Nichols"; inst->tKp = 0.6 * Ku; Ti = Pu / 2; Td = Pu / 8;   break;
+    }
+    inst->tKi   = inst->tKp / Ti;
+    inst->tKd   = inst->tKp * Td;
+    inst->tuned = true;
+    inst->tune  = TUNE_OFF;
+
+    // start the PID at the relay bias (bumpless)
+    inst->errorI_n1 = inst->tKi != 0 ? (Bias - inst->tKp * error) / inst->tKi : 0;
+
+    Display("pid_controller: Autotune at t=%g:  Ku=%g, Pu=%g\n", t, Ku, Pu);
+    Display("pid_controller: %s gains:  Kp=%g, Ki=%g, Kd=%g\n", rule, inst->tKp, inst->tKi, inst->tKd);
+  }
+
+  return Bias + (inst->relayHigh ? Relay : -Relay);
+}
+
+// gain scheduling.  the GainTable file has grid & table lines (# starts a
+// comment line):
+//
+//    x  x0 x1 ... xn       sch1 grid points (ascending)
+//    y  y0 y1 ... ym       sch2 grid points (ascending, omit for a 1-D table)
+//    Kp v00 v01 ... vmn    gains for each (y, x) grid point, row (y) major
+//    Ki ...
+//    Kd ...
+//
+// lookups are O(1) on uniform grids and a binary search otherwise, with
+// bilinear (linear for 1-D) interpolation; inputs outside the grid are
+// clamped to the edges.
+
+// read up to max numbers from the rest of the line into v; returns the # read
+int readLine(char *p, double *v, int max)
+{
+   int n = 0;
+   char *end;
+   for(double val = strtod(p, &end); end != p && n < max; val = strtod(p, &end))
+   {
+      v[n++] = val;
+      p = end;
+   }
+   return n;
+}
+
+// 1/spacing if the grid is uniform, else 0
+double uniformGrid(const double *g, int n)
+{
+   if(n < 2) return 0;
+   double dx = (g[n - 1] - g[0]) / (n - 1);
+   for(int i = 1; i < n; i++)
+      if(fabs(g[i] - g[0] - i * dx) > 1e-9 * fabs(g[n - 1] - g[0]))
+         return 0;
+   return dx > 0 ? 1 / dx : 0;
+}
+
+// true if the grid is strictly ascending
+bool ascendingGrid(const double *g, int n)
+{
+   for(int i = 1; i < n; i++)
+      if(!(g[i] > g[i - 1]))
+         return false;
+   return true;
+}
+
+bool loadGainTable(struct sPID_CONTROLLER *inst, const char *path)
+{
+   FILE *file = fopen(path, "r");
+   if(!file)
+      return false;
+
+   static char line[16384];
+   int nKp = 0, nKi = 0, nKd = 0;
+   inst->ny    = 1;
+   inst->gy[0] = 0;
+   while(fgets(line, sizeof(line), file))
+   {
+      char key[8];
+      int  len;
+      if(*line == '#' || sscanf(line, " %7s%n", key, &len) != 1) continue;
+      char *p = line + len;
+      if(!strcmp(key, "x"))       inst->nx = readLine(p, inst->gx, MAXGRID);
+      else if(!strcmp(key, "y"))  inst->ny = readLine(p, inst->gy, MAXGRID);
+      else if(!strcmp(key, "Kp")) nKp = readLine(p, inst->sKp, MAXGRID * MAXGRID);
+      else if(!strcmp(key, "Ki")) nKi = readLine(p, inst->sKi, MAXGRID * MAXGRID);
+      else if(!strcmp(key, "Kd")) nKd = readLine(p, inst->sKd, MAXGRID * MAXGRID);
+   }
+   fclose(file);
+
+   int n = inst->nx * inst->ny;
+   if(!inst->nx || !inst->ny || nKp != n || nKi != n || nKd != n)
+   {
+      Display("pid_controller: GainTable needs x (and optional y) grids and %d Kp, Ki, and Kd values each\n", n);
+      inst->nx = 0;
+      return false;
+   }
+   if(!ascendingGrid(inst->gx, inst->nx) || !ascendingGrid(inst->gy, inst->ny))
+   {
+      Display("pid_controller: GainTable x and y grids must be strictly ascending\n");
+      inst->nx = 0;
+      return false;
+   }
+
+   inst->rdx = uniformGrid(inst->gx, inst->nx);
+   inst->rdy = uniformGrid(inst->gy, inst->ny);
+   return true;
+}
+
+// find grid cell i (g[i] <= v < g[i+1]) and the fraction of v across it
+int findCell(const double *g, int n, double rd, double v, double *frac)
+{
+   int i;
+   if(n < 2 || v <= g[0])
+      i = 0, v = g[0];
+   else if(v >= g[n - 1])
+      i = n - 2, v = g[n - 1];
+   else if(rd > 0)   // uniform grid -- direct index
+   {
+      i = (int) ((v - g[0]) * rd);
+      if(i > n - 2) i = n - 2;
+   }
+   else   // non-uniform grid -- binary search
+   {
+      int lo = 0, hi = n - 1;
+      while(hi - lo > 1)
+      {
+         int mid = (lo + hi) / 2;
+         if(v < g[mid]) hi = mid;
+         else lo = mid;
+      }
+      i = lo;
+   }
+   *frac = n < 2 ? 0 : (v - g[i]) / (g[i + 1] - g[i]);
+   return i;
+}
+
+// bilinear interpolation of table tbl at cell (i, j)
+inline double interp(const struct sPID_CONTROLLER *inst, const double *tbl, int i, int j, double fx, double fy)
+{
+   const double *r0 = tbl + j * inst->nx;
+   const double *r1 = inst->ny > 1 ? r0 + inst->nx : r0;
+   int i1 = inst->nx > 1 ? i + 1 : i;
+   return (1 - fy) * ((1 - fx) * r0[i] + fx * r0[i1]) + fy * ((1 - fx) * r1[i] + fx * r1[i1]);
+}
+
+void scheduleGains(const struct sPID_CONTROLLER *inst, double sch1, double sch2, double *Kp, double *Ki, double *Kd)
+{
+   double fx, fy;
+   int i = findCell(inst->gx, inst->nx, inst->rdx, sch1, &fx);
+   int j = findCell(inst->gy, inst->ny, inst->rdy, sch2, &fy);
+   *Kp = interp(inst, inst->sKp, i, j, fx, fy);
+   *Ki = interp(inst, inst->sKi, i, j, fx, fy);
+   *Kd = interp(inst, inst->sKd, i, j, fx, fy);
+}
+
 extern "C" __declspec(dllexport) void pid_controller(struct sPID_CONTROLLER **opaque, double t, union uData *data)
 {
    double  setpt = data[0].d; // input
    bool    clk   = data[1].b; // input
    double  fb    = data[2].d; // input
-   double  Kp    = data[3].d; // input parameter
-   double  Ki    = data[4].d; // input parameter
-   double  Kd    = data[5].d; // input parameter
-   double  Kv    = data[6].d; // input parameter
-   bool    Itype = data[7].b; // input parameter
-   double &ctrl  = data[8].d; // output
+   double  sch1  = data[3].d; // input
+   double  sch2  = data[4].d; // input
+   double  Kp    = data[5].d; // input parameter
+   double  Ki    = data[6].d; // input parameter
+   double  Kd    = data[7].d; // input parameter
+   double  Kv    = data[8].d; // input parameter
+   bool    Itype = data[9].b; // input parameter
+   double  Fs    = data[10].d; // input parameter
+   int     Tune  = data[11].i; // input parameter
+   double  Relay = data[12].d; // input parameter
+   double  Bias  = data[13].d; // input parameter
+   const char *GainTable = data[14].str; // input parameter
+   double &ctrl  = data[15].d; // output
 
    if(!*opaque)
    {
@@ -72,19 +322,73 @@ extern "C" __declspec(dllexport) void pid_controller(struct sPID_CONTROLLER **op
       bzero(*opaque, sizeof(struct sPID_CONTROLLER));
 
       Display("pid_controller: Kp=%f, Ki=%f, Kd=%f, Kv=%f, Integration Method=%s\n",Kp, Ki, Kd, Kv, Itype ? "Trapezoidal" : "Rectangular");
+
+      // Fs > 0 selects the internal sample clock (clk input ignored)
+      sampleClockInit(&(*opaque)->clock, Fs);
+      if(Fs > 0)
+      {
+         Display("pid_controller: Internal sample clock Fs=%g Hz\n", Fs);
+      }
+
+      // Tune > 0 starts with a relay autotune experiment
+      if(Tune > TUNE_OFF && Tune <= TUNE_SIMC && Relay > 0)
+      {
+         (*opaque)->tune = Tune;
+         Display("pid_controller: Autotune relay=%g, bias=%g\n", Relay, Bias);
+      }
+
+      // GainTable loads the gain schedule
+      if(GainTable && *GainTable)
+      {
+         if(loadGainTable(*opaque, GainTable))
+            Display("pid_controller: Gain schedule %dx%d (%s grid)\n", (*opaque)->nx, (*opaque)->ny, (*opaque)->rdx > 0 && ((*opaque)->ny == 1 || (*opaque)->rdy > 0) ? "uniform" : "non-uniform");
+         else
+            Display("pid_controller: Unable to load GainTable=\"%s\"\n", GainTable);
+      }
    }
    struct sPID_CONTROLLER *inst = *opaque;
 
+   // autotuned gains replace the attribute gains
+   if(inst->tuned)
+   {
+      Kp = inst->tKp;
+      Ki = inst->tKi;
+      Kd = inst->tKd;
+   }
+
+  // sample now?  internal clock tick or rising edge of clk; Tsampling =
+  // time between samples (constant for internal clock)
+  double Tsampling;
+  bool   sample = sampleClockTick(&inst->clock, t, clk, &Tsampling);
+
 // Implement module evaluation code here:
-  if (clk && !inst->clk_n1)   // rising edge
+  if (sample)
   {
-    // time between samples : calculate Tsampling
-    double Tsampling = t - inst->lastT;   // Tsampling = current time - last rising edge time
-    inst->lastT      = t;
-
     // calculate error
     double error = Kv * (setpt - fb);
 
+    // relay autotune experiment in progress
+    if (inst->tune)
+    {
+      ctrl = relayTune(inst, t, error, Tsampling, Relay, Bias);
+      inst->error_n1 = error;
+      return;
+    }
+
+    // scheduled gains replace the attribute/autotuned gains
+    if (inst->nx)
+      scheduleGains(inst, sch1, sch2, &Kp, &Ki, &Kd);
+
+    // bumpless gain change:  rescale the integrator so the last output is
+    // unchanged by the new gains
+    if (inst->gainsSet && Ki != 0 && (Kp != inst->uKp || Ki != inst->uKi || Kd != inst->uKd))
+    {
+      double ctrl_n1 = inst->uKp * inst->error_n1 + inst->uKi * inst->errorI_n1 + inst->uKd * inst->errorD_n1;
+      inst->errorI_n1 = (ctrl_n1 - Kp * inst->error_n1 - Kd * inst->errorD_n1) / Ki;
+    }
+    inst->uKp = Kp, inst->uKi = Ki, inst->uKd = Kd;
+    inst->gainsSet = true;
+
     // calculate proportional, integral and derivative error
     double errorP = error;
 
@@ -108,27 +412,17 @@ extern "C" __declspec(dllexport) void pid_controller(struct sPID_CONTROLLER **op
     inst->errorI_n1 = errorI;   // errorI[n-1] = errorI[n]
     inst->errorD_n1 = errorD;   // errorD[n-1] = errorD[n]
   }
-
-  // save clock state
-  inst->clk_n1 = clk;
 }
 
 extern "C" __declspec(dllexport) double MaxExtStepSize(struct sPID_CONTROLLER *inst)
 {
-   return 1e308; // implement a good choice of max timestep size that depends on struct sPID_CONTROLLER
+   return sampleClockMaxStep(inst ? &inst->clock : 0);
 }
 
 extern "C" __declspec(dllexport) void Trunc(struct sPID_CONTROLLER *inst, double t, union uData *data, double *timestep)
-{ // limit the timestep to a tolerance if the circuit causes a change in struct sPID_CONTROLLER
-   const double ttol = 10e-12; // 10ps default tolerance
-   if(*timestep > ttol)
-   {
-      struct sPID_CONTROLLER tmp = *inst;
-      pid_controller(&(&tmp), t, data);
-
-      if(tmp.clk_n1 != inst->clk_n1 & !inst->clk_n1)  // clock rising edge reduce timestep to TTOL
-         *timestep = ttol;
-   }
+{ // limit the timestep to land on sample times
+   if(inst)
+      sampleClockTrunc(&inst->clock, t, data[1].b, timestep);
 }
 
 extern "C" __declspec(dllexport) void Destroy(struct sPID_CONTROLLER *inst)
@@ -0,0 +1,101 @@
+// sample_clock.h -- Sample clock shared by pid_controller.cpp, pid_bank.cpp,
+// and zcontroller.cpp:  the clk input rising edge or, for Fs > 0, an internal
+// drift-free clock, with the MaxExtStepSize()/Trunc() timestep control that
+// lands the simulation on sample times.
+
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <math.h>
+
+struct sSampleClock
+{
+  bool               clk_n1;   // clk[n-1]
+  double             lastT;    // last sample time
+  double             Tclk;     // measured clock period (0 until two edges seen)
+  double             Fs;       // internal sample rate (0 = clk input)
+  unsigned long long tick;     // next internal sample tick; sample time = tick / Fs
+  double             incrT;    // time to next internal sample (last evaluation)
+};
+
+// Fs > 0 selects the internal sample clock (clk input ignored); the clock
+// must be zeroed first
+inline void sampleClockInit(struct sSampleClock *sc, double Fs)
+{
+  if (Fs > 0)
+  {
+    sc->Fs   = Fs;
+    sc->tick = 1;
+  }
+}
+
+// next internal clock sample time (drift-free -- see CBlockBasics5 calcTickTime())
+inline double nextSampleTime(const struct sSampleClock *sc) { return sc->tick / sc->Fs; }
+
+// sample now?  internal clock tick or rising edge of clk.  on a sample,
+// *Tsampling is the sampling period:  1/Fs or the time since the last edge.
+inline bool sampleClockTick(struct sSampleClock *sc, double t, bool clk, double *Tsampling)
+{
+  bool sample;
+  if (sc->Fs > 0)
+  {
+    const double tickTol = 1e-6;   // sample time tolerance (ticks)
+    sample = t >= (sc->tick - tickTol) / sc->Fs;
+    if (sample)   // next tick after t (skips any ticks missed)
+      sc->tick = (unsigned long long) floor(t * sc->Fs + tickTol) + 1;
+    sc->incrT = nextSampleTime(sc) - t;
+  }
+  else
+    sample = clk && !sc->clk_n1;   // rising edge
+  sc->clk_n1 = clk;
+
+  if (!sample) return false;
+
+  *Tsampling = sc->Fs > 0 ? 1 / sc->Fs : t - sc->lastT;
+  if (sc->Fs <= 0 && sc->lastT > 0) sc->Tclk = *Tsampling;   // for Trunc() edge prediction
+  sc->lastT = t;
+  return true;
+}
+
+// MaxExtStepSize():  internal clock -- step to the next sample time
+inline double sampleClockMaxStep(const struct sSampleClock *sc)
+{
+  if (sc && sc->Fs > 0 && sc->incrT > 0) return sc->incrT;
+  return 1e308;
+}
+
+// Trunc():  end the timestep at the next sample time -- known exactly for the
+// internal clock, at ttol past a clk rising edge in the trial step (a direct
+// test of the clk input rather than re-running the evaluation on a copy of
+// the instance data), else at the edge predicted from the measured clock
+// period rather than stepping past it and backing off
+inline void sampleClockTrunc(const struct sSampleClock *sc, double t, bool clk, double *timestep)
+{
+  const double ttol = 10e-12;   // 10ps default tolerance
+
+  if (sc->Fs > 0)
+  {
+    double tNext = nextSampleTime(sc);
+    if (t < tNext && *timestep > tNext - t)
+      *timestep = tNext - t;
+    return;
+  }
+
+  if (clk && !sc->clk_n1)
+  {
+    if (*timestep > ttol)
+      *timestep = ttol;
+    return;
+  }
+
+  if (sc->Tclk > 0)
+  {
+    double tNext = sc->lastT + sc->Tclk;
+    if (tNext <= t)   // late edge -- predict the one after
+      tNext = sc->lastT + (floor((t - sc->lastT) / sc->Tclk) + 1) * sc->Tclk;
+    if (*timestep > tNext - t)
+      *timestep = tNext - t;
+  }
+}
+
+#endif   // SAMPLE_CLOCK_H
@@ -0,0 +1,278 @@
+// zcontroller.cpp -- General discrete-time (z-domain) controller.  Runs a
+// cascade of second-order sections (biquads, e.g., 2P2Z/3P3Z compensators) or
+// a state-space (A,B,C,D) system loaded from a coefficient file, on the clk
+// rising edge or an internal sample clock like pid_controller.cpp.
+//
+// To build with Digital Mars C++ Compiler:
+//
+//    dmc -mn -WD zcontroller.cpp kernel32.lib
+
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_clock.h"
+
+extern "C" __declspec(dllexport) int (*Display)(const char *format, ...) = 0; // works like printf()
+extern "C" __declspec(dllexport) const double *DegreesC                  = 0; // pointer to current circuit temperature
+
+union uData
+{
+   bool b;
+   char c;
+   unsigned char uc;
+   short s;
+   unsigned short us;
+   int i;
+   unsigned int ui;
+   float f;
+   double d;
+   long long int i64;
+   unsigned long long int ui64;
+   char *str;
+   unsigned char *bytes;
+};
+
+// int DllMain() must exist and return 1 for a process to load the .DLL
+// See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more information.
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) { return 1; }
+
+void bzero(void *ptr, unsigned int count)
+{
+   unsigned char *first = (unsigned char *) ptr;
+   unsigned char *last  = first + count;
+   while(first < last)
+      *first++ = '\0';
+}
+
+// #undef pin names lest they collide with names in any header file(s) you might include.
+#undef setpt
+#undef ctrl
+#undef clk
+#undef fb
+
+#define MAXSOS    8   // max biquad sections
+#define MAXSTATES 8   // max state-space order
+
+enum { ZSOS, ZSS };   // system type
+
+struct sZCONTROLLER
+{
+  struct sSampleClock clock;   // clk input or internal sample clock
+
+  // fixed-point emulation (Qm.n, qscale = 2^n; qscale = 0 for floating point)
+  double qscale, qmin, qmax;
+
+  int    type;                 // ZSOS or ZSS
+  double gain;                 // input gain
+
+  // biquad cascade, transposed direct form II -- coefficients & states in
+  // separate arrays (struct-of-arrays)
+  int    nsos;
+  double b0[MAXSOS], b1[MAXSOS], b2[MAXSOS], a1[MAXSOS], a2[MAXSOS];
+  double s1[MAXSOS], s2[MAXSOS];
+
+  // state space:  x[k+1] = A x[k] + B u[k];  y[k] = C x[k] + D u[k]
+  int    nx;
+  double A[MAXSTATES][MAXSTATES], B[MAXSTATES], C[MAXSTATES], D;
+  double x[MAXSTATES];
+};
+
+// round to the Qm.n grid and saturate (no-op for floating point)
+inline double quantize(const struct sZCONTROLLER *inst, double v)
+{
+   if(inst->qscale == 0) return v;
+   v = floor(v * inst->qscale + 0.5) / inst->qscale;
+   return v < inst->qmin ? inst->qmin : v > inst->qmax ? inst->qmax : v;
+}
+
+// read n numbers from file into v; returns the # read
+int readNumbers(FILE *file, double *v, int n)
+{
+   int i = 0;
+   while(i < n && fscanf(file, "%lf", &v[i]) == 1) i++;
+   return i;
+}
+
+// load the coefficient file.  keywords (# starts a comment line):
+//
+//    gain g                   input gain (default 1)
+//    sos  b0 b1 b2 a0 a1 a2   a biquad section (repeat for a cascade)
+//    ss   n                   state-space order, followed by
+//    A    a11 a12 ... ann     (row major)
+//    B    b1 ... bn
+//    C    c1 ... cn
+//    D    d
+//
+// returns false if the file can't be read or has no system.
+bool loadCoefs(struct sZCONTROLLER *inst, const char *path)
+{
+   FILE *file = path && *path ? fopen(path, "r") : 0;
+   if(!file)
+      return false;
+
+   char word[64];
+   inst->gain = 1;
+   while(fscanf(file, "%63s", word) == 1)
+   {
+      double v[6];
+      if(*word == '#')   // comment -- skip the rest of the line
+      {
+         int c;
+         while((c = fgetc(file)) != EOF && c != '\n');
+      }
+      else if(!strcmp(word, "gain"))
+         readNumbers(file, &inst->gain, 1);
+      else if(!strcmp(word, "sos") && inst->nsos < MAXSOS)
+      {
+         if(readNumbers(file, v, 6) != 6 || v[3] == 0) break;
+         int k = inst->nsos++;
+         inst->b0[k] = v[0] / v[3];
+         inst->b1[k] = v[1] / v[3];
+         inst->b2[k] = v[2] / v[3];
+         inst->a1[k] = v[4] / v[3];
+         inst->a2[k] = v[5] / v[3];
+         inst->type  = ZSOS;
+      }
+      else if(!strcmp(word, "ss"))
+      {
+         if(readNumbers(file, v, 1) != 1 || v[0] < 1 || v[0] > MAXSTATES) break;
+         inst->nx   = (int) v[0];
+         inst->type = ZSS;
+      }
+      else if(!strcmp(word, "A") && inst->nx)
+      {
+         for(int r = 0; r < inst->nx; r++)
+            readNumbers(file, inst->A[r], inst->nx);
+      }
+      else if(!strcmp(word, "B") && inst->nx)
+         readNumbers(file, inst->B, inst->nx);
+      else if(!strcmp(word, "C") && inst->nx)
+         readNumbers(file, inst->C, inst->nx);
+      else if(!strcmp(word, "D"))
+         readNumbers(file, &inst->D, 1);
+      else
+      {
+         Display("zcontroller: Unknown keyword \"%s\" in CoefFile\n", word);
+         break;
+      }
+   }
+   fclose(file);
+
+   // coefficients are stored in the firmware's format too
+   inst->gain = quantize(inst, inst->gain);
+   for(int k = 0; k < inst->nsos; k++)
+   {
+      inst->b0[k] = quantize(inst, inst->b0[k]);
+      inst->b1[k] = quantize(inst, inst->b1[k]);
+      inst->b2[k] = quantize(inst, inst->b2[k]);
+      inst->a1[k] = quantize(inst, inst->a1[k]);
+      inst->a2[k] = quantize(inst, inst->a2[k]);
+   }
+   for(int r = 0; r < inst->nx; r++)
+   {
+      for(int c = 0; c < inst->nx; c++)
+         inst->A[r][c] = quantize(inst, inst->A[r][c]);
+      inst->B[r] = quantize(inst, inst->B[r]);
+      inst->C[r] = quantize(inst, inst->C[r]);
+   }
+   inst->D = quantize(inst, inst->D);
+
+   return inst->type == ZSOS ? inst->nsos > 0 : inst->nx > 0;
+}
+
+// one sample of the biquad cascade (TDF-II)
+double runSos(struct sZCONTROLLER *inst, double u)
+{
+   for(int k = 0; k < inst->nsos; k++)
+   {
+      double y    = quantize(inst, inst->b0[k] * u + inst->s1[k]);
+      inst->s1[k] = quantize(inst, inst->b1[k] * u - inst->a1[k] * y + inst->s2[k]);
+      inst->s2[k] = quantize(inst, inst->b2[k] * u - inst->a2[k] * y);
+      u           = y;
+   }
+   return u;
+}
+
+// one sample of the state-space system
+double runSs(struct sZCONTROLLER *inst, double u)
+{
+   double y = inst->D * u;
+   double x[MAXSTATES];
+   for(int r = 0; r < inst->nx; r++)
+   {
+      y += inst->C[r] * inst->x[r];
+      double acc = inst->B[r] * u;
+      for(int c = 0; c < inst->nx; c++)
+         acc += inst->A[r][c] * inst->x[c];
+      x[r] = quantize(inst, acc);
+   }
+   memcpy(inst->x, x, inst->nx * sizeof(double));
+   return quantize(inst, y);
+}
+
+extern "C" __declspec(dllexport) void zcontroller(struct sZCONTROLLER **opaque, double t, union uData *data)
+{
+   double      setpt    = data[0].d;   // input
+   bool        clk      = data[1].b;   // input
+   double      fb       = data[2].d;   // input
+   const char *CoefFile = data[3].str; // input parameter
+   double      Fs       = data[4].d;   // input parameter
+   int         Qm       = data[5].i;   // input parameter
+   int         Qn       = data[6].i;   // input parameter
+   double     &ctrl     = data[7].d;   // output
+
+   if(!*opaque)
+   {
+      *opaque = (struct sZCONTROLLER *) malloc(sizeof(struct sZCONTROLLER));
+      bzero(*opaque, sizeof(struct sZCONTROLLER));
+      struct sZCONTROLLER *inst = *opaque;
+
+      // Qn > 0 selects Qm.n fixed-point emulation (sign + m integer + n fraction bits)
+      if(Qn > 0)
+      {
+         inst->qscale = ldexp(1.0, Qn);
+         inst->qmax   = ldexp(1.0, Qm) - 1 / inst->qscale;
+         inst->qmin   = -ldexp(1.0, Qm);
+      }
+
+      if(!loadCoefs(inst, CoefFile))
+         Display("zcontroller: Unable to load a system from CoefFile=\"%s\".  Output held at 0.\n", CoefFile ? CoefFile : "");
+
+      // Fs > 0 selects the internal sample clock (clk input ignored)
+      sampleClockInit(&inst->clock, Fs);
+
+      if(inst->type == ZSOS)
+         Display("zcontroller: %d biquad section(s), gain=%g", inst->nsos, inst->gain);
+      else
+         Display("zcontroller: State space order %d, gain=%g", inst->nx, inst->gain);
+      if(Qn > 0)
+         Display(", Q%d.%d fixed point", Qm, Qn);
+      Display(", Clock=%s\n", Fs > 0 ? "internal" : "clk");
+   }
+   struct sZCONTROLLER *inst = *opaque;
+
+  // sample now?  internal clock tick or rising edge of clk
+  double Tsampling;
+  if (!sampleClockTick(&inst->clock, t, clk, &Tsampling)) return;
+
+  double u = quantize(inst, inst->gain * (setpt - fb));
+  ctrl = inst->type == ZSOS ? runSos(inst, u) : runSs(inst, u);
+}
+
+extern "C" __declspec(dllexport) double MaxExtStepSize(struct sZCONTROLLER *inst)
+{
+   return sampleClockMaxStep(inst ? &inst->clock : 0);
+}
+
+extern "C" __declspec(dllexport) void Trunc(struct sZCONTROLLER *inst, double t, union uData *data, double *timestep)
+{ // limit the timestep to land on sample times
+   if(inst)
+      sampleClockTrunc(&inst->clock, t, data[1].b, timestep);
+}
+
+extern "C" __declspec(dllexport) void Destroy(struct sZCONTROLLER *inst)
+{
+   free(inst);
+}
@@ -17,6 +17,7 @@
  */
 extern "C" __declspec(dllexport) int (*Display)(const char* format, ...) = 0;
 extern "C" __declspec(dllexport) const bool* HoldICs                     = 0;
+extern "C" __declspec(dllexport) const bool* ForKeeps                    = 0;
 
 union uData
 {
@@ -40,6 +41,47 @@ int __stdcall DllMain(void* module, unsigned int reason, void* reserved)
   return 1;
 }
 
+/*
+ * run the firmware on the in-process AVR core (see AvrCore.cpp) instead of
+ * MDB (MdbSimPath is then ignored).  the core models only the CPU, the PORTB
+ * pins, Timer0/Timer1, the ADC, and the EEPROM -- other I/O registers (USI,
+ * watchdog, analog comparator, ...) are plain registers without a diagnostic.
+ * set NativeCore to true for firmware that needs only the modeled peripherals.
+ */
+const bool NativeCore = false;
+
+/*
+ * max instructions stepped per MDB round trip while inputs are unchanged (see
+ * MdbSim::stepRunAhead()).  1 is lock-step simulation; larger values (e.g., 32)
+ * cut the round trips, but an input change during a run-ahead leaves the
+ * firmware up to RunAheadMax-1 instructions ahead of the clock, so run-ahead
+ * is opt-in.
+ */
+const int RunAheadMax = 1;
+
+/*
+ * asynchronous stepping (see MdbSim::stepStart()):  on a clock edge, each
+ * instance sends its MDB commands and returns, so the MDB processes of several
+ * instances run concurrently.  the results are collected at the instance's
+ * next evaluation; MaxExtStepSize() limits that to AsyncStepDelay after the
+ * edge, so the outputs change AsyncStepDelay late.  it pays off only with
+ * several MDB instances -- set AsyncStep to true for those schematics.
+ */
+const bool   AsyncStep      = false;
+const double AsyncStepDelay = 1e-9;
+
+/*
+ * rollback (see MdbSim::rollback()):  QSpice evaluates trial steps (ForKeeps
+ * false) that it may reject, then evaluates the accepted step again.  the MCU
+ * state is checkpointed before a trial and rolled back after it, so a clock
+ * edge seen in a trial steps the firmware only once.  a native core rollback
+ * is a copy (Rollback); an MDB rollback replays the simulation from its start,
+ * so every trial that crosses a clock edge costs the whole run so far -- set
+ * MdbRollback to true only for short MDB runs.
+ */
+const bool Rollback    = true;
+const bool MdbRollback = false;
+
 /*
  * Per-instance component data
  */
@@ -50,6 +92,8 @@ struct InstData
 
   MdbSim mdb;
   bool   lastClkState = 0;
+  bool   trial        = false; // last evaluation was a trial (rolled back)
+  bool   keptClkState = 0;     // lastClkState at the checkpoint
 };
 
 // pointer typedef for convenience
@@ -147,13 +191,18 @@ extern "C" __declspec(dllexport) void attiny85(
         "\"%s\"\n  Program:  \"%s\"\n",
         inst->mdb.getVerInfo(), MdbSimPath, "ATtiny85", McPgm);
 
-    // start MDB simulator on server
+    // start MDB simulator on server (or the native core)
+    inst->mdb.setNativeCore(NativeCore);
+    inst->mdb.setMdbRollback(MdbRollback);
     if (!inst->mdb.startSim("ATtiny85", McPgm))
     {
       SimError(inst);
       return;
     }
-    Display("MDB simulator loaded/configured successfully...\n");
+    Display(inst->mdb.isNative()
+                ? "Native AVR core loaded successfully (MDB not used, "
+                  "MdbSimPath ignored)...\n"
+                : "MDB simulator loaded/configured successfully...\n");
 
     // set device VDD -- note that we're doing this only once and any changes
     // to QSpice VDD don't get passed to MDB (so no brown-out detection support
@@ -164,6 +213,13 @@ extern "C" __declspec(dllexport) void attiny85(
       return;
     }
 
+    // write analog inputs to MDB only on changes of 1 LSB or more (10-bit
+    // ADC, VDD reference)
+    inst->mdb.setAnalogThreshold(VCC / 1024);
+
+    // step multiple instructions per MDB round trip while inputs are quiet
+    inst->mdb.setRunAheadMax(RunAheadMax);
+
     // get initial pin states from MDB
     if (!inst->mdb.getPinStates())
     {
@@ -182,6 +238,44 @@ extern "C" __declspec(dllexport) void attiny85(
    * evaluation code begins here...
    */
 
+  // finish a pending asynchronous step and update the outputs
+  if (inst->mdb.stepPending())
+  {
+    if (!inst->mdb.stepFinish())
+    {
+      SimError(inst);
+      return;
+    }
+    inst->mdb.setCtrlPorts();
+    inst->mdb.setOutPorts();
+  }
+
+  // undo the last trial evaluation and checkpoint before a new one (QSpice
+  // versions without ForKeeps don't set it)
+  bool rollback = inst->mdb.isNative() ? Rollback : MdbRollback;
+  if (rollback && inst->trial)
+  {
+    if (!inst->mdb.rollback())
+    {
+      SimError(inst);
+      return;
+    }
+    inst->lastClkState = inst->keptClkState;
+    inst->trial        = false;
+    inst->mdb.setCtrlPorts();
+    inst->mdb.setOutPorts();
+  }
+  if (rollback && ForKeeps && !*ForKeeps)
+  {
+    if (!inst->mdb.checkpoint())
+    {
+      SimError(inst);
+      return;
+    }
+    inst->keptClkState = inst->lastClkState;
+    inst->trial        = true;
+  }
+
   // is QSpice initializing?
   if (*HoldICs)
   {
@@ -194,26 +288,18 @@ extern "C" __declspec(dllexport) void attiny85(
   inst->lastClkState = CLK;
   if (CLK) return;
 
-  //  set input pin states in MDB simulator from QSpice ports
-  if (!inst->mdb.setInPins())
+  // set input pin states in MDB simulator from QSpice ports, step MDB
+  // simulation by one uC instruction, and refresh pin states from MDB -- all
+  // in one MDB round trip (or replayed from an earlier run-ahead)
+  bool stepOk = AsyncStep ? inst->mdb.stepStart() : inst->mdb.stepRunAhead();
+  if (!stepOk)
   {
     SimError(inst);
     return;
   }
 
-  // step MDB simulation by one uC instruction
-  if (!inst->mdb.stepInst())
-  {
-    SimError(inst);
-    return;
-  }
-
-  // refresh pin states from MDB
-  if (!inst->mdb.getPinStates())
-  {
-    SimError(inst);
-    return;
-  }
+  // asynchronous step sent -- outputs are updated when it finishes
+  if (inst->mdb.stepPending()) return;
 
   // set component tri-state port config from MDB
   inst->mdb.setCtrlPorts();
@@ -236,6 +322,9 @@ extern "C" __declspec(dllexport) double MaxExtStepSize(pInstData inst)
     return abortSim;
   }
 
+  // asynchronous step pending -- come back shortly to finish it
+  if (inst->mdb.stepPending()) return AsyncStepDelay;
+
   return forever;
 } // end of MaxExtStepSize()
 
@@ -244,5 +333,16 @@ extern "C" __declspec(dllexport) double MaxExtStepSize(pInstData inst)
  */
 extern "C" __declspec(dllexport) void Destroy(pInstData inst)
 {
+  // collect any pending step first -- the reader thread updates the counts
+  if (inst->mdb.stepPending()) inst->mdb.stepFinish();
+
+  // report MDB throughput
+  double ioSecs = inst->mdb.getIoSeconds();
+  if (inst->mdb.getStepCount() && ioSecs > 0)
+    Display("%llu instructions, %llu MDB commands, %.3f s MDB I/O (%.0f "
+            "instructions/sec)\n",
+        inst->mdb.getStepCount(), inst->mdb.getCmdCount(), ioSecs,
+        inst->mdb.getStepCount() / ioSecs);
+
   delete inst;
 } // end of Destroy()
@@ -0,0 +1,146 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * McuCore factory and program file loading shared by the cores.  If you want
+ * to create a new Microchip device, you should not need to modify this code.
+ */
+
+#include "McuCore.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#  pragma warning(disable : 4996) // we'll take our chances...
+#endif
+
+std::unique_ptr<McuCore> McuCore::create(const char* deviceName)
+{
+  McuCore* core = newPic16Core(deviceName);
+  if (!core) core = newAvrCore(deviceName);
+  return std::unique_ptr<McuCore>(core);
+}
+
+// little-endian fields of the ELF file
+static uint32_t getLE(const std::vector<uint8_t>& buf, size_t pos, int len)
+{
+  uint32_t v = 0;
+  if (pos + len > buf.size()) return 0;
+  for (int i = len; i--;) v = v << 8 | buf[pos + i];
+  return v;
+}
+
+// ELF32:  the PT_LOAD program headers with file data, at p_paddr
+static bool loadElf(const std::vector<uint8_t>& buf, uint16_t elfMachine,
+    std::vector<McuCore::Segment>& segments)
+{
+  const int ELFCLASS32  = 1;
+  const int ELFDATA2LSB = 1;
+  const int PT_LOAD     = 1;
+
+  if (buf.size() < 52 || buf[4] != ELFCLASS32 || buf[5] != ELFDATA2LSB ||
+      getLE(buf, 18, 2) != elfMachine)
+    return false;
+
+  uint32_t phOff   = getLE(buf, 28, 4);
+  uint32_t phSize  = getLE(buf, 42, 2);
+  uint32_t phCount = getLE(buf, 44, 2);
+  for (uint32_t i = 0; i < phCount; i++)
+  {
+    size_t   ph       = phOff + size_t(i) * phSize;
+    uint32_t type     = getLE(buf, ph, 4);
+    uint32_t offset   = getLE(buf, ph + 4, 4);
+    uint32_t paddr    = getLE(buf, ph + 12, 4);
+    uint32_t fileSize = getLE(buf, ph + 16, 4);
+    if (type != PT_LOAD || !fileSize) continue;
+    if (size_t(offset) + fileSize > buf.size()) return false;
+
+    segments.push_back({paddr, std::vector<uint8_t>(buf.begin() + offset,
+                                   buf.begin() + offset + fileSize)});
+  }
+  return !segments.empty();
+}
+
+// Intel HEX:  data records (type 0) with extended segment (2) and linear (4)
+// addresses; consecutive records are merged
+static bool loadHex(
+    const std::vector<uint8_t>& buf, std::vector<McuCore::Segment>& segments)
+{
+  std::string text(buf.begin(), buf.end());
+  uint32_t    base = 0;
+  size_t      pos  = 0;
+
+  while ((pos = text.find(':', pos)) != text.npos)
+  {
+    // decode the record bytes
+    uint8_t rec[260];
+    size_t  len = 0;
+    for (pos++; len < sizeof(rec) && pos + 1 < text.size(); pos += 2)
+    {
+      char  hex[3] = {text[pos], text[pos + 1], 0};
+      char* end;
+      rec[len] = uint8_t(strtoul(hex, &end, 16));
+      if (*end) break;
+      len++;
+    }
+    if (len < 5 || len < size_t(rec[0]) + 5) return false;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size_t(rec[0]) + 5; i++) sum += rec[i];
+    if (sum) return false;
+
+    uint32_t addr = base + (uint32_t(rec[1]) << 8 | rec[2]);
+    switch (rec[3])
+    {
+      case 0:
+        if (!segments.empty() &&
+            segments.back().addr + segments.back().bytes.size() == addr)
+          segments.back().bytes.insert(
+              segments.back().bytes.end(), rec + 4, rec + 4 + rec[0]);
+        else
+          segments.push_back(
+              {addr, std::vector<uint8_t>(rec + 4, rec + 4 + rec[0])});
+        break;
+      case 1: return !segments.empty();
+      case 2: base = (uint32_t(rec[4]) << 8 | rec[5]) << 4; break;
+      case 4: base = (uint32_t(rec[4]) << 8 | rec[5]) << 16; break;
+    }
+  }
+  return !segments.empty();
+}
+
+bool McuCore::loadSegments(const char* pgmPath, uint16_t elfMachine,
+    std::vector<Segment>& segments, bool& isElf)
+{
+  segments.clear();
+
+  FILE* file = fopen(pgmPath, "rb");
+  if (!file)
+  {
+    errContext = "load(open program file)";
+    return false;
+  }
+  std::vector<uint8_t> buf;
+  uint8_t              chunk[65536];
+  size_t               len;
+  while ((len = fread(chunk, 1, sizeof(chunk), file)))
+    buf.insert(buf.end(), chunk, chunk + len);
+  fclose(file);
+
+  isElf = buf.size() >= 4 && !memcmp(buf.data(), "\x7f" "ELF", 4);
+  if (isElf ? loadElf(buf, elfMachine, segments) : loadHex(buf, segments))
+    return true;
+
+  // not a system error
+  errno      = 0;
+  errContext = isElf ? "load(invalid ELF or wrong device family)"
+                     : "load(invalid program file)";
+  return false;
+}
@@ -0,0 +1,48 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * This code launches the MDB process and provides the stdio pipes that MdbSim
+ * uses to talk to it.  MdbTransport::create() returns the implementation for
+ * the build platform:  Win32 (CreatePipe/CreateProcess) or POSIX
+ * (pipe/fork/exec).  The POSIX version lets the MdbSim stepping code be built,
+ * profiled, and tested off Windows against the MockMdb stand-in.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+
+// MDB process & stdio pipe interface
+class MdbTransport
+{
+public:
+  virtual ~MdbTransport() {}
+
+  // launch the MDB process with stdin and stdout/stderr redirected to pipes
+  virtual bool start(const char* mdbPath) = 0;
+
+  // write to MDB stdin; read what's available from MDB stdout (blocks until
+  // something is), nbrRead == 0 when MDB has exited
+  virtual bool write(const char* buf, size_t len)           = 0;
+  virtual bool read(char* buf, size_t size, size_t& nbrRead) = 0;
+
+  // close the pipes
+  virtual void close() = 0;
+
+  // what failed (for MdbSim error messages)
+  inline const char* getErrContext() { return errContext; }
+
+  // platform transport
+  static std::unique_ptr<MdbTransport> create();
+
+  // text of the last OS error ("" if none)
+  static std::string systemError();
+
+protected:
+  const char* errContext = "";
+};
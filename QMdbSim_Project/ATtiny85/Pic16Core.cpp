@@ -0,0 +1,833 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * In-process instruction-set simulator for PIC16 enhanced mid-range devices,
+ * currently the PIC16F15213 (2K words flash, 256 bytes RAM, 64 banks, RA0-RA5).
+ *
+ * Modeled:
+ *
+ *   - all 49 instructions, including MOVIW/MOVWI, ADDFSR, MOVLP, BRA/BRW,
+ *     CALLW, the shadow registers, and the 16-level stack (wraps);
+ *   - banked, linear (FSR 0x2000-0x29AF), and program memory (FSR 0x8000+,
+ *     low byte) data addressing;
+ *   - PORTA/LATA/TRISA/ANSELA (digital input threshold VDD/2; RA3 input-only);
+ *   - Timer0 (8-bit period/16-bit modes, prescaler & postscaler) clocked by
+ *     FOSC/4 -- one count per instruction cycle -- and its interrupt
+ *     (TMR0IF/TMR0IE, GIE); SLEEP until an enabled interrupt flag is set.
+ *
+ * Other SFRs are plain read/write registers:  the firmware can configure any
+ * peripheral, but nothing else happens.  Use the MDB backend for firmware that
+ * needs the ADC, PWM, serial ports, IOC, WDT, etc.
+ *
+ * Instructions are predecoded when the program is loaded, so a step is a table
+ * lookup and a switch.  A step is one instruction regardless of its cycles (as
+ * with MDB stepi); the cycle count only clocks Timer0.
+ */
+
+#include "McuCore.h"
+#include "QMdbSim.h"
+
+#include <string.h>
+
+// PIC16F15213 register addresses (banked, i.e., bank * 0x80 + offset)
+namespace Pic16Reg
+{
+const uint16_t PORTA  = 0x00C;
+const uint16_t TRISA  = 0x012;
+const uint16_t LATA   = 0x018;
+const uint16_t TMR0L  = 0x59C;
+const uint16_t TMR0H  = 0x59D;
+const uint16_t T0CON0 = 0x59E;
+const uint16_t T0CON1 = 0x59F;
+const uint16_t PIR0   = 0x70C;
+const uint16_t PIE0   = 0x716;
+const uint16_t ANSELA = 0x1F38;
+} // namespace Pic16Reg
+
+// STATUS bits
+const uint8_t ST_C  = 0x01;
+const uint8_t ST_DC = 0x02;
+const uint8_t ST_Z  = 0x04;
+
+// INTCON, PIR0/PIE0 bits
+const uint8_t INT_GIE = 0x80;
+const uint8_t TMR0IF  = 0x20;
+
+// predecoded operations
+enum Pic16Op : uint8_t
+{
+  OP_NOP,
+  OP_RESET,
+  OP_RETURN,
+  OP_RETFIE,
+  OP_CALLW,
+  OP_BRW,
+  OP_MOVIW_M, // MOVIW ++FSRn, --FSRn, FSRn++, FSRn--
+  OP_MOVWI_M, // MOVWI ...
+  OP_SLEEP,
+  OP_TRIS,
+  OP_MOVLB,
+  OP_MOVWF,
+  OP_CLRW,
+  OP_CLRF,
+  OP_SUBWF,
+  OP_DECF,
+  OP_IORWF,
+  OP_ANDWF,
+  OP_XORWF,
+  OP_ADDWF,
+  OP_MOVF,
+  OP_COMF,
+  OP_INCF,
+  OP_DECFSZ,
+  OP_RRF,
+  OP_RLF,
+  OP_SWAPF,
+  OP_INCFSZ,
+  OP_BCF,
+  OP_BSF,
+  OP_BTFSC,
+  OP_BTFSS,
+  OP_CALL,
+  OP_GOTO,
+  OP_MOVLW,
+  OP_ADDFSR,
+  OP_MOVLP,
+  OP_BRA,
+  OP_RETLW,
+  OP_LSLF,
+  OP_LSRF,
+  OP_ASRF,
+  OP_IORLW,
+  OP_ANDLW,
+  OP_XORLW,
+  OP_SUBWFB,
+  OP_SUBLW,
+  OP_ADDWFC,
+  OP_ADDLW,
+  OP_MOVIW_K, // MOVIW k[FSRn]
+  OP_MOVWI_K  // MOVWI k[FSRn]
+};
+
+// predecoded instruction:  d is the destination bit, bit number, or FSR
+// number; k is the file address, literal, MOVIW/MOVWI mode, or (sign-extended)
+// offset
+struct Pic16Inst
+{
+  Pic16Op  op;
+  uint8_t  d;
+  uint16_t k;
+};
+
+// sign-extend the low n bits of v
+static inline uint16_t sext(unsigned v, int n)
+{
+  unsigned m = 1u << (n - 1);
+  return uint16_t(((v & ((m << 1) - 1)) ^ m) - m);
+}
+
+static Pic16Inst decode(uint16_t op)
+{
+  uint8_t  f  = op & 0x7F;
+  uint8_t  d  = op >> 7 & 1;
+  uint16_t k8 = op & 0xFF;
+
+  switch (op >> 12)
+  {
+    case 0: // byte-oriented & control
+      if (op < 0x100)
+      {
+        if (op & 0x80) return {OP_MOVWF, 0, f};
+        switch (op)
+        {
+          case 0x01: return {OP_RESET, 0, 0};
+          case 0x08: return {OP_RETURN, 0, 0};
+          case 0x09: return {OP_RETFIE, 0, 0};
+          case 0x0A: return {OP_CALLW, 0, 0};
+          case 0x0B: return {OP_BRW, 0, 0};
+          case 0x63: return {OP_SLEEP, 0, 0};
+          case 0x65:
+          case 0x66:
+          case 0x67: return {OP_TRIS, 0, uint16_t(op & 7)};
+        }
+        if ((op & 0xF0) == 0x10)
+          return {op & 8 ? OP_MOVWI_M : OP_MOVIW_M, uint8_t(op >> 2 & 1),
+              uint16_t(op & 3)};
+        return {OP_NOP, 0, 0}; // NOP, CLRWDT, OPTION, unimplemented
+      }
+      if (op < 0x200)
+      {
+        if (op & 0x80) return {OP_CLRF, 0, f};
+        if (op & 0x40) return {OP_MOVLB, 0, uint16_t(op & 0x3F)};
+        return {OP_CLRW, 0, 0};
+      }
+      {
+        static const Pic16Op byteOps[16] = {OP_NOP, OP_NOP, OP_SUBWF, OP_DECF,
+            OP_IORWF, OP_ANDWF, OP_XORWF, OP_ADDWF, OP_MOVF, OP_COMF, OP_INCF,
+            OP_DECFSZ, OP_RRF, OP_RLF, OP_SWAPF, OP_INCFSZ};
+        return {byteOps[op >> 8 & 0xF], d, f};
+      }
+
+    case 1: // bit-oriented
+    {
+      static const Pic16Op bitOps[4] = {OP_BCF, OP_BSF, OP_BTFSC, OP_BTFSS};
+      return {bitOps[op >> 10 & 3], uint8_t(op >> 7 & 7), f};
+    }
+
+    case 2: // CALL & GOTO
+      return {op & 0x800 ? OP_GOTO : OP_CALL, 0, uint16_t(op & 0x7FF)};
+
+    default: // literal & control
+      switch (op >> 8 & 0xF)
+      {
+        case 0x0: return {OP_MOVLW, 0, k8};
+        case 0x1:
+          if (op & 0x80) return {OP_MOVLP, 0, uint16_t(op & 0x7F)};
+          return {OP_ADDFSR, uint8_t(op >> 6 & 1), sext(op, 6)};
+        case 0x2:
+        case 0x3: return {OP_BRA, 0, sext(op, 9)};
+        case 0x4: return {OP_RETLW, 0, k8};
+        case 0x5: return {OP_LSLF, d, f};
+        case 0x6: return {OP_LSRF, d, f};
+        case 0x7: return {OP_ASRF, d, f};
+        case 0x8: return {OP_IORLW, 0, k8};
+        case 0x9: return {OP_ANDLW, 0, k8};
+        case 0xA: return {OP_XORLW, 0, k8};
+        case 0xB: return {OP_SUBWFB, d, f};
+        case 0xC: return {OP_SUBLW, 0, k8};
+        case 0xD: return {OP_ADDWFC, d, f};
+        case 0xE: return {OP_ADDLW, 0, k8};
+        default:
+          return {op & 0x80 ? OP_MOVWI_K : OP_MOVIW_K, uint8_t(op >> 6 & 1),
+              sext(op, 6)};
+      }
+  }
+}
+
+/*
+ * PIC16 enhanced mid-range core
+ */
+// mutable core state -- a plain struct so saveState()/restoreState() can copy
+// it whole
+struct Pic16State
+{
+  static const int NbrPins = 6; // RA0-RA5
+
+  // CPU
+  uint16_t pc;
+  uint8_t  w, status, bsr, pclath, intcon;
+  uint16_t fsr[2];
+  uint16_t stack[16];
+  int      sp;
+  bool     sleeping;
+  unsigned cycles; // cycles of the current instruction
+
+  // shadow registers (interrupt context)
+  uint8_t  shW, shStatus, shBsr, shPclath;
+  uint16_t shFsr[2];
+
+  // data memory (banked addresses; core registers & common RAM are mirrored)
+  uint8_t ram[0x2000];
+
+  // pins
+  double  vdd = 5.0;
+  double  pinV[NbrPins];
+  uint8_t pinHigh; // input levels (pinV > vdd/2)
+
+  // Timer0
+  unsigned t0Pre;  // prescaler count (cycles)
+  unsigned t0Post; // postscaler count
+  uint8_t  tmr0Hi; // 16-bit mode:  counter high byte (TMR0H is the buffer)
+};
+
+class Pic16Core : public McuCore, protected Pic16State
+{
+public:
+  Pic16Core() { load(NULL); }
+
+  bool load(const char* pgmPath) override;
+  void reset() override;
+  void step() override;
+  int  findPin(const char* pinName) override;
+  void getPin(int pin, PinState& pinState) override;
+  void setPin(int pin, double voltage) override;
+  bool setSupply(const char* pinName, double voltage) override;
+  void saveState(std::vector<uint8_t>& state) override;
+  void restoreState(const std::vector<uint8_t>& state) override;
+
+protected:
+  static const int      FlashSize = 2048; // words
+  static const uint8_t  PinMask   = 0x3F;
+  static const uint8_t  AnselMask = 0x37; // RA3 has no analog function
+  static const uint16_t ElfMachine = 204; // EM_MCHP_PIC
+
+  uint16_t  flash[FlashSize];
+  Pic16Inst code[FlashSize];
+
+  uint8_t read(uint16_t addr);
+  void    write(uint16_t addr, uint8_t v);
+  uint8_t readSfr(uint16_t addr);
+  void    writeSfr(uint16_t addr, uint8_t v);
+  uint8_t readInd(uint16_t fa);
+  void    writeInd(uint16_t fa, uint8_t v);
+
+  void timer0();
+  void t0Count();
+
+  // banked address of file register f
+  inline uint16_t fileAddr(uint16_t f) { return f >= 0x70 ? f : bsr << 7 | f; }
+
+  inline void push(uint16_t addr)
+  {
+    stack[sp] = addr;
+    sp        = (sp + 1) & 15;
+  }
+  inline uint16_t pop()
+  {
+    sp = (sp - 1) & 15;
+    return stack[sp];
+  }
+
+  inline void setZ(uint8_t r) { status = (status & ~ST_Z) | (r ? 0 : ST_Z); }
+
+  // a + b + c with C, DC, & Z (subtraction is a + ~b + 1)
+  inline uint8_t add(uint8_t a, uint8_t b, unsigned c)
+  {
+    unsigned r  = a + b + c;
+    unsigned dc = (a & 0xF) + (b & 0xF) + c;
+    status      = (status & ~(ST_C | ST_DC)) | (r > 0xFF ? ST_C : 0) |
+             (dc > 0xF ? ST_DC : 0);
+    setZ(uint8_t(r));
+    return uint8_t(r);
+  }
+
+  // result to W (d = 0) or the file register (d = 1)
+  inline void dest(const Pic16Inst& in, uint16_t addr, uint8_t r)
+  {
+    if (in.d)
+      write(addr, r);
+    else
+      w = r;
+  }
+
+  inline void skip()
+  {
+    pc = (pc + 1) & 0x7FFF;
+    cycles++;
+  }
+
+  inline bool intPending() { return ram[Pic16Reg::PIR0] & ram[Pic16Reg::PIE0]; }
+};
+
+McuCore* newPic16Core(const char* deviceName)
+{
+  if (strcmp(deviceName, "PIC16F15213")) return NULL;
+  return new Pic16Core;
+}
+
+// load ELF (word addresses) or HEX (byte addresses) program memory; config
+// words (0x8000+) are ignored.  NULL loads an erased device.
+bool Pic16Core::load(const char* pgmPath)
+{
+  for (uint16_t& op : flash) op = 0x3FFF;
+
+  std::vector<Segment> segments;
+  bool                 isElf;
+  if (pgmPath && !loadSegments(pgmPath, ElfMachine, segments, isElf))
+    return false;
+
+  for (const Segment& seg : segments)
+  {
+    uint32_t addr = isElf ? seg.addr : seg.addr / 2;
+    for (size_t i = 0; i + 1 < seg.bytes.size(); i += 2, addr++)
+      if (addr < FlashSize)
+        flash[addr] = (seg.bytes[i] | seg.bytes[i + 1] << 8) & 0x3FFF;
+  }
+
+  for (int i = 0; i < FlashSize; i++) code[i] = decode(flash[i]);
+
+  // pins float low until set.  the external inputs aren't core state, so
+  // reset() (also the RESET instruction) keeps them
+  for (double& v : pinV) v = 0;
+  pinHigh = 0;
+
+  reset();
+  return true;
+}
+
+void Pic16Core::reset()
+{
+  using namespace Pic16Reg;
+
+  memset(ram, 0, sizeof(ram));
+  pc = w = bsr = pclath = intcon = 0;
+  status   = 0x18; // /TO, /PD
+  fsr[0]   = fsr[1] = 0;
+  sp       = 0;
+  sleeping = false;
+  shW = shStatus = shBsr = shPclath = 0;
+  shFsr[0] = shFsr[1] = 0;
+
+  ram[TRISA]  = PinMask;
+  ram[ANSELA] = AnselMask;
+  ram[TMR0H]  = 0xFF;
+  t0Pre = t0Post = 0;
+  tmr0Hi         = 0;
+}
+
+void Pic16Core::step()
+{
+  cycles = 1;
+
+  // interrupt -- vectoring takes the step
+  if (intPending())
+  {
+    sleeping = false;
+    if (intcon & INT_GIE)
+    {
+      push(pc);
+      shW      = w;
+      shStatus = status;
+      shBsr    = bsr;
+      shPclath = pclath;
+      shFsr[0] = fsr[0];
+      shFsr[1] = fsr[1];
+      intcon &= ~INT_GIE;
+      pc     = 4;
+      cycles = 2;
+      timer0();
+      return;
+    }
+  }
+  if (sleeping) return; // FOSC stopped, so Timer0 too
+
+  const Pic16Inst& in = code[pc & (FlashSize - 1)];
+  pc                  = (pc + 1) & 0x7FFF;
+
+  uint16_t addr;
+  uint8_t  r;
+  switch (in.op)
+  {
+    case OP_NOP: break;
+    case OP_RESET: reset(); return;
+    case OP_RETURN:
+      pc     = pop();
+      cycles = 2;
+      break;
+    case OP_RETFIE:
+      pc     = pop();
+      w      = shW;
+      status = shStatus;
+      bsr    = shBsr;
+      pclath = shPclath;
+      fsr[0] = shFsr[0];
+      fsr[1] = shFsr[1];
+      intcon |= INT_GIE;
+      cycles = 2;
+      break;
+    case OP_CALLW:
+      push(pc);
+      pc     = pclath << 8 | w;
+      cycles = 2;
+      break;
+    case OP_BRW:
+      pc     = (pc + w) & 0x7FFF;
+      cycles = 2;
+      break;
+    case OP_MOVIW_M:
+    case OP_MOVWI_M:
+    {
+      uint16_t& f = fsr[in.d];
+      if (in.k == 0) f++; // ++FSRn
+      if (in.k == 1) f--; // --FSRn
+      if (in.op == OP_MOVIW_M)
+        setZ(w = readInd(f));
+      else
+        writeInd(f, w);
+      if (in.k == 2) f++; // FSRn++
+      if (in.k == 3) f--; // FSRn--
+      break;
+    }
+    case OP_SLEEP:
+      sleeping = true;
+      status &= ~0x08; // /PD
+      break;
+    case OP_TRIS:
+      if (in.k == 5) write(Pic16Reg::TRISA, w);
+      break;
+    case OP_MOVLB: bsr = uint8_t(in.k); break;
+    case OP_MOVWF: write(fileAddr(in.k), w); break;
+    case OP_CLRW: setZ(w = 0); break;
+    case OP_CLRF:
+      write(fileAddr(in.k), 0);
+      setZ(0);
+      break;
+    case OP_SUBWF:
+      addr = fileAddr(in.k);
+      dest(in, addr, add(read(addr), ~w, 1));
+      break;
+    case OP_DECF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr) - 1);
+      dest(in, addr, r);
+      break;
+    case OP_IORWF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr) | w);
+      dest(in, addr, r);
+      break;
+    case OP_ANDWF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr) & w);
+      dest(in, addr, r);
+      break;
+    case OP_XORWF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr) ^ w);
+      dest(in, addr, r);
+      break;
+    case OP_ADDWF:
+      addr = fileAddr(in.k);
+      dest(in, addr, add(read(addr), w, 0));
+      break;
+    case OP_MOVF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr));
+      dest(in, addr, r);
+      break;
+    case OP_COMF:
+      addr = fileAddr(in.k);
+      setZ(r = ~read(addr));
+      dest(in, addr, r);
+      break;
+    case OP_INCF:
+      addr = fileAddr(in.k);
+      setZ(r = read(addr) + 1);
+      dest(in, addr, r);
+      break;
+    case OP_DECFSZ:
+      addr = fileAddr(in.k);
+      dest(in, addr, r = read(addr) - 1);
+      if (!r) skip();
+      break;
+    case OP_RRF:
+      addr = fileAddr(in.k);
+      r    = read(addr);
+      {
+        uint8_t c = status & ST_C;
+        status    = (status & ~ST_C) | (r & 1);
+        dest(in, addr, uint8_t(r >> 1 | c << 7));
+      }
+      break;
+    case OP_RLF:
+      addr = fileAddr(in.k);
+      r    = read(addr);
+      {
+        uint8_t c = status & ST_C;
+        status    = (status & ~ST_C) | (r >> 7);
+        dest(in, addr, uint8_t(r << 1 | c));
+      }
+      break;
+    case OP_SWAPF:
+      addr = fileAddr(in.k);
+      r    = read(addr);
+      dest(in, addr, uint8_t(r << 4 | r >> 4));
+      break;
+    case OP_INCFSZ:
+      addr = fileAddr(in.k);
+      dest(in, addr, r = read(addr) + 1);
+      if (!r) skip();
+      break;
+    case OP_BCF:
+      addr = fileAddr(in.k);
+      write(addr, read(addr) & ~(1 << in.d));
+      break;
+    case OP_BSF:
+      addr = fileAddr(in.k);
+      write(addr, read(addr) | 1 << in.d);
+      break;
+    case OP_BTFSC:
+      if (!(read(fileAddr(in.k)) >> in.d & 1)) skip();
+      break;
+    case OP_BTFSS:
+      if (read(fileAddr(in.k)) >> in.d & 1) skip();
+      break;
+    case OP_CALL:
+      push(pc);
+      pc     = (pclath & 0x78) << 8 | in.k;
+      cycles = 2;
+      break;
+    case OP_GOTO:
+      pc     = (pclath & 0x78) << 8 | in.k;
+      cycles = 2;
+      break;
+    case OP_MOVLW: w = uint8_t(in.k); break;
+    case OP_ADDFSR: fsr[in.d] += in.k; break;
+    case OP_MOVLP: pclath = uint8_t(in.k); break;
+    case OP_BRA:
+      pc     = (pc + in.k) & 0x7FFF;
+      cycles = 2;
+      break;
+    case OP_RETLW:
+      w      = uint8_t(in.k);
+      pc     = pop();
+      cycles = 2;
+      break;
+    case OP_LSLF:
+      addr   = fileAddr(in.k);
+      r      = read(addr);
+      status = (status & ~ST_C) | (r >> 7);
+      setZ(r <<= 1);
+      dest(in, addr, r);
+      break;
+    case OP_LSRF:
+      addr   = fileAddr(in.k);
+      r      = read(addr);
+      status = (status & ~ST_C) | (r & 1);
+      setZ(r >>= 1);
+      dest(in, addr, r);
+      break;
+    case OP_ASRF:
+      addr   = fileAddr(in.k);
+      r      = read(addr);
+      status = (status & ~ST_C) | (r & 1);
+      setZ(r = uint8_t(r >> 1 | (r & 0x80)));
+      dest(in, addr, r);
+      break;
+    case OP_IORLW: setZ(w |= in.k); break;
+    case OP_ANDLW: setZ(w &= in.k); break;
+    case OP_XORLW: setZ(w ^= in.k); break;
+    case OP_SUBWFB:
+      addr = fileAddr(in.k);
+      dest(in, addr, add(read(addr), ~w, status & ST_C));
+      break;
+    case OP_SUBLW: w = add(uint8_t(in.k), ~w, 1); break;
+    case OP_ADDWFC:
+      addr = fileAddr(in.k);
+      dest(in, addr, add(read(addr), w, status & ST_C));
+      break;
+    case OP_ADDLW: w = add(uint8_t(in.k), w, 0); break;
+    case OP_MOVIW_K: setZ(w = readInd(fsr[in.d] + in.k)); break;
+    case OP_MOVWI_K: writeInd(fsr[in.d] + in.k, w); break;
+  }
+
+  timer0();
+}
+
+// data memory access.  core registers (offsets 0x00-0x0B) and common RAM
+// (0x70-0x7F) are the same in every bank; SFRs are 0x0C-0x1F (and ANSELA,
+// written through writeSfr() for its mask).
+uint8_t Pic16Core::read(uint16_t addr)
+{
+  uint8_t off = addr & 0x7F;
+  if (off >= 0x70) return ram[off];
+  if (off >= 0x20) return ram[addr];
+  switch (off)
+  {
+    case 0x00: return readInd(fsr[0]);
+    case 0x01: return readInd(fsr[1]);
+    case 0x02: return uint8_t(pc);
+    case 0x03: return status;
+    case 0x04: return uint8_t(fsr[0]);
+    case 0x05: return uint8_t(fsr[0] >> 8);
+    case 0x06: return uint8_t(fsr[1]);
+    case 0x07: return uint8_t(fsr[1] >> 8);
+    case 0x08: return bsr;
+    case 0x09: return w;
+    case 0x0A: return pclath;
+    case 0x0B: return intcon;
+  }
+  return readSfr(addr);
+}
+
+void Pic16Core::write(uint16_t addr, uint8_t v)
+{
+  uint8_t off = addr & 0x7F;
+  if (off >= 0x70)
+    ram[off] = v;
+  else if (off >= 0x20 && addr != Pic16Reg::ANSELA)
+    ram[addr] = v;
+  else
+    switch (off)
+    {
+      case 0x00: writeInd(fsr[0], v); break;
+      case 0x01: writeInd(fsr[1], v); break;
+      case 0x02: // computed goto
+        pc = (pclath << 8 | v) & 0x7FFF;
+        cycles++;
+        break;
+      case 0x03: status = (status & 0x18) | (v & 0x07); break;
+      case 0x04: fsr[0] = (fsr[0] & 0xFF00) | v; break;
+      case 0x05: fsr[0] = (fsr[0] & 0x00FF) | v << 8; break;
+      case 0x06: fsr[1] = (fsr[1] & 0xFF00) | v; break;
+      case 0x07: fsr[1] = (fsr[1] & 0x00FF) | v << 8; break;
+      case 0x08: bsr = v & 0x3F; break;
+      case 0x09: w = v; break;
+      case 0x0A: pclath = v & 0x7F; break;
+      case 0x0B: intcon = v; break;
+      default: writeSfr(addr, v);
+    }
+}
+
+uint8_t Pic16Core::readSfr(uint16_t addr)
+{
+  using namespace Pic16Reg;
+
+  switch (addr)
+  {
+    case PORTA:
+      // digital input buffers are off for analog pins
+      return ~ram[ANSELA] &
+             ((ram[TRISA] & pinHigh) | (~ram[TRISA] & ram[LATA])) & PinMask;
+    case TMR0L:
+      // 16-bit mode:  reading TMR0L latches the high byte into TMR0H
+      if (ram[T0CON0] & 0x10) ram[TMR0H] = tmr0Hi;
+      break;
+  }
+  return ram[addr];
+}
+
+void Pic16Core::writeSfr(uint16_t addr, uint8_t v)
+{
+  using namespace Pic16Reg;
+
+  switch (addr)
+  {
+    case PORTA: ram[LATA] = v & PinMask; return;
+    case LATA: v &= PinMask; break;
+    case TRISA: v = (v & PinMask) | 0x08; break;
+    case ANSELA: v &= AnselMask; break;
+    case TMR0L:
+      // 16-bit mode:  writing TMR0L loads the high byte from TMR0H
+      if (ram[T0CON0] & 0x10) tmr0Hi = ram[TMR0H];
+      t0Pre = 0;
+      break;
+    case T0CON0: v = (v & ~0x20) | (ram[T0CON0] & 0x20); break; // OUT is r/o
+  }
+  ram[addr] = v;
+}
+
+// indirect (FSR) access:  banked 0x0000-0x1FFF, linear GPR 0x2000-0x29AF,
+// program memory (low byte, read-only) 0x8000-0xFFFF
+uint8_t Pic16Core::readInd(uint16_t fa)
+{
+  if (fa < 0x2000) return (fa & 0x7F) < 2 ? 0 : read(fa);
+  if (fa < 0x29B0)
+  {
+    unsigned n = fa - 0x2000;
+    return ram[(n / 80) << 7 | (0x20 + n % 80)];
+  }
+  if (fa >= 0x8000) return uint8_t(flash[(fa - 0x8000) & (FlashSize - 1)]);
+  return 0;
+}
+
+void Pic16Core::writeInd(uint16_t fa, uint8_t v)
+{
+  if (fa < 0x2000)
+  {
+    if ((fa & 0x7F) >= 2) write(fa, v);
+  }
+  else if (fa < 0x29B0)
+  {
+    unsigned n = fa - 0x2000;
+    ram[(n / 80) << 7 | (0x20 + n % 80)] = v;
+  }
+}
+
+// clock Timer0 for the current instruction's cycles (FOSC/4 source only)
+void Pic16Core::timer0()
+{
+  using namespace Pic16Reg;
+
+  if (!(ram[T0CON0] & 0x80) || (ram[T0CON1] >> 5) != 2) return;
+
+  unsigned prescale = 1u << (ram[T0CON1] & 0x0F);
+  for (t0Pre += cycles; t0Pre >= prescale; t0Pre -= prescale) t0Count();
+}
+
+// one Timer0 count:  8-bit mode counts TMR0L up to the TMR0H period; 16-bit
+// mode counts TMR0H:TMR0L to overflow.  the postscaler divides the matches or
+// overflows by T0OUTPS + 1 to set TMR0IF.
+void Pic16Core::t0Count()
+{
+  using namespace Pic16Reg;
+
+  if (ram[T0CON0] & 0x10)
+  {
+    if (++ram[TMR0L] || ++tmr0Hi) return;
+  }
+  else if (ram[TMR0L] != ram[TMR0H])
+  {
+    ram[TMR0L]++;
+    return;
+  }
+  else
+    ram[TMR0L] = 0;
+
+  if (++t0Post > (ram[T0CON0] & 0x0Fu))
+  {
+    t0Post = 0;
+    ram[PIR0] |= TMR0IF;
+    ram[T0CON0] ^= 0x20; // OUT
+  }
+}
+
+int Pic16Core::findPin(const char* pinName)
+{
+  if (pinName[0] != 'R' || pinName[1] != 'A' || pinName[2] < '0' ||
+      pinName[2] >= '0' + NbrPins || pinName[3])
+    return -1;
+  return pinName[2] - '0';
+}
+
+// pin state as MDB reports it:  output pins at the LATA level, analog inputs
+// at their voltage, digital inputs at their logic level
+void Pic16Core::getPin(int pin, PinState& pinState)
+{
+  using namespace Pic16Reg;
+
+  bool analog      = ram[ANSELA] >> pin & 1;
+  bool input       = ram[TRISA] >> pin & 1;
+  pinState.daState = analog ? PIN_ANALOG : PIN_DIGITAL;
+  pinState.ioState = input ? PIN_INPUT : PIN_OUTPUT;
+  if (!input)
+    pinState.voltage = ram[LATA] >> pin & 1 ? vdd : 0;
+  else if (analog)
+    pinState.voltage = pinV[pin];
+  else
+    pinState.voltage = pinHigh >> pin & 1 ? vdd : 0;
+}
+
+void Pic16Core::setPin(int pin, double voltage)
+{
+  pinV[pin] = voltage;
+  if (voltage > vdd / 2)
+    pinHigh |= 1 << pin;
+  else
+    pinHigh &= ~(1 << pin);
+}
+
+bool Pic16Core::setSupply(const char* pinName, double voltage)
+{
+  if (strcmp(pinName, "VDD")) return false;
+  vdd = voltage;
+  for (int pin = 0; pin < NbrPins; pin++) setPin(pin, pinV[pin]);
+  return true;
+}
+
+void Pic16Core::saveState(std::vector<uint8_t>& state)
+{
+  const uint8_t* p = (const uint8_t*)static_cast<Pic16State*>(this);
+  state.assign(p, p + sizeof(Pic16State));
+}
+
+void Pic16Core::restoreState(const std::vector<uint8_t>& state)
+{
+  if (state.size() != sizeof(Pic16State)) return;
+  memcpy(static_cast<Pic16State*>(this), state.data(), sizeof(Pic16State));
+}
@@ -18,7 +18,17 @@
 
 #include "QMdbSim.h"
 
-#pragma warning(disable : 4996) // we'll take our chances...
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#  pragma warning(disable : 4996) // we'll take our chances...
+#endif
+
+using Clock = std::chrono::steady_clock;
 
 // version information
 #ifdef _DEBUG
@@ -26,29 +36,148 @@
 #else
 #  define DBG_TXT ""
 #endif
-static const char* VersionInfo = "QMdbSim v0.3.1" DBG_TXT;
+static const char* VersionInfo = "QMdbSim v0.13.0" DBG_TXT;
 
 const char* gMdbSimPath = 0; // user-supplied path to MDB.bat
 
-char MdbSim::recvBuf[2048]; // shared buffer for MDB reads (caution!)
+static const size_t RxBufSize = 16384; // initial receive buffer size
+
+// max bytes of commands per MDB write.  MDB answers only after reading a whole
+// batch and its responses are several times larger, so a batch must fit the
+// stdin pipe buffer (4 KB by default on Windows) or both ends block.
+static const size_t CmdChunk = 2048;
+
+/*
+ * MDB process pool
+ *
+ * Starting MDB -- the JVM, then device, hwtool, and program -- takes seconds
+ * per instance and per .step run.  So stopSim() resets the device and returns
+ * the MDB process to a pool, keyed by device and program file contents, and
+ * startSim() takes a pooled process when the key matches.
+ *
+ * startSim() also pre-warms a spare process for the next instance or .step
+ * run:  the startup commands are written to its stdin up front and MDB works
+ * through them while QSpice carries on initializing; the responses are checked
+ * when the process is taken.  There are no pool threads -- MDB is the
+ * background worker.
+ */
+struct PooledMdb
+{
+  std::string                   key;
+  std::unique_ptr<MdbTransport> transport;
+  bool fresh = false; // startup commands pending (else a reset is pending)
+};
+
+class MdbPool
+{
+public:
+  ~MdbPool()
+  {
+    for (PooledMdb& mdb : idle) quit(mdb);
+  }
+
+  // take an idle process for key (most recently pooled first)
+  bool take(const std::string& key, PooledMdb& mdb)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = idle.size(); i--;)
+      if (idle[i].key == key)
+      {
+        mdb = std::move(idle[i]);
+        idle.erase(idle.begin() + i);
+        return true;
+      }
+    return false;
+  }
+
+  // add a process to the pool, quitting the oldest one if the pool is full
+  void put(PooledMdb&& mdb)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() >= MaxIdle)
+    {
+      quit(idle.front());
+      idle.erase(idle.begin());
+    }
+    idle.push_back(std::move(mdb));
+  }
+
+  bool hasIdle(const std::string& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const PooledMdb& mdb : idle)
+      if (mdb.key == key) return true;
+    return false;
+  }
+
+protected:
+  static const size_t MaxIdle = 8;
+
+  std::mutex             mutex;
+  std::vector<PooledMdb> idle;
+
+  // MDB exits on quit (or when its stdin is closed)
+  static void quit(PooledMdb& mdb)
+  {
+    mdb.transport->write("quit\r\n", 6);
+    mdb.transport.reset();
+  }
+};
+
+static MdbPool gMdbPool;
+
+// pool key:  device name & a hash (64-bit FNV-1a) of the program file, so a
+// rebuilt program isn't run from a stale process
+static std::string makePoolKey(const char* deviceName, const char* pgmPath)
+{
+  uint64_t hash = 14695981039346656037ull;
+  FILE*    file = fopen(pgmPath, "rb");
+  if (file)
+  {
+    unsigned char buf[65536];
+    size_t        len;
+    while ((len = fread(buf, 1, sizeof(buf), file)))
+      for (size_t i = 0; i < len; i++)
+        hash = (hash ^ buf[i]) * 1099511628211ull;
+    fclose(file);
+  }
+
+  char hex[24];
+  snprintf(hex, sizeof(hex), "|%016llx", (unsigned long long) hash);
+  return std::string(deviceName) + hex + (file ? "" : pgmPath);
+}
+
+// start MDB and queue the startup commands (startup banner, device, hwtool,
+// and program responses are then pending -- see MdbSim::startSim())
+static bool launchMdb(
+    MdbTransport& transport, const char* deviceName, const char* pgmPath)
+{
+  if (!transport.start(gMdbSimPath)) return false;
+
+  std::string cmd = "device ";
+  cmd += deviceName;
+  cmd += "\r\nhwtool SIM\r\nprogram ";
+  cmd += pgmPath;
+  cmd += "\r\n";
+  return transport.write(cmd.c_str(), cmd.size());
+}
 
 /*
  * MdbSim class implementation
  */
 
-MdbSim::MdbSim() {}
+MdbSim::MdbSim() : transport(MdbTransport::create()), rxBuf(RxBufSize) {}
 
 MdbSim::~MdbSim()
 {
   if (simState == Running) stopSim();
+  stopReader();
 }
 
 const char* MdbSim::getVerInfo() { return VersionInfo; }
 
 bool MdbSim::startSim(const char* deviceName, const char* pgmPath)
 {
-  std::string cmd;
-
   if (simState != NotStarted)
   {
     if (simState != ErrState) setError("startSim(invalid state)");
@@ -59,39 +188,79 @@ bool MdbSim::startSim(const char* deviceName, const char* pgmPath)
   sDevName = deviceName;
   sPgmPath = pgmPath;
 
-  // create stdio pipes for MDB communication
-  if (!createPipes()) return false;
+  // in-process core, if requested and there is one for the device
+  if (nativeCore && (core = McuCore::create(deviceName)))
+  {
+    if (!core->load(pgmPath))
+    {
+      setError(core->getErrContext());
+      return false;
+    }
+    for (PinPortMap& ppMap : ppmList)
+      if ((ppMap.corePin = core->findPin(ppMap.pinName)) < 0)
+      {
+        setError("startSim(unknown pin name)");
+        return false;
+      }
+    return true;
+  }
 
-  // start the MDB Java program
-  if (!createMdbProcess()) return false;
+  poolKey = makePoolKey(deviceName, pgmPath);
+
+  // take a warm MDB process from the pool or start the MDB Java program
+  PooledMdb pooled;
+  if (gMdbPool.take(poolKey, pooled))
+    transport = std::move(pooled.transport);
+  else if (!launchMdb(*transport, deviceName, pgmPath))
+  {
+    setError(transport->getErrContext());
+    return false;
+  }
+  else
+    pooled.fresh = true;
 
-  // read until prompt; expecting nothing but prompt
-  if (!recvBuffer()) return false;
+  // pre-warm a spare process for the next instance or .step run
+  if (!gMdbPool.hasIdle(poolKey))
+  {
+    PooledMdb spare;
+    spare.key       = poolKey;
+    spare.transport = MdbTransport::create();
+    spare.fresh     = true;
+    if (launchMdb(*spare.transport, deviceName, pgmPath))
+      gMdbPool.put(std::move(spare));
+  }
+
+  // pooled process -- expecting the prompt after the device reset
+  if (!pooled.fresh)
+  {
+    if (!recvBuffer())
+    {
+      setError("startSim(reset pooled MDB)");
+      return false;
+    }
+    return true;
+  }
+
+  // new process -- receive the startup prompt and the device, hwtool, and
+  // program responses
+  if (!recvResponses(4)) return false;
 
   // set sim device; expecting only prompt
-  cmd = "device ";
-  cmd += deviceName;
-  cmd += "\r\n";
-  if (!sendRecvBuffer(cmd.c_str()) || sList.size())
+  if (respSize(1))
   {
     setError("startSim(set device)");
     return false;
   }
 
   // set sim device; expecting last line == "Resetting peripherals"
-  if (!sendRecvBuffer("hwtool SIM\r\n") ||
-      sList.back().compare("Resetting peripherals"))
+  if (!respSize(2) || respLine(2, respSize(2) - 1) != "Resetting peripherals")
   {
     setError("startSim(set hwtool=SIM)");
     return false;
   }
 
   // set program; expecting last line == "Program succeeded."
-  cmd = "program ";
-  cmd += pgmPath;
-  cmd += "\r\n";
-  if (!sendRecvBuffer(cmd.c_str()) ||
-      sList.back().compare("Program succeeded."))
+  if (!respSize(3) || respLine(3, respSize(3) - 1) != "Program succeeded.")
   {
     setError("startSim(set program)");
     return false;
@@ -109,7 +278,27 @@ bool MdbSim::stopSim()
     setError("stopSim(not started)");
     return false;
   }
-  if (simState == Running && !sendBuffer("quit\r\n")) return false;
+  if (core)
+  {
+    simState = Stopped;
+    return true;
+  }
+
+  bool recvOk = stopReader();
+
+  // return the MDB process to the pool (device reset pending) if its output
+  // has all been received, else quit it
+  if (simState == Running && recvOk && rxHead == rxTail &&
+      transport->write("reset\r\n", 7))
+  {
+    PooledMdb pooled;
+    pooled.key       = poolKey;
+    pooled.transport = std::move(transport);
+    gMdbPool.put(std::move(pooled));
+    transport = MdbTransport::create();
+  }
+  else if (simState == Running && !sendBuffer("quit\r\n"))
+    return false;
 
   simState = Stopped;
   return true;
@@ -145,8 +334,19 @@ bool MdbSim::stepInst()
     return false;
   }
 
+  if (core)
+  {
+    core->step();
+    stepCount++;
+    ckptCurrent = false;
+    return true;
+  }
+
   // fails only if MDB read/write error, i.e., no error response to check
-  return sendRecvBuffer("stepi\r\n");
+  if (!sendRecvBuffer("stepi\r\n")) return false;
+  journalSteps(1);
+  stepCount++;
+  return true;
 }
 
 // get pin state information; we're expecting something like this:
@@ -164,31 +364,57 @@ bool MdbSim::getPinState(const char* pinName, PinState& pinState)
     return false;
   }
 
-  // note:  probabaly should rework for (faster?) non-std::string version
-  std::string cmd;
-  cmd = "print pin ";
-  cmd += pinName;
-  cmd += "\r\n";
-  if (!sendRecvBuffer(cmd.c_str()))
+  if (core)
+  {
+    int pin = core->findPin(pinName);
+    if (pin < 0)
+    {
+      setError("getPin(unexpected response, check pin name)");
+      return false;
+    }
+    core->getPin(pin, pinState);
+    return true;
+  }
+
+  cmdBuf = "print pin ";
+  cmdBuf += pinName;
+  cmdBuf += "\r\n";
+  if (!sendRecvBuffer(cmdBuf.c_str()))
   {
     setError("getPin(I/O failed)");
     return false;
   }
 
-  if (sList.size() != 2)
+  if (respSize(0) != 2)
   {
     setError("getPin(unexpected response, check pin name)");
     return false;
   }
 
-  // strtok() modifies string; using a fixed sized buffer here (caution!)
-  static char str[256];
-  strncpy(str, sList[1].c_str(), sizeof(str));
-  char* name  = strtok(str, " \t\r\n");
-  char* mode  = strtok(NULL, " \t\r\n");
-  char* value = strtok(NULL, " \t\r\n");
+  return parsePinState(respLine(0, 1), pinState);
+}
 
-  if (!mode || strlen(mode) < 3 || !value || strlen(value) < 3)
+// parse a "print pin" response line, i.e.:
+//
+//   RA0     Ain     5.0V    (RA0)/IOCA0/ANA0/ICDDAT/ICSPDAT
+//
+bool MdbSim::parsePinState(std::string_view line, PinState& pinState)
+{
+  // split into name, mode, and value fields
+  std::string_view field[3];
+  size_t           pos = 0;
+  for (std::string_view& fld : field)
+  {
+    pos = line.find_first_not_of(" \t", pos);
+    if (pos == line.npos) break;
+    size_t end = line.find_first_of(" \t", pos);
+    fld        = line.substr(pos, end - pos);
+    pos        = end;
+  }
+  std::string_view mode  = field[1];
+  std::string_view value = field[2];
+
+  if (mode.size() < 3 || value.size() < 3)
   {
     setError("getPin(invalid values)");
     return false;
@@ -200,8 +426,13 @@ bool MdbSim::getPinState(const char* pinName, PinState& pinState)
   // if it's an analog pin, get voltage from MDB, else set from hlState
   if (pinState.daState == PIN_ANALOG)
   {
+    // strtod() needs a terminated string
+    char   volts[32];
+    size_t len = value.copy(volts, sizeof(volts) - 1);
+    volts[len] = '\0';
+
     char* nextChar;
-    pinState.voltage = strtod(value, &nextChar);
+    pinState.voltage = strtod(volts, &nextChar);
     if (*nextChar != 'V')
     {
       setError("getPin(invalid voltage)");
@@ -225,34 +456,53 @@ bool MdbSim::setPin(const char* pinName, double toVoltage)
     return false;
   }
 
-  // clip voltage to valid range for MDB to filter possible QSpice input spikes
-  if (toVoltage > vddV) toVoltage = vddV;
-  if (toVoltage < 0) toVoltage = 0;
+  if (core)
+  {
+    ckptCurrent = false;
+    if (core->setSupply(pinName, toVoltage)) return true;
+    int pin = core->findPin(pinName);
+    if (pin < 0)
+    {
+      setError("setPin(write pin error)");
+      return false;
+    }
+    core->setPin(pin, clipVoltage(toVoltage));
+    return true;
+  }
 
-  // probably should rework to avoid std::string for speed....
-  std::string cmd;
-  cmd = "write pin ";
-  cmd += pinName;
-  cmd += " ";
-  cmd += std::to_string(toVoltage); // TODO: check precision, etc.
-  cmd += "V\r\n";
+  cmdBuf.clear();
+  addSetPinCmd(pinName, toVoltage);
 
-  if (!sendRecvBuffer(cmd.c_str()))
+  if (!sendRecvBuffer(cmdBuf.c_str()))
   {
     setError("setPin(I/O failure)");
     return false;
   }
 
   // we expect nothing but prompt on success
-  if (sList.size())
+  if (respSize(0))
   {
     setError("setPin(write pin error)");
     return false;
   }
 
+  journalWrite(pinName, clipVoltage(toVoltage));
   return true;
 }
 
+// append a "write pin" command to cmdBuf
+void MdbSim::addSetPinCmd(const char* pinName, double toVoltage)
+{
+  // TODO: check precision, etc.
+  char volts[32];
+  snprintf(volts, sizeof(volts), "%f", clipVoltage(toVoltage));
+  cmdBuf += "write pin ";
+  cmdBuf += pinName;
+  cmdBuf += " ";
+  cmdBuf += volts;
+  cmdBuf += "V\r\n";
+}
+
 // add pin/port/name mapping to PinPortMap list
 void MdbSim::addPinPortMap(const char* const pinName, double* const inPort,
     double* const outPort, bool* const dirPort)
@@ -260,11 +510,16 @@ void MdbSim::addPinPortMap(const char* const pinName, double* const inPort,
   ppmList.push_back(PinPortMap(pinName, inPort, outPort, dirPort));
 }
 
-// get pin states from MDB
+// get pin states from MDB; input-only pins are read only once
 bool MdbSim::getPinStates()
 {
+  PinState pinState;
   for (PinPortMap& ppMap : ppmList)
-    if (!getPinState(ppMap.pinName, ppMap.pinState)) return false;
+  {
+    if (ppMap.stateValid && ppMap.isInputOnly()) continue;
+    if (!getPinState(ppMap.pinName, pinState)) return false;
+    ppMap.setPinState(pinState);
+  }
   return true;
 }
 
@@ -275,15 +530,58 @@ void MdbSim::setCtrlPorts()
     if (ppMap.dirPort) *ppMap.dirPort = ppMap.pinState.ioState;
 }
 
-// set MDB input pins from QSpice input ports
+// set MDB input pins from QSpice input ports (changed inputs only)
 bool MdbSim::setInPins()
 {
   for (PinPortMap& ppMap : ppmList)
-    if (ppMap.pinState.isInput() && ppMap.inPort)
-      if (!setPin(ppMap.pinName, *ppMap.inPort)) return false;
+    if (inputChanged(ppMap))
+    {
+      if (!setPin(ppMap.pinName, inputVoltage(ppMap))) return false;
+      inputSent(ppMap);
+    }
   return true;
 }
 
+// clip voltage to valid range for MDB to filter possible QSpice input spikes
+double MdbSim::clipVoltage(double v)
+{
+  if (v > vddV) return vddV;
+  if (v < 0) return 0;
+  return v;
+}
+
+// voltage to write to MDB for the QSpice input port of an MDB input pin:
+// the logic level rail (0 or vddV) for digital inputs -- they are written only
+// on logic level changes, so a raw voltage near vddV/2 would never be
+// refreshed -- else the clipped port voltage
+double MdbSim::inputVoltage(const PinPortMap& ppMap)
+{
+  double v = clipVoltage(*ppMap.inPort);
+  if (ppMap.pinState.isDigital()) return v > vddV / 2 ? vddV : 0;
+  return v;
+}
+
+// true if the QSpice input port of an MDB input pin has changed enough since
+// it was last written to MDB:  a logic level change for digital inputs or a
+// change of at least analogThreshold (any change if 0) for analog inputs
+bool MdbSim::inputChanged(const PinPortMap& ppMap)
+{
+  if (!ppMap.pinState.isInput() || !ppMap.inPort) return false;
+  if (!ppMap.sentValid) return true;
+
+  double v = inputVoltage(ppMap);
+  if (ppMap.pinState.isDigital()) return v != ppMap.lastSent;
+  double dv = fabs(v - ppMap.lastSent);
+  return analogThreshold > 0 ? dv >= analogThreshold : dv > 0;
+}
+
+// record the input voltage written to MDB
+void MdbSim::inputSent(PinPortMap& ppMap)
+{
+  ppMap.lastSent  = inputVoltage(ppMap);
+  ppMap.sentValid = true;
+}
+
 // set QSpice output ports from MDB output pins
 void MdbSim::setOutPorts()
 {
@@ -291,161 +589,560 @@ void MdbSim::setOutPorts()
     if (ppMap.outPort) *ppMap.outPort = ppMap.pinState.voltage;
 }
 
-// set nominal VDD (max MDB input pin value and returned digital "HIGH" value)
-bool MdbSim::setVDD(const char* vddName, double vdd)
+// set input pins, step one instruction, and get pin states with a single write
+// of all commands to MDB and a single pass over the concatenated responses.
+// equivalent to setInPins(), stepInst(), getPinStates() but without waiting on
+// 2N+1 MDB prompts.  as with those, only changed inputs are written and
+// input-only pins aren't re-read.
+bool MdbSim::stepBatch()
 {
-  return setPin(vddName, vdd);
+  // check state
+  if (simState == ErrState) return false;
+  if (simState != Running)
+  {
+    setError("stepBatch(not running)");
+    return false;
+  }
+  if (core) return stepNative();
+
+  buildStep(false);
+  if (!sendBuffer(cmdBuf.c_str()) || !recvResponses(pendResp))
+  {
+    setError("stepBatch(I/O failed)");
+    return false;
+  }
+  return parseStep();
 }
 
-// set error state and save a useful error msg in lastErrMsg
-void MdbSim::setError(const char* msg)
+// step with run-ahead.  if buffered pin states remain from an earlier
+// run-ahead and no input changed, the next is replayed without an MDB round
+// trip.  otherwise, if any input changed (or run-ahead is disabled), step once
+// as stepBatch(); else queue K x (stepi + print pins) in one round trip and
+// buffer the K pin states.
+//
+// MDB can't be stopped within a batch, so K adapts instead:  halved when the
+// pins change within a run-ahead and doubled (up to runAheadMax) when they
+// don't.  see replayAhead() for an input change during a replay.
+bool MdbSim::stepRunAhead()
 {
-  // if already in an error state, don't change anyting...
-  if (simState == ErrState) return;
-  simState = ErrState;
+  // replay a buffered step
+  if (replayAhead()) return true;
 
-  LPVOID lpMsgBuf;
-  DWORD  dw = GetLastError();
-
-  // if no system error, this is an unexpected MDB response...
-  if (!dw)
+  // check state
+  if (simState == ErrState) return false;
+  if (simState != Running)
   {
-    lastErrMsg = msg;
-    return;
+    setError("stepRunAhead(not running)");
+    return false;
   }
+  if (core) return stepNative();
 
-  // was a system error, format and save to lastErrMsg
-  FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
-                    FORMAT_MESSAGE_IGNORE_INSERTS,
-      NULL, dw, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPTSTR) &lpMsgBuf,
-      0, NULL);
+  buildStep(true);
+  if (!sendBuffer(cmdBuf.c_str()) || !recvResponses(pendResp))
+  {
+    setError("stepRunAhead(I/O failed)");
+    return false;
+  }
+  return parseStep();
+}
 
-  // remove trailing whitespace
-  char* buf = (char*) lpMsgBuf;
-  for (int i = strlen(buf) - 1; i >= 0 && ::isspace(buf[i]); i--) buf[i] = 0;
-  lastErrMsg = buf;
+// replay the next buffered run-ahead step, if any, while the inputs are
+// quiescent.  an input change discards the rest of the buffer so the change
+// is written on this step rather than after the buffer runs out.  MDB has
+// already executed the discarded steps, so the firmware then runs that many
+// instructions ahead of the clock.
+bool MdbSim::replayAhead()
+{
+  if (aheadPos >= aheadLen) return false;
+  for (const PinPortMap& ppMap : ppmList)
+    if (inputChanged(ppMap))
+    {
+      aheadPos = aheadLen;
+      return false;
+    }
 
-  LocalFree(lpMsgBuf);
+  applyStates(&aheadStates[aheadPos++ * ppmList.size()]);
+  ckptCurrent = false;
+  return true;
 }
 
-// create pipes for STDIN, STDOUT, and STDEERR
-bool MdbSim::createPipes()
+// asynchronous step (with run-ahead):  send the commands and return without
+// waiting for MDB.  the reader thread receives the responses while QSpice
+// evaluates other instances; stepFinish() waits for them.  a replayed
+// run-ahead step completes immediately, i.e., nothing is pending.
+bool MdbSim::stepStart()
 {
-  SECURITY_ATTRIBUTES saAttr;
+  // finish any pending step first
+  if (!stepFinish()) return false;
 
-  // Set the bInheritHandle flag so pipe handles are inherited.
-  saAttr.nLength              = sizeof(SECURITY_ATTRIBUTES);
-  saAttr.bInheritHandle       = TRUE;
-  saAttr.lpSecurityDescriptor = NULL;
+  // replay a buffered step
+  if (replayAhead()) return true;
 
-  // Create a pipe for the child process's STDOUT.
-  if (!CreatePipe(&mdbStdOut_Rd, &mdbStdOut_Wr, &saAttr, 0))
+  // check state
+  if (simState == ErrState) return false;
+  if (simState != Running)
   {
-    setError("StdoutRd CreatePipe");
+    setError("stepStart(not running)");
     return false;
   }
+  if (core) return stepNative();
 
-  // Ensure the read handle to the pipe for STDOUT is not inherited.
-  if (!SetHandleInformation(mdbStdOut_Rd, HANDLE_FLAG_INHERIT, 0))
+  buildStep(true);
+  if (!sendBuffer(cmdBuf.c_str()))
   {
-    setError("Stdout SetHandleInformation");
+    setError("stepStart(I/O failed)");
     return false;
   }
 
-  //  Create a pipe for the child process's STDERR.
-  if (!CreatePipe(&mdbStdErr_Rd, &mdbStdErr_Wr, &saAttr, 0))
+  // hand the receive to the reader thread
+  if (!rdThread.joinable()) rdThread = std::thread(&MdbSim::readerLoop, this);
   {
-    setError("StderrRd CreatePipe");
-    return false;
+    std::lock_guard<std::mutex> lock(rdMutex);
+    rdDone = false;
+    rdResp = pendResp;
   }
+  rdCond.notify_all();
+  return true;
+}
 
-  // Ensure the read handle to the pipe for STDERR is not inherited.
-  if (!SetHandleInformation(mdbStdErr_Rd, HANDLE_FLAG_INHERIT, 0))
+// wait for the responses to stepStart() and update the pin states -- the
+// barrier before the pin states are used.  returns immediately if nothing is
+// pending.
+bool MdbSim::stepFinish()
+{
+  if (!pendResp) return true;
+
+  bool        recvOk;
+  std::string errText;
   {
-    setError("Stderr SetHandleInformation");
-    return false;
+    std::unique_lock<std::mutex> lock(rdMutex);
+    rdCond.wait(lock, [this] { return rdDone; });
+    recvOk  = rdOk;
+    errText = rdErr;
   }
 
-  // Create a pipe for the child process's STDIN.
-  if (!CreatePipe(&mdbStdIn_Rd, &mdbStdIn_Wr, &saAttr, 0))
+  if (!recvOk)
   {
-    setError("Stdin CreatePipe");
+    pendResp = 0;
+    if (errText.empty()) setError("stepFinish(I/O failed)");
+    else setErrorText(errText);
     return false;
   }
+  return parseStep();
+}
 
-  // Ensure the write handle to the pipe for STDIN is not inherited.
-  if (!SetHandleInformation(mdbStdIn_Wr, HANDLE_FLAG_INHERIT, 0))
+// reader thread:  receive the responses posted by stepStart().  the thread
+// doesn't touch the error state (the QSpice thread reads it meanwhile); a
+// receive error is saved in rdErr for stepFinish()/stopReader() to set.
+void MdbSim::readerLoop()
+{
+  std::unique_lock<std::mutex> lock(rdMutex);
+  for (;;)
   {
-    setError("Stdin SetHandleInformation");
-    return false;
+    rdCond.wait(lock, [this] { return rdResp || rdQuit; });
+    if (rdQuit) return;
+
+    size_t      nbrResp = rdResp;
+    std::string errText;
+    lock.unlock();
+    bool recvOk = recvResponses(nbrResp, &errText);
+    lock.lock();
+
+    rdOk   = recvOk;
+    rdErr  = errText;
+    rdResp = 0;
+    rdDone = true;
+    rdCond.notify_all();
   }
+}
+
+// finish any pending step and stop the reader thread.  returns false (error
+// state set) if the pending step's receive failed.
+bool MdbSim::stopReader()
+{
+  if (!rdThread.joinable()) return true;
+
+  bool        recvOk = true;
+  std::string errText;
+  if (pendResp)
+  {
+    std::unique_lock<std::mutex> lock(rdMutex);
+    rdCond.wait(lock, [this] { return rdDone; });
+    recvOk   = rdOk;
+    errText  = rdErr;
+    pendResp = 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(rdMutex);
+    rdQuit = true;
+  }
+  rdCond.notify_all();
+  rdThread.join();
+
+  if (!recvOk)
+  {
+    if (errText.empty()) setError("stopReader(I/O failed)");
+    else setErrorText(errText);
+  }
+  return recvOk;
+}
+
+// build the commands for the next step(s) in cmdBuf:  the changed input pin
+// writes (direction from the last pin states), then stepi and the pin reads.
+// if runAhead and no input changed, the stepi and reads are repeated K times
+// (fewer if K steps would exceed CmdChunk bytes).  the command counts are saved
+// for parseStep().
+void MdbSim::buildStep(bool runAhead)
+{
+  cmdBuf.clear();
+  pendWrites = 0;
+  for (PinPortMap& ppMap : ppmList)
+    if (inputChanged(ppMap))
+    {
+      addSetPinCmd(ppMap.pinName, inputVoltage(ppMap));
+      inputSent(ppMap);
+      journalWrite(ppMap.pinName, ppMap.lastSent);
+      pendWrites++;
+    }
+
+  // any input changes (or no run-ahead)?  restart run-ahead at 2 steps
+  pendSteps = 1;
+  if (!runAhead || runAheadMax <= 1 || pendWrites)
+    runAheadK = 2;
+  else
+    pendSteps = runAheadK < runAheadMax ? runAheadK : runAheadMax;
+
+  for (size_t j = 0; j < pendSteps; j++)
+  {
+    size_t start = cmdBuf.size();
+    cmdBuf += "stepi\r\n";
+    pendReads = addReadCmds();
+    if (j + 1 < pendSteps && 2 * cmdBuf.size() - start > CmdChunk)
+      pendSteps = j + 1;   // the next step would exceed CmdChunk
+  }
+  pendResp = pendWrites + pendSteps * (1 + pendReads);
+  journalSteps(pendSteps);
+}
+
+// check and parse the responses to the buildStep() commands, update the pin
+// states, and buffer any run-ahead pin states
+bool MdbSim::parseStep()
+{
+  pendResp = 0;
+
+  // we expect nothing but prompt for the write pin commands
+  for (size_t i = 0; i < pendWrites; i++)
+    if (respSize(i))
+    {
+      setError("stepBatch(write pin error)");
+      return false;
+    }
+
+  // stepi responses are ignored (see stepInst()); the print pin responses
+  // follow each
+  size_t nbrPins = ppmList.size();
+  aheadStates.resize(pendSteps * nbrPins);
+  for (size_t j = 0; j < pendSteps; j++)
+    if (!parseReads(pendWrites + j * (1 + pendReads) + 1,
+            &aheadStates[j * nbrPins]))
+      return false;
+
+  // adapt K to pin activity
+  if (pendSteps > 1)
+  {
+    bool changed = false;
+    for (size_t n = 0; n < nbrPins && !changed; n++)
+      changed = aheadStates[n] != ppmList[n].pinState;
+    for (size_t n = nbrPins; n < pendSteps * nbrPins && !changed; n++)
+      changed = aheadStates[n] != aheadStates[n - nbrPins];
+    if (changed)
+      runAheadK = runAheadK > 2 ? runAheadK / 2 : 2;
+    else if (runAheadK < runAheadMax)
+      runAheadK *= 2;
+  }
+
+  // first step now, any others on later clocks
+  applyStates(&aheadStates[0]);
+  aheadPos = 1;
+  aheadLen = pendSteps;
 
+  stepCount += pendSteps;
   return true;
 }
 
-// launch MDB process
-bool MdbSim::createMdbProcess()
-{
-  PROCESS_INFORMATION piProcInfo;
-  STARTUPINFO         siStartInfo;
-  BOOL                bSuccess = FALSE;
-
-  // Set up members of the PROCESS_INFORMATION structure.
-  ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-
-  // Set up members of the STARTUPINFO structure.
-  // This structure specifies the STDIN, STDOUT, & STDERR handles for
-  // redirection.
-  ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
-  siStartInfo.cb = sizeof(STARTUPINFO);
-
-  // siStartInfo.hStdError  = mdbStdErr_Wr; // set MDB STDERR to STDERR input
-  siStartInfo.hStdError  = mdbStdOut_Wr; // set MDB STDERR to STDOUT input
-  siStartInfo.hStdOutput = mdbStdOut_Wr; // set MDB STDOUT to STDOUT input
-  siStartInfo.hStdInput  = mdbStdIn_Rd;  // set MDB STDIN to STDIN output
-  siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
-
-  // Create the MDB child process.
-  bSuccess = CreateProcess(gMdbSimPath, // command line
-      NULL,                             // arguments
-      NULL,                             // process security attributes
-      NULL,                             // primary thread security attributes
-      TRUE,                             // handles are inherited
-      0,                                // creation flags
-      NULL,                             // use parent's environment
-      NULL,                             // use parent's current directory
-      &siStartInfo,                     // STARTUPINFO pointer
-      &piProcInfo);                     // receives PROCESS_INFORMATION
-
-  // if an error occurs, set error and return failure
-  if (!bSuccess)
-  {
-    setError("CreateMdbProcess");
+// append "print pin" commands for the pins that need reading; returns the #
+// of commands
+size_t MdbSim::addReadCmds()
+{
+  size_t nbrReads = 0;
+  for (PinPortMap& ppMap : ppmList)
+  {
+    if (ppMap.stateValid && ppMap.isInputOnly()) continue;
+    cmdBuf += "print pin ";
+    cmdBuf += ppMap.pinName;
+    cmdBuf += "\r\n";
+    nbrReads++;
+  }
+  return nbrReads;
+}
+
+// parse the print pin responses (header & pin line) starting at response
+// firstResp into states[], one per mapped pin; pins not read keep their
+// current state
+bool MdbSim::parseReads(size_t firstResp, PinState* states)
+{
+  size_t i = firstResp;
+  for (size_t n = 0; n < ppmList.size(); n++)
+  {
+    PinPortMap& ppMap = ppmList[n];
+    states[n]         = ppMap.pinState;
+    if (ppMap.stateValid && ppMap.isInputOnly()) continue;
+    if (respSize(i) != 2)
+    {
+      setError("stepBatch(unexpected print pin response)");
+      return false;
+    }
+    if (!parsePinState(respLine(i++, 1), states[n])) return false;
+  }
+  return true;
+}
+
+// update the pin states, one per mapped pin
+void MdbSim::applyStates(const PinState* states)
+{
+  for (size_t n = 0; n < ppmList.size(); n++) ppmList[n].setPinState(states[n]);
+}
+
+// native core step:  set the changed input pins, step one instruction, and
+// get the pin states -- no MDB, so no batching, run-ahead, or reader thread.
+// reading the clock costs more than a step, so every NativeTimeSample'th step
+// is timed and counted for all of them.
+bool MdbSim::stepNative()
+{
+  const unsigned NativeTimeSample = 64;
+
+  bool              timed = stepCount % NativeTimeSample == 0;
+  Clock::time_point t0    = timed ? Clock::now() : Clock::time_point();
+
+  for (PinPortMap& ppMap : ppmList)
+    if (inputChanged(ppMap))
+    {
+      core->setPin(ppMap.corePin, inputVoltage(ppMap));
+      inputSent(ppMap);
+    }
+
+  core->step();
+  stepCount++;
+  ckptCurrent = false;
+
+  PinState pinState;
+  for (PinPortMap& ppMap : ppmList)
+  {
+    if (ppMap.stateValid && ppMap.isInputOnly()) continue;
+    core->getPin(ppMap.corePin, pinState);
+    ppMap.setPinState(pinState);
+  }
+
+  if (timed) ioTime += (Clock::now() - t0) * NativeTimeSample;
+  return true;
+}
+
+// save the simulation state:  the pin states & sent inputs, any buffered
+// run-ahead states, and the native core state or the MDB journal length.  a
+// pending step is finished first -- it belongs to the saved state.
+bool MdbSim::checkpoint()
+{
+  // check state
+  if (simState == ErrState) return false;
+  if (simState != Running || (!core && !mdbRollback))
+  {
+    setError("checkpoint(not running or MDB rollback not enabled)");
     return false;
   }
+  if (!stepFinish()) return false;
+  if (ckptCurrent) return true;
+
+  ckpt.pins.resize(ppmList.size());
+  for (size_t n = 0; n < ppmList.size(); n++)
+  {
+    const PinPortMap& ppMap = ppmList[n];
+    ckpt.pins[n] = {
+        ppMap.pinState, ppMap.stateValid, ppMap.lastSent, ppMap.sentValid};
+  }
+  ckpt.aheadStates = aheadStates;
+  ckpt.aheadPos    = aheadPos;
+  ckpt.aheadLen    = aheadLen;
+  ckpt.runAheadK   = runAheadK;
+  ckpt.vddV        = vddV;
+
+  if (core)
+    core->saveState(ckpt.coreState);
+  else
+  {
+    ckpt.jrnlLen   = journal.size();
+    ckpt.jrnlSteps = journal.empty() ? 0 : journal.back().steps;
+  }
 
-  // Close handles to the child process and its primary thread.
-  // Some applications might keep these handles to monitor the status
-  // of the child process, for example.
-  CloseHandle(piProcInfo.hProcess);
-  CloseHandle(piProcInfo.hThread);
+  ckptValid   = true;
+  ckptCurrent = true;
+  return true;
+}
 
-  // Close handles to the stdin and stdout pipes no longer needed by the child
-  // process. If they are not explicitly closed, there is no way to recognize
-  // that the child process has ended.
-  CloseHandle(mdbStdErr_Wr);
-  CloseHandle(mdbStdOut_Wr);
-  CloseHandle(mdbStdIn_Rd);
+// return to the last checkpoint().  a pending step is finished first; its
+// results are discarded.
+bool MdbSim::rollback()
+{
+  // check state
+  if (simState == ErrState) return false;
+  if (simState != Running || !ckptValid)
+  {
+    setError("rollback(not running or no checkpoint)");
+    return false;
+  }
+  if (!stepFinish()) return false;
+  if (ckptCurrent) return true;
 
+  for (size_t n = 0; n < ppmList.size(); n++)
+  {
+    PinPortMap&    ppMap = ppmList[n];
+    const PinCkpt& pin   = ckpt.pins[n];
+    ppMap.pinState       = pin.pinState;
+    ppMap.stateValid     = pin.stateValid;
+    ppMap.lastSent       = pin.lastSent;
+    ppMap.sentValid      = pin.sentValid;
+  }
+  aheadStates = ckpt.aheadStates;
+  aheadPos    = ckpt.aheadPos;
+  aheadLen    = ckpt.aheadLen;
+  runAheadK   = ckpt.runAheadK;
+  vddV        = ckpt.vddV;
+
+  if (core)
+    core->restoreState(ckpt.coreState);
+  else
+  {
+    journal.resize(ckpt.jrnlLen);
+    if (!journal.empty()) journal.back().steps = ckpt.jrnlSteps;
+    if (!replayJournal()) return false;
+  }
+
+  ckptCurrent = true;
   return true;
 }
 
+// record an MDB input pin write for rollback()
+void MdbSim::journalWrite(const char* pinName, double volts)
+{
+  ckptCurrent = false;
+  if (!mdbRollback) return;
+
+  int pin = 0;
+  while (pin < int(jrnlNames.size()) && jrnlNames[pin] != pinName) pin++;
+  if (pin == int(jrnlNames.size())) jrnlNames.push_back(pinName);
+
+  journal.push_back({pin, volts, 0});
+}
+
+// record MDB stepi commands for rollback()
+void MdbSim::journalSteps(size_t steps)
+{
+  ckptCurrent = false;
+  if (!mdbRollback) return;
+
+  if (journal.empty()) journal.push_back({-1, 0, 0});
+  journal.back().steps += steps;
+}
+
+// reset the MDB device and replay the journal.  MDB can't be stopped within a
+// batch, so the commands are sent in CmdChunk byte chunks.  inputs that were
+// first written after the checkpoint keep their written voltages through the
+// reset but are rewritten on the next step (their sentValid was restored).
+bool MdbSim::replayJournal()
+{
+  std::vector<size_t> writes; // responses to check in the current chunk
+  size_t              nbrCmds = 1;
+  cmdBuf                      = "reset\r\n";
+
+  auto flush = [&]() {
+    if (!sendBuffer(cmdBuf.c_str()) || !recvResponses(nbrCmds))
+    {
+      setError("rollback(I/O failed)");
+      return false;
+    }
+    for (size_t i : writes)
+      if (respSize(i))
+      {
+        setError("rollback(write pin error)");
+        return false;
+      }
+    cmdBuf.clear();
+    writes.clear();
+    nbrCmds = 0;
+    return true;
+  };
+
+  for (const JournalOp& op : journal)
+  {
+    if (op.pin >= 0)
+    {
+      writes.push_back(nbrCmds++);
+      addSetPinCmd(jrnlNames[op.pin].c_str(), op.volts);
+    }
+    for (unsigned long long j = 0; j < op.steps; j++)
+    {
+      if (cmdBuf.size() >= CmdChunk && !flush()) return false;
+      cmdBuf += "stepi\r\n";
+      nbrCmds++;
+    }
+    if (cmdBuf.size() >= CmdChunk && !flush()) return false;
+  }
+  return !nbrCmds || flush();
+}
+
+// seconds spent waiting on MDB I/O (stepping, for a native core)
+double MdbSim::getIoSeconds()
+{
+  return std::chrono::duration<double>(ioTime).count();
+}
+
+// set nominal VDD (max MDB input pin value and returned digital "HIGH" value)
+bool MdbSim::setVDD(const char* vddName, double vdd)
+{
+  vddV = vdd;
+  return setPin(vddName, vdd);
+}
+
+// set error state and save a useful error msg in lastErrMsg
+void MdbSim::setError(const char* msg)
+{
+  // if already in an error state, don't change anyting...
+  if (simState == ErrState) return;
+  setErrorText(errorText(msg));
+}
+
+// the error msg for setError():  the system error, if any (it is per-thread,
+// so get it on the failing thread), else msg -- an unexpected MDB response...
+std::string MdbSim::errorText(const char* msg)
+{
+  std::string sysMsg = MdbTransport::systemError();
+  return sysMsg.empty() ? msg : sysMsg;
+}
+
+// set error state with the error msg from errorText()
+void MdbSim::setErrorText(const std::string& text)
+{
+  if (simState == ErrState) return;
+  simState   = ErrState;
+  lastErrMsg = text;
+}
+
 // send command to MDB.  caller should ensure that cmd has CRLF and is
 // zero-terminated.
 bool MdbSim::sendBuffer(const char* cmd)
 {
-  // clear receive list
-  sList.clear();
+  // clear receive lists
+  lineList.clear();
+  respList.assign(1, 0);
 
   if (simState != Running)
   {
@@ -453,13 +1150,15 @@ bool MdbSim::sendBuffer(const char* cmd)
     return false;
   }
 
-  DWORD dwWritten;
-  if (!WriteFile(mdbStdIn_Wr, cmd, strlen(cmd), &dwWritten, NULL))
+  Clock::time_point t0 = Clock::now();
+
+  if (!transport->write(cmd, strlen(cmd)))
   {
-    setError("sendBuffer(WriteFile)");
+    setError(transport->getErrContext());
     return false;
   }
 
+  ioTime += Clock::now() - t0;
   return true;
 }
 
@@ -467,59 +1166,94 @@ bool MdbSim::sendBuffer(const char* cmd)
 // trailing prompt; failed read sets error state, missing prompt does not set
 // error state.
 //
-// also, this is fragile code and could easily break into infinite loop?
+// returns false on failure.  On success, the response lines are available
+// from respLine(0, n) with empty lines and trailing whitespace removed. final
+// prompt also removed.
+bool MdbSim::recvBuffer() { return recvResponses(1); }
+
+// receive the responses to nbrResp commands, i.e., read through nbrResp
+// prompts.  MDB's ">" prompt isn't followed by a newline so, when commands are
+// queued, the next response follows the prompt on the same line.  a ">" at the
+// start of a line is taken as a prompt.
 //
-// returns false on failure.  On success, StringList is updated with empty lines
-// removed and trailing whitespace removed. final prompt also removed.
-bool MdbSim::recvBuffer()
+// lines are scanned in place as bytes arrive; a line split across reads is
+// simply completed by the next read.  on success, lineList holds the response
+// lines (empty lines, leading/trailing whitespace, and prompts removed) and
+// respList[i] is the lineList index of the first line of response i
+// (respList[nbrResp] == lineList.size()).  bytes received after the last
+// prompt are kept for the next call.
+//
+// if errText is given (reader thread), an I/O error is saved there rather
+// than set.
+bool MdbSim::recvResponses(size_t nbrResp, std::string* errText)
 {
-  sList.clear();
+  lineList.clear();
+  respList.assign(1, 0);
 
   if (simState != Running)
   {
-    if (simState != ErrState) setError("recvBuffer(not running)");
+    if (errText) *errText = "recvBuffer(not running)";
+    else if (simState != ErrState) setError("recvBuffer(not running)");
     return false;
   }
 
-  DWORD dwRead;
-  BOOL  bSuccess  = FALSE;
-  bool  gotPrompt = false;
+  Clock::time_point t0 = Clock::now();
 
-  while (!gotPrompt)
+  // move any unscanned bytes to the start of the buffer
+  if (rxHead)
   {
-    bSuccess =
-        ReadFile(mdbStdOut_Rd, recvBuf, sizeof(recvBuf) - 1, &dwRead, NULL);
-    if (!bSuccess)
-    {
-      setError("recvBuffer (ReadFile)");
-      return false;
-    }
-
-    // if empty line, ignore
-    if (!dwRead) break;
+    memmove(rxBuf.data(), rxBuf.data() + rxHead, rxTail - rxHead);
+    rxTail -= rxHead;
+    rxHead = 0;
+  }
 
-    // ensure termination
-    recvBuf[dwRead] = '\0';
+  const size_t noLine    = size_t(-1);
+  size_t       lineStart = noLine; // first non-blank of the current line
+  size_t       nbrRead;
 
-    // break embedded CRLF into lines, remove trailing CRLF
-    char* tok = strtok(recvBuf, "\r\n");
-    while (tok && !gotPrompt)
+  for (;;)
+  {
+    // scan the received bytes through the last prompt
+    for (; rxHead < rxTail && respList.size() <= nbrResp; rxHead++)
     {
-      // if not empty line, add to list
-      if (strlen(tok) > 0)
+      char c = rxBuf[rxHead];
+      if (c == '\r' || c == '\n')
       {
-        sList.push_back(tok);
-        gotPrompt = tok[0] == '>' && tok[1] == '\0';
-        tok       = strtok(NULL, "\r\n");
-        continue;
+        // end of line -- trim trailing whitespace
+        if (lineStart == noLine) continue;
+        size_t end = rxHead;
+        while (::isspace((unsigned char) rxBuf[end - 1])) end--;
+        lineList.push_back({lineStart, end - lineStart});
+        lineStart = noLine;
       }
+      else if (lineStart == noLine && c == '>')
+        respList.push_back(lineList.size()); // prompt -- end of response
+      else if (lineStart == noLine && !::isspace((unsigned char) c))
+        lineStart = rxHead;
+    }
+    if (respList.size() > nbrResp) break;
+
+    // need more -- grow the buffer if full (large batches only)
+    if (rxTail == rxBuf.size()) rxBuf.resize(rxBuf.size() * 2);
+
+    if (!transport->read(
+            rxBuf.data() + rxTail, rxBuf.size() - rxTail, nbrRead))
+    {
+      if (errText) *errText = errorText(transport->getErrContext());
+      else setError(transport->getErrContext());
+      return false;
     }
+
+    // if nothing read (pipe closed), give up
+    if (!nbrRead) break;
+    rxTail += nbrRead;
   }
 
-  // fail if no prompt else remove prompt line
-  if (!gotPrompt) return false;
-  sList.pop_back();
-  return true;
+  ioTime += Clock::now() - t0;
+  cmdCount += respList.size() - 1;
+
+  // fail if missing prompt(s)
+  return respList.size() > nbrResp;
 }
 
 // use this to ensure that receive buffer is called after send buffer
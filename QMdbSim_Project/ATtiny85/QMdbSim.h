@@ -12,12 +12,17 @@
  */
 #pragma once
 
-#include <Windows.h>
+#include "McuCore.h"
+#include "MdbTransport.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
-typedef std::vector<std::string> StringList;
-
 extern const char* gMdbSimPath;
 
 // pin state constants for convenience
@@ -39,6 +44,13 @@ struct PinState
   inline bool isAnalog() const { return !isDigital(); }
   inline bool isInput() const { return ioState == PIN_INPUT; }
   inline bool isOutput() const { return !isInput(); }
+
+  inline bool operator==(const PinState& ps) const
+  {
+    return daState == ps.daState && ioState == ps.ioState &&
+           voltage == ps.voltage;
+  }
+  inline bool operator!=(const PinState& ps) const { return !(*this == ps); }
 };
 
 // class to map port names to tri-state (or input-only) ports
@@ -56,6 +68,24 @@ public:
   bool*             dirPort;
 
   PinState pinState;
+  bool     stateValid = false; // pinState has been read from MDB
+  double   lastSent   = 0;     // last input voltage written to MDB
+  bool     sentValid  = false; // lastSent is current (pin config unchanged)
+  int      corePin    = -1;    // pin index of the native core (if any)
+
+  // input-only pins can't change direction, so are read from MDB only once
+  inline bool isInputOnly() const { return !outPort && !dirPort; }
+
+  // update pin state; a change of pin configuration forces the next input
+  // voltage to be written
+  inline void setPinState(const PinState& newState)
+  {
+    if (newState.daState != pinState.daState ||
+        newState.ioState != pinState.ioState)
+      sentValid = false;
+    pinState   = newState;
+    stateValid = true;
+  }
 };
 
 typedef std::vector<PinPortMap> PinPortMapList;
@@ -81,6 +111,11 @@ public:
   inline const char* getLastErrMsg() { return lastErrMsg.c_str(); }
   const char*        getVerInfo();
 
+  // use the in-process core for the device, if there is one, instead of MDB
+  // (see McuCore.h); call before startSim()
+  inline void setNativeCore(bool native) { nativeCore = native; }
+  inline bool isNative() { return core != nullptr; }
+
   // simulator commands
   bool startSim(const char* deviceName, const char* pgmPath);
   bool stopSim();
@@ -97,33 +132,187 @@ public:
   void setOutPorts();
   bool setVDD(const char* vddName, double vdd);
 
+  // batched update -- sets input pins, steps, and gets pin states in one MDB
+  // round trip
+  bool stepBatch();
+
+  // minimum analog input change written to MDB, e.g., 1 ADC LSB (default 0,
+  // i.e., any change); digital inputs are written (as 0 or VDD) on logic
+  // level changes
+  inline void setAnalogThreshold(double volts) { analogThreshold = volts; }
+
+  // run-ahead -- while inputs are unchanged, step up to maxSteps instructions
+  // per MDB round trip and replay the buffered pin states on later clocks
+  // (maxSteps <= 1 disables run-ahead)
+  inline void setRunAheadMax(int maxSteps) { runAheadMax = maxSteps; }
+  bool        stepRunAhead();
+  inline int  getAheadSteps() { return int(aheadLen - aheadPos); }
+
+  // asynchronous stepping (with run-ahead) -- stepStart() sends the commands
+  // and returns; a reader thread receives the responses; stepFinish() waits
+  // for them and updates the pin states.  lets MDB processes for several
+  // instances run concurrently.
+  bool        stepStart();
+  bool        stepFinish();
+  inline bool stepPending() { return pendResp != 0; }
+
+  // rollback -- checkpoint() saves the simulation state and rollback()
+  // returns to it, e.g., to undo a QSpice trial step (ForKeeps false).  both
+  // finish a pending step first and do nothing if the state hasn't changed
+  // since the last checkpoint or rollback.  a native core copies its state;
+  // MDB resets the device and replays the input writes and steps since
+  // startSim(), so an MDB rollback takes time in proportion to the
+  // instructions simulated.  MDB rollback must be enabled before startSim()
+  // (the journal is recorded only then).
+  inline void setMdbRollback(bool enable) { mdbRollback = enable; }
+  bool        checkpoint();
+  bool        rollback();
+
+  // throughput statistics
+  inline unsigned long long getStepCount() { return stepCount; }
+  inline unsigned long long getCmdCount() { return cmdCount; }
+  double                    getIoSeconds();
+
 protected:
   SimState simState = NotStarted;
 
-  double vddV = 5.0;
+  double vddV            = 5.0;
+  double analogThreshold = 0;
+
+  int                   runAheadMax = 1; // max instructions per round trip
+  int                   runAheadK   = 2; // current (adaptive) run-ahead steps
+  std::vector<PinState> aheadStates;     // buffered pin states (step major)
+  size_t                aheadPos = 0;    // next buffered step to replay
+  size_t                aheadLen = 0;    // # of buffered steps
+
+  // commands in cmdBuf from buildStep(); pendResp != 0 until parsed
+  size_t pendWrites = 0; // write pin commands
+  size_t pendSteps  = 0; // stepi commands
+  size_t pendReads  = 0; // print pin commands per stepi
+  size_t pendResp   = 0; // total responses
+
+  // reader thread for stepStart()/stepFinish()
+  std::thread             rdThread;
+  std::mutex              rdMutex;
+  std::condition_variable rdCond;
+  size_t                  rdResp = 0;     // responses to receive (0 = idle)
+  bool                    rdDone = false; // receive done
+  bool                    rdOk   = false; // receive succeeded
+  std::string             rdErr;          // receive error msg (if any)
+  bool                    rdQuit = false; // exit thread
 
   std::string lastErrMsg = "No errors";
   std::string sDevName;
   std::string sPgmPath;
+  std::string poolKey; // MDB process pool key (device & program hash)
+
+  std::unique_ptr<MdbTransport> transport; // MDB process & pipes
+
+  bool                     nativeCore = false;
+  std::unique_ptr<McuCore> core; // in-process core (instead of MDB)
+
+  // MDB output is received into a per-instance buffer.  the response lines
+  // are kept as offset/length pairs into the buffer -- rxBuf can grow while a
+  // batch is received -- and are returned as string_views.  the buffer, line,
+  // and response lists keep their capacity, so receiving is allocation-free
+  // once they reach the size of the largest batch.
+  struct LineRef
+  {
+    size_t off;
+    size_t len;
+  };
 
-  HANDLE mdbStdIn_Rd  = nullptr;
-  HANDLE mdbStdIn_Wr  = nullptr;
-  HANDLE mdbStdOut_Rd = nullptr;
-  HANDLE mdbStdOut_Wr = nullptr;
-  HANDLE mdbStdErr_Rd = nullptr;
-  HANDLE mdbStdErr_Wr = nullptr;
+  std::vector<char>    rxBuf;      // receive buffer
+  size_t               rxHead = 0; // next byte to scan
+  size_t               rxTail = 0; // end of received bytes
+  std::vector<LineRef> lineList;   // response lines (all responses)
+  std::vector<size_t>  respList;   // lineList index of each response's first
+                                   // line
+  PinPortMapList       ppmList;
+  std::string          cmdBuf;     // batched commands
 
-  StringList     sList;
-  PinPortMapList ppmList;
+  // MDB journal -- the state changes since startSim() for rollback():  input
+  // pin writes, each followed by a count of stepi commands (steps coalesce)
+  struct JournalOp
+  {
+    int                pin;   // jrnlNames index (-1 for steps only)
+    double             volts; // voltage written
+    unsigned long long steps; // stepi commands after the write
+  };
 
-  // note:  the receive buffer is fixed size and shared across instances!
-  static char recvBuf[];
+  bool                     mdbRollback = false; // record the journal
+  std::vector<JournalOp>   journal;
+  std::vector<std::string> jrnlNames; // pin names written
 
-  void setError(const char* msg);
-  bool createPipes();
-  bool createMdbProcess();
+  // checkpoint() state
+  struct PinCkpt
+  {
+    PinState pinState;
+    bool     stateValid;
+    double   lastSent;
+    bool     sentValid;
+  };
+
+  struct Checkpoint
+  {
+    std::vector<PinCkpt>  pins;
+    std::vector<PinState> aheadStates;
+    size_t                aheadPos  = 0;
+    size_t                aheadLen  = 0;
+    int                   runAheadK = 2;
+    double                vddV      = 5.0;
+    std::vector<uint8_t>  coreState; // native core
+    size_t                jrnlLen   = 0; // MDB journal entries
+    unsigned long long    jrnlSteps = 0; // steps of the last entry
+  };
+
+  Checkpoint ckpt;
+  bool       ckptValid   = false; // a checkpoint has been taken
+  bool       ckptCurrent = false; // no state change since checkpoint/rollback
+
+  unsigned long long stepCount = 0; // instructions stepped
+  unsigned long long cmdCount  = 0; // MDB commands (responses received)
+  std::chrono::steady_clock::duration ioTime {}; // time spent in MDB I/O
+
+  void        setError(const char* msg);
+  std::string errorText(const char* msg);
+  void        setErrorText(const std::string& text);
+
+  double clipVoltage(double v);
+  double inputVoltage(const PinPortMap& ppMap);
+  bool   inputChanged(const PinPortMap& ppMap);
+  void   inputSent(PinPortMap& ppMap);
+  void   addSetPinCmd(const char* pinName, double toVoltage);
+  size_t addReadCmds();
+  bool   parseReads(size_t firstResp, PinState* states);
+  void   applyStates(const PinState* states);
+  bool   replayAhead();
+  void   buildStep(bool runAhead);
+  bool   parseStep();
+  bool   stepNative();
+  void   journalWrite(const char* pinName, double volts);
+  void   journalSteps(size_t steps);
+  bool   replayJournal();
+  void   readerLoop();
+  bool   stopReader();
+  bool   parsePinState(std::string_view line, PinState& pinState);
 
   bool sendBuffer(const char* cmd);
   bool recvBuffer();
+  bool recvResponses(size_t nbrResp, std::string* errText = nullptr);
   bool sendRecvBuffer(const char* cmd);
+
+  // # of lines & n-th line of the i-th response from recvResponses()
+  inline size_t respSize(size_t i) { return respList[i + 1] - respList[i]; }
+  inline std::string_view respLine(size_t i, size_t n)
+  {
+    const LineRef& line = lineList[respList[i] + n];
+    return std::string_view(rxBuf.data() + line.off, line.len);
+  }
+  inline std::string_view lastLine()
+  {
+    if (lineList.empty()) return std::string_view();
+    const LineRef& line = lineList.back();
+    return std::string_view(rxBuf.data() + line.off, line.len);
+  }
 };
\ No newline at end of file
@@ -0,0 +1,281 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * MdbBench is a console benchmark and regression check for the MdbSim stepping
+ * code.  It is not a C-Block.  It runs the same stimulus through each stepping
+ * method, reports instructions/sec, and checks the pin traces:  stepBatch must
+ * match lock-step (setInPins/stepInst/getPinStates), and stepStart/stepFinish
+ * must match stepRunAhead (an input change during a run-ahead leaves the
+ * firmware ahead of the clock, so its trace legitimately differs from
+ * lock-step).  The rollback run steps every
+ * TrialPeriod'th instruction first with RA1 inverted, rolls that back (see
+ * MdbSim::checkpoint()), and must still match lock-step.  Run it against
+ * MockMdb for repeatable numbers or against MDB with a real program.
+ *
+ * Finally, it runs the program on the native PIC16 core (see Pic16Core.cpp)
+ * and compares that trace with lock-step -- a check of the core against MDB.
+ * Against MockMdb, whose "firmware" isn't the program, the traces differ.  The
+ * native rollback run must match the native trace.
+ *
+ *   MdbBench <MDB path> [instructions [instances]]
+ *
+ * To build (from this directory):
+ *
+ *   cl /O2 /EHsc /std:c++17 /I..\PIC16F15213 MdbBench.cpp
+ *       ..\PIC16F15213\QMdbSim.cpp ..\PIC16F15213\MdbTransport.cpp
+ *       ..\PIC16F15213\McuCore.cpp ..\PIC16F15213\Pic16Core.cpp
+ *       ..\PIC16F15213\AvrCore.cpp
+ *   g++ -O2 -std=c++17 -pthread -I../PIC16F15213 -o MdbBench MdbBench.cpp
+ *       ../PIC16F15213/QMdbSim.cpp ../PIC16F15213/MdbTransport.cpp
+ *       ../PIC16F15213/McuCore.cpp ../PIC16F15213/Pic16Core.cpp
+ *       ../PIC16F15213/AvrCore.cpp
+ *
+ * MockMdb's latency option (MOCKMDB_LATENCY) approximates MDB's per-command
+ * cost, which is where run-ahead and asynchronous stepping pay off.  Its
+ * startup option (MOCKMDB_STARTUP) approximates the JVM startup; each method
+ * after the first should start from the MDB process pool.
+ */
+#include "QMdbSim.h"
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+const int    NbrPins     = 6;
+const int    RunAheadMax = 32;
+const double VDD         = 5.0;
+const int    InPeriod    = 50; // RA1 input toggle period (instructions)
+const int    TrialPeriod = 97; // rolled back trial step period (instructions)
+
+// pin names & ports of one instance (PIC16F15213 pinout; RA3 is input-only)
+const char* const PinNames[NbrPins] = {
+    "RA0", "RA1", "RA2", "RA3", "RA4", "RA5"};
+
+struct BenchInst
+{
+  MdbSim mdb;
+  double in[NbrPins]  = {};
+  double out[NbrPins] = {};
+  bool   ctl[NbrPins] = {};
+
+  std::vector<double> trace; // output voltages, NbrPins per instruction
+};
+
+// stepping methods
+enum StepMode
+{
+  LockStep,
+  Batch,
+  RunAhead,
+  Async,
+  Rollback,
+  Native,
+  NativeRollback
+};
+
+const char* const ModeNames[] = {"lock-step", "stepBatch", "stepRunAhead",
+    "stepStart/stepFinish", "stepBatch + rollback", "native core",
+    "native + rollback"};
+
+// start an instance -- returns false (with message) on failure
+bool startInst(BenchInst& inst, const char* pgmPath, int runAheadMax,
+    bool native, bool mdbRollback)
+{
+  for (int n = 0; n < NbrPins; n++)
+  {
+    if (n == 3)
+      inst.mdb.addPinPortMap(PinNames[n], &inst.in[n]);
+    else
+      inst.mdb.addPinPortMap(
+          PinNames[n], &inst.in[n], &inst.out[n], &inst.ctl[n]);
+  }
+
+  inst.mdb.setNativeCore(native);
+  inst.mdb.setMdbRollback(mdbRollback);
+  if (!inst.mdb.startSim("PIC16F15213", pgmPath) ||
+      !inst.mdb.setVDD("VDD", VDD) || !inst.mdb.getPinStates())
+  {
+    printf("MDB start failed:  %s\n", inst.mdb.getLastErrMsg());
+    return false;
+  }
+  inst.mdb.setAnalogThreshold(VDD / 1024);
+  inst.mdb.setRunAheadMax(runAheadMax);
+  inst.mdb.setCtrlPorts();
+  inst.mdb.setOutPorts();
+  return true;
+}
+
+// stimulus for instruction i
+void setInputs(BenchInst& inst, long i)
+{
+  inst.in[1] = (i / InPeriod) & 1 ? VDD : 0;
+  inst.in[3] = (i / (3 * InPeriod)) & 1 ? VDD : 0;
+}
+
+// step instruction i; every TrialPeriod'th, a trial step with RA1 inverted is
+// rolled back first
+bool stepTrial(BenchInst& inst, long i)
+{
+  if (i % TrialPeriod == 0)
+  {
+    double in1 = inst.in[1];
+    inst.in[1] = VDD - in1;
+    bool ok    = inst.mdb.checkpoint() && inst.mdb.stepBatch() &&
+              inst.mdb.rollback();
+    inst.in[1] = in1;
+    if (!ok) return false;
+  }
+  return inst.mdb.stepBatch();
+}
+
+// update the output ports and record them
+void recordOutputs(BenchInst& inst)
+{
+  inst.mdb.setCtrlPorts();
+  inst.mdb.setOutPorts();
+  inst.trace.insert(inst.trace.end(), inst.out, inst.out + NbrPins);
+}
+
+// run nbrInst instructions on nbrInsts instances with the given method;
+// returns instructions/sec (all instances) or 0 on failure
+double runMode(StepMode mode, const char* pgmPath, long nbrInst,
+    std::vector<std::unique_ptr<BenchInst>>& insts, int nbrInsts)
+{
+  auto start = std::chrono::steady_clock::now();
+  insts.clear();
+  for (int k = 0; k < nbrInsts; k++)
+  {
+    insts.emplace_back(new BenchInst);
+    if (!startInst(*insts.back(), pgmPath,
+            mode == RunAhead || mode == Async ? RunAheadMax : 1,
+            mode == Native || mode == NativeRollback, mode == Rollback))
+      return 0;
+  }
+  double startSecs = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (long i = 0; i < nbrInst; i++)
+  {
+    for (auto& inst : insts)
+    {
+      setInputs(*inst, i);
+
+      bool ok = true;
+      switch (mode)
+      {
+        case LockStep:
+          ok = inst->mdb.setInPins() && inst->mdb.stepInst() &&
+               inst->mdb.getPinStates();
+          break;
+        case Batch:
+        case Native: ok = inst->mdb.stepBatch(); break;
+        case RunAhead: ok = inst->mdb.stepRunAhead(); break;
+        case Async: ok = inst->mdb.stepStart(); break;
+        case Rollback:
+        case NativeRollback: ok = stepTrial(*inst, i); break;
+      }
+      if (!ok)
+      {
+        printf("%s failed:  %s\n", ModeNames[mode], inst->mdb.getLastErrMsg());
+        return 0;
+      }
+      if (!inst->mdb.stepPending()) recordOutputs(*inst);
+    }
+
+    // asynchronous -- all instances' MDB processes are now stepping
+    for (auto& inst : insts)
+    {
+      if (!inst->mdb.stepPending()) continue;
+      if (!inst->mdb.stepFinish())
+      {
+        printf("%s failed:  %s\n", ModeNames[mode], inst->mdb.getLastErrMsg());
+        return 0;
+      }
+      recordOutputs(*inst);
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  double secs = std::chrono::duration<double>(stop - start).count();
+  double rate = nbrInst * nbrInsts / secs;
+  printf("%-22s %6.3f s start %8.3f s %10.0f instructions/sec (%llu MDB "
+         "commands)\n",
+      ModeNames[mode], startSecs, secs, rate, insts[0]->mdb.getCmdCount());
+
+  for (auto& inst : insts) inst->mdb.stopSim();
+  return rate;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("usage:  MdbBench <MDB path> [instructions [instances]]\n");
+    return 1;
+  }
+  gMdbSimPath = argv[1];
+
+  long        nbrInst  = argc > 2 ? atol(argv[2]) : 10000;
+  int         nbrInsts = argc > 3 ? atoi(argv[3]) : 1;
+  const char* pgm      = "../PIC16F15213/PIC16F15213_CPlex.X.debug.elf";
+  if (nbrInst < 1) nbrInst = 1;
+  if (nbrInsts < 1) nbrInsts = 1;
+
+  printf("%s:  %ld instructions, %d instance(s)\n", MdbSim().getVerInfo(),
+      nbrInst, nbrInsts);
+
+  // lock-step & stepRunAhead give the reference traces
+  std::vector<std::unique_ptr<BenchInst>> insts;
+  std::vector<double>                     refTrace, lockTrace;
+  int                                     fails = 0;
+  for (int mode = LockStep; mode <= Rollback; mode++)
+  {
+    if (!runMode(StepMode(mode), pgm, nbrInst, insts, nbrInsts)) return 1;
+
+    for (int k = 0; k < nbrInsts; k++)
+    {
+      if ((mode == LockStep || mode == RunAhead) && !k)
+        refTrace = insts[k]->trace;
+      else if (insts[k]->trace != (mode == Rollback ? lockTrace : refTrace))
+      {
+        printf("  instance %d pin trace differs from %s\n", k,
+            ModeNames[mode < RunAhead || mode == Rollback ? LockStep
+                                                          : RunAhead]);
+        fails++;
+      }
+    }
+    if (mode == LockStep) lockTrace = refTrace;
+  }
+
+  printf(fails ? "FAILED\n" : "Pin traces match\n");
+
+  // native core vs. lock-step MDB (informational) and native rollback
+  if (runMode(Native, pgm, nbrInst, insts, nbrInsts))
+  {
+    printf(insts[0]->trace == lockTrace
+               ? "Native core pin trace matches lock-step\n"
+               : "Native core pin trace differs from lock-step (expected "
+                 "with MockMdb)\n");
+
+    std::vector<double> nativeTrace = insts[0]->trace;
+    if (!runMode(NativeRollback, pgm, nbrInst, insts, nbrInsts)) return 1;
+    int nativeFails = 0;
+    for (int k = 0; k < nbrInsts; k++)
+      if (insts[k]->trace != nativeTrace)
+      {
+        printf("  instance %d pin trace differs from native core\n", k);
+        nativeFails++;
+      }
+    printf(nativeFails ? "FAILED\n" : "Native rollback pin trace matches\n");
+    fails += nativeFails;
+  }
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * MockMdb is a stand-in for the MDB command-line simulator.  It speaks the
+ * subset of the MDB text protocol that MdbSim uses (device, hwtool, program,
+ * reset, stepi, print pin, write pin, quit) so the QMdbSim stepping code can
+ * be benchmarked and tested without the Microchip tools, on Windows or Linux.
+ *
+ * The "firmware" is fixed:  pin 2 is an output that toggles every TOGGLE
+ * instructions, pin 4 is an output that follows the pin 1 input, pins 0 & 5
+ * are analog inputs, and pins 1 & 3 are digital inputs.  Pin names are RA0-RA5
+ * for PIC devices and PB0-PB5 for AVR devices.
+ *
+ * Options (command line or, since MdbSim passes no arguments, environment):
+ *
+ *   -l usec  MOCKMDB_LATENCY  delay per command (default 0)
+ *   -s msec  MOCKMDB_STARTUP  delay before the first prompt, i.e., the JVM
+ *                             startup (default 0)
+ *   -t n     MOCKMDB_TOGGLE   pin 2 toggle period, instructions (default 100)
+ *
+ * To build:
+ *
+ *   cl /O2 /EHsc MockMdb.cpp
+ *   g++ -O2 -o MockMdb MockMdb.cpp
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// mock device state
+struct MockPin
+{
+  char   name[8];
+  bool   analog;
+  bool   output;
+  double voltage;
+};
+
+const int NbrPins = 6;
+
+MockPin            pins[NbrPins];
+double             vdd       = 5.0;
+unsigned long long instCount = 0;
+long               latency   = 0;   // usec per command
+long               startup   = 0;   // msec before first prompt
+long               toggle    = 100; // pin 2 toggle period (instructions)
+
+// set up the pins for the device (PIC RAx or AVR PBx names)
+void resetDevice(const char* device)
+{
+  const char* port = strncmp(device, "PIC", 3) ? "PB" : "RA";
+  for (int n = 0; n < NbrPins; n++)
+  {
+    snprintf(pins[n].name, sizeof(pins[n].name), "%s%d", port, n);
+    pins[n].analog  = n == 0 || n == 5;
+    pins[n].output  = n == 2 || n == 4;
+    pins[n].voltage = 0;
+  }
+  instCount = 0;
+}
+
+MockPin* findPin(const char* name)
+{
+  for (int n = 0; n < NbrPins; n++)
+    if (!strcmp(pins[n].name, name)) return &pins[n];
+  return NULL;
+}
+
+// execute one "instruction"
+void step()
+{
+  instCount++;
+  pins[2].voltage = (instCount / toggle) & 1 ? vdd : 0;
+  pins[4].voltage = pins[1].voltage > vdd / 2 ? vdd : 0;
+}
+
+// print pin in the MDB format, i.e.:
+//
+//   Pin     Mode    Value   Owner or Mapping
+//   RA0     Ain     5.0V    (RA0)/IOCA0/ANA0/ICDDAT/ICSPDAT
+//
+void printPin(const MockPin& pin)
+{
+  printf("Pin\tMode\tValue\tOwner or Mapping\r\n");
+  if (pin.analog)
+    printf("%s\t%s\t%.3fV\t(%s)\r\n", pin.name, pin.output ? "Aout" : "Ain",
+        pin.voltage, pin.name);
+  else
+    printf("%s\t%s\t%s\t(%s)\r\n", pin.name, pin.output ? "Dout" : "Din",
+        pin.voltage > vdd / 2 ? "HIGH" : "LOW", pin.name);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* env;
+  if ((env = getenv("MOCKMDB_LATENCY"))) latency = atol(env);
+  if ((env = getenv("MOCKMDB_TOGGLE"))) toggle = atol(env);
+  if ((env = getenv("MOCKMDB_STARTUP"))) startup = atol(env);
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!strcmp(argv[i], "-l")) latency = atol(argv[i + 1]);
+    if (!strcmp(argv[i], "-t")) toggle = atol(argv[i + 1]);
+    if (!strcmp(argv[i], "-s")) startup = atol(argv[i + 1]);
+  }
+  if (toggle < 1) toggle = 1;
+
+  resetDevice("PIC");
+  if (startup) std::this_thread::sleep_for(std::chrono::milliseconds(startup));
+
+  // MDB's prompt isn't followed by a newline
+  printf("Mock MDB\r\n>");
+  fflush(stdout);
+
+  char line[512];
+  while (fgets(line, sizeof(line), stdin))
+  {
+    if (latency)
+      std::this_thread::sleep_for(std::chrono::microseconds(latency));
+
+    char cmd[32] = "", arg1[256] = "", arg2[64] = "";
+    sscanf(line, "%31s %255s %63s", cmd, arg1, arg2);
+
+    printf("\r\n");
+    if (!strcmp(cmd, "quit"))
+      break;
+    else if (!strcmp(cmd, "device"))
+      resetDevice(arg1);
+    else if (!strcmp(cmd, "hwtool"))
+      printf("Resetting peripherals\r\n");
+    else if (!strcmp(cmd, "program"))
+      printf("Programming target...\r\nProgram succeeded.\r\n");
+    else if (!strcmp(cmd, "reset"))
+    {
+      for (int n = 0; n < NbrPins; n++) pins[n].voltage = 0;
+      instCount = 0;
+      printf("Resetting target\r\n");
+    }
+    else if (!strcmp(cmd, "stepi"))
+    {
+      step();
+      printf("Stepping\r\nStop at\r\n\taddress:0x%llx\r\n", instCount & 0x7ff);
+    }
+    else if (!strcmp(cmd, "print") && !strcmp(arg1, "pin"))
+    {
+      MockPin* pin = findPin(arg2);
+      if (pin)
+        printPin(*pin);
+      else
+        printf("Invalid pin name %s\r\n", arg2);
+    }
+    else if (!strcmp(cmd, "write") && !strcmp(arg1, "pin"))
+    {
+      // write pin <name> <voltage>V
+      char   name[32];
+      double v;
+      if (sscanf(line, "%*s %*s %31s %lfV", name, &v) != 2)
+        printf("Invalid write pin command\r\n");
+      else if (!strcmp(name, "VDD") || !strcmp(name, "VCC"))
+        vdd = v;
+      else if (MockPin* pin = findPin(name))
+      {
+        if (!pin->output) pin->voltage = v;
+      }
+      else
+        printf("Invalid pin name %s\r\n", name);
+    }
+    else if (*cmd)
+      printf("Unknown command %s\r\n", cmd);
+
+    printf(">");
+    fflush(stdout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,1380 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * In-process instruction-set simulator for AVR25 devices, currently the
+ * ATtiny85 (8K bytes flash, 512 bytes SRAM, 512 bytes EEPROM, PB0-PB5).
+ *
+ * Modeled:
+ *
+ *   - the AVR25 instruction set (no MUL, JMP/CALL, or ELPM); BREAK, WDR, and
+ *     SPM are NOPs;
+ *   - PORTB/DDRB/PINB (digital input threshold VCC/2; PINB writes toggle
+ *     PORTB; DIDR0 disables digital inputs);
+ *   - Timer0 (normal, CTC, fast & phase correct PWM) and Timer1 (normal, CTC,
+ *     PWM1A/PWM1B) on the system clock with their prescalers, compare outputs
+ *     (OC0A/OC0B, OC1A/OC1B and the complementary /OC1A//OC1B), and interrupts;
+ *   - the ADC:  single-ended channels ADC0-ADC3, VBG, GND, and the temperature
+ *     sensor (a fixed 25 C reading); VCC, AREF (PB0), 1.1 V, and 2.56 V
+ *     references; 13 (first 25) ADC clocks per conversion; free running auto
+ *     trigger; its interrupt;
+ *   - EEPROM reads and writes (completing at once), loaded from the ELF;
+ *   - SLEEP:  idle keeps the timers and ADC running, ADC noise reduction the
+ *     ADC only (and starts a conversion), and the other modes stop them all.
+ *
+ * Other I/O registers are plain read/write registers.  Use the MDB backend for
+ * firmware that needs external or pin change interrupts, the USI, the analog
+ * comparator, the PLL clock, differential ADC channels, the watchdog, etc.
+ *
+ * Decoding is table driven:  a table of opcode patterns (mask, match, operand
+ * format) is expanded once into a 64K opcode lookup, and the program is
+ * predecoded through it when loaded.  A step is one instruction regardless of
+ * its cycles (as with MDB stepi); the cycle count clocks the timers and ADC.
+ */
+
+#include "McuCore.h"
+#include "QMdbSim.h"
+
+#include <string.h>
+
+// ATtiny85 I/O register addresses (I/O space; data space is +0x20)
+namespace AvrIo
+{
+const uint8_t ADCSRB = 0x03;
+const uint8_t ADCL   = 0x04;
+const uint8_t ADCH   = 0x05;
+const uint8_t ADCSRA = 0x06;
+const uint8_t ADMUX  = 0x07;
+const uint8_t DIDR0  = 0x14;
+const uint8_t PINB   = 0x16;
+const uint8_t DDRB   = 0x17;
+const uint8_t PORTB  = 0x18;
+const uint8_t EECR   = 0x1C;
+const uint8_t EEDR   = 0x1D;
+const uint8_t EEARL  = 0x1E;
+const uint8_t EEARH  = 0x1F;
+const uint8_t OCR0B  = 0x28;
+const uint8_t OCR0A  = 0x29;
+const uint8_t TCCR0A = 0x2A;
+const uint8_t OCR1B  = 0x2B;
+const uint8_t GTCCR  = 0x2C;
+const uint8_t OCR1C  = 0x2D;
+const uint8_t OCR1A  = 0x2E;
+const uint8_t TCNT1  = 0x2F;
+const uint8_t TCCR1  = 0x30;
+const uint8_t TCNT0  = 0x32;
+const uint8_t TCCR0B = 0x33;
+const uint8_t MCUSR  = 0x34;
+const uint8_t MCUCR  = 0x35;
+const uint8_t TIFR   = 0x38;
+const uint8_t TIMSK  = 0x39;
+const uint8_t GIFR   = 0x3A;
+const uint8_t SPL    = 0x3D;
+const uint8_t SPH    = 0x3E;
+const uint8_t SREG   = 0x3F;
+} // namespace AvrIo
+
+// SREG bits
+const uint8_t SR_C = 0x01;
+const uint8_t SR_Z = 0x02;
+const uint8_t SR_N = 0x04;
+const uint8_t SR_V = 0x08;
+const uint8_t SR_S = 0x10;
+const uint8_t SR_H = 0x20;
+const uint8_t SR_T = 0x40;
+const uint8_t SR_I = 0x80;
+
+// TIFR/TIMSK bits
+const uint8_t TOV0  = 0x02;
+const uint8_t TOV1  = 0x04;
+const uint8_t OCF0B = 0x08;
+const uint8_t OCF0A = 0x10;
+const uint8_t OCF1B = 0x20;
+const uint8_t OCF1A = 0x40;
+
+// TCCR1, GTCCR bits
+const uint8_t CTC1  = 0x80;
+const uint8_t PWM1A = 0x40;
+const uint8_t PWM1B = 0x40;
+
+// ADCSRA bits
+const uint8_t ADEN  = 0x80;
+const uint8_t ADSC  = 0x40;
+const uint8_t ADATE = 0x20;
+const uint8_t ADIF  = 0x10;
+const uint8_t ADIE  = 0x08;
+
+// compare output states (AvrCore::ocState)
+const uint8_t OC0A = 0x01;
+const uint8_t OC0B = 0x02;
+const uint8_t OC1A = 0x04;
+const uint8_t OC1B = 0x08;
+
+// predecoded operations
+enum AvrOp : uint8_t
+{
+  OP_NOP,
+  OP_MOVW,
+  OP_CPC,
+  OP_SBC,
+  OP_ADD,
+  OP_CPSE,
+  OP_CP,
+  OP_SUB,
+  OP_ADC,
+  OP_AND,
+  OP_EOR,
+  OP_OR,
+  OP_MOV,
+  OP_CPI,
+  OP_SBCI,
+  OP_SUBI,
+  OP_ORI,
+  OP_ANDI,
+  OP_LDD_Z, // LDD Rd, Z+q (LD Rd, Z)
+  OP_LDD_Y,
+  OP_STD_Z,
+  OP_STD_Y,
+  OP_LDS,
+  OP_LD_ZP, // LD Rd, Z+
+  OP_LD_MZ, // LD Rd, -Z
+  OP_LPM,   // LPM Rd, Z
+  OP_LPM_P, // LPM Rd, Z+
+  OP_LD_YP,
+  OP_LD_MY,
+  OP_LD_X,
+  OP_LD_XP,
+  OP_LD_MX,
+  OP_POP,
+  OP_STS,
+  OP_ST_ZP,
+  OP_ST_MZ,
+  OP_ST_YP,
+  OP_ST_MY,
+  OP_ST_X,
+  OP_ST_XP,
+  OP_ST_MX,
+  OP_PUSH,
+  OP_COM,
+  OP_NEG,
+  OP_SWAP,
+  OP_INC,
+  OP_ASR,
+  OP_LSR,
+  OP_ROR,
+  OP_DEC,
+  OP_BSET,
+  OP_BCLR,
+  OP_RET,
+  OP_RETI,
+  OP_SLEEP,
+  OP_LPM_R0, // LPM (R0, Z)
+  OP_IJMP,
+  OP_ICALL,
+  OP_ADIW,
+  OP_SBIW,
+  OP_CBI,
+  OP_SBIC,
+  OP_SBI,
+  OP_SBIS,
+  OP_IN,
+  OP_OUT,
+  OP_RJMP,
+  OP_RCALL,
+  OP_LDI,
+  OP_BRBS,
+  OP_BRBC,
+  OP_BLD,
+  OP_BST,
+  OP_SBRC,
+  OP_SBRS
+};
+
+// operand formats
+enum AvrFmt : uint8_t
+{
+  F_NONE,
+  F_DR,   // Rd, Rr (5 bits each)
+  F_D,    // Rd
+  F_DK,   // Rd (R16-R31), K (8 bits)
+  F_DQ,   // Rd, q (6-bit displacement)
+  F_DW,   // Rd, 16-bit address in the next word
+  F_MOVW, // Rd+1:Rd, Rr+1:Rr
+  F_ADIW, // Rd+1:Rd (R24-R30), K (6 bits)
+  F_AB,   // A (I/O 0-31), b
+  F_IO,   // Rd, A (I/O 0-63)
+  F_K12,  // k (12-bit signed)
+  F_BR,   // s, k (7-bit signed)
+  F_S,    // s
+  F_DB    // Rd, b
+};
+
+// opcode patterns -- the first match wins
+struct AvrPattern
+{
+  uint16_t mask;
+  uint16_t match;
+  AvrOp    op;
+  AvrFmt   fmt;
+};
+
+static const AvrPattern Patterns[] = {
+    {0xFFFF, 0x0000, OP_NOP, F_NONE},
+    {0xFF00, 0x0100, OP_MOVW, F_MOVW},
+    {0xFC00, 0x0400, OP_CPC, F_DR},
+    {0xFC00, 0x0800, OP_SBC, F_DR},
+    {0xFC00, 0x0C00, OP_ADD, F_DR},
+    {0xFC00, 0x1000, OP_CPSE, F_DR},
+    {0xFC00, 0x1400, OP_CP, F_DR},
+    {0xFC00, 0x1800, OP_SUB, F_DR},
+    {0xFC00, 0x1C00, OP_ADC, F_DR},
+    {0xFC00, 0x2000, OP_AND, F_DR},
+    {0xFC00, 0x2400, OP_EOR, F_DR},
+    {0xFC00, 0x2800, OP_OR, F_DR},
+    {0xFC00, 0x2C00, OP_MOV, F_DR},
+    {0xF000, 0x3000, OP_CPI, F_DK},
+    {0xF000, 0x4000, OP_SBCI, F_DK},
+    {0xF000, 0x5000, OP_SUBI, F_DK},
+    {0xF000, 0x6000, OP_ORI, F_DK},
+    {0xF000, 0x7000, OP_ANDI, F_DK},
+    {0xD208, 0x8000, OP_LDD_Z, F_DQ},
+    {0xD208, 0x8008, OP_LDD_Y, F_DQ},
+    {0xD208, 0x8200, OP_STD_Z, F_DQ},
+    {0xD208, 0x8208, OP_STD_Y, F_DQ},
+    {0xFE0F, 0x9000, OP_LDS, F_DW},
+    {0xFE0F, 0x9001, OP_LD_ZP, F_D},
+    {0xFE0F, 0x9002, OP_LD_MZ, F_D},
+    {0xFE0F, 0x9004, OP_LPM, F_D},
+    {0xFE0F, 0x9005, OP_LPM_P, F_D},
+    {0xFE0F, 0x9009, OP_LD_YP, F_D},
+    {0xFE0F, 0x900A, OP_LD_MY, F_D},
+    {0xFE0F, 0x900C, OP_LD_X, F_D},
+    {0xFE0F, 0x900D, OP_LD_XP, F_D},
+    {0xFE0F, 0x900E, OP_LD_MX, F_D},
+    {0xFE0F, 0x900F, OP_POP, F_D},
+    {0xFE0F, 0x9200, OP_STS, F_DW},
+    {0xFE0F, 0x9201, OP_ST_ZP, F_D},
+    {0xFE0F, 0x9202, OP_ST_MZ, F_D},
+    {0xFE0F, 0x9209, OP_ST_YP, F_D},
+    {0xFE0F, 0x920A, OP_ST_MY, F_D},
+    {0xFE0F, 0x920C, OP_ST_X, F_D},
+    {0xFE0F, 0x920D, OP_ST_XP, F_D},
+    {0xFE0F, 0x920E, OP_ST_MX, F_D},
+    {0xFE0F, 0x920F, OP_PUSH, F_D},
+    {0xFF8F, 0x9408, OP_BSET, F_S},
+    {0xFF8F, 0x9488, OP_BCLR, F_S},
+    {0xFFFF, 0x9409, OP_IJMP, F_NONE},
+    {0xFFFF, 0x9509, OP_ICALL, F_NONE},
+    {0xFFFF, 0x9508, OP_RET, F_NONE},
+    {0xFFFF, 0x9518, OP_RETI, F_NONE},
+    {0xFFFF, 0x9588, OP_SLEEP, F_NONE},
+    {0xFFFF, 0x95C8, OP_LPM_R0, F_NONE},
+    {0xFE0F, 0x9400, OP_COM, F_D},
+    {0xFE0F, 0x9401, OP_NEG, F_D},
+    {0xFE0F, 0x9402, OP_SWAP, F_D},
+    {0xFE0F, 0x9403, OP_INC, F_D},
+    {0xFE0F, 0x9405, OP_ASR, F_D},
+    {0xFE0F, 0x9406, OP_LSR, F_D},
+    {0xFE0F, 0x9407, OP_ROR, F_D},
+    {0xFE0F, 0x940A, OP_DEC, F_D},
+    {0xFF00, 0x9600, OP_ADIW, F_ADIW},
+    {0xFF00, 0x9700, OP_SBIW, F_ADIW},
+    {0xFF00, 0x9800, OP_CBI, F_AB},
+    {0xFF00, 0x9900, OP_SBIC, F_AB},
+    {0xFF00, 0x9A00, OP_SBI, F_AB},
+    {0xFF00, 0x9B00, OP_SBIS, F_AB},
+    {0xF800, 0xB000, OP_IN, F_IO},
+    {0xF800, 0xB800, OP_OUT, F_IO},
+    {0xF000, 0xC000, OP_RJMP, F_K12},
+    {0xF000, 0xD000, OP_RCALL, F_K12},
+    {0xF000, 0xE000, OP_LDI, F_DK},
+    {0xFC00, 0xF000, OP_BRBS, F_BR},
+    {0xFC00, 0xF400, OP_BRBC, F_BR},
+    {0xFE08, 0xF800, OP_BLD, F_DB},
+    {0xFE08, 0xFA00, OP_BST, F_DB},
+    {0xFE08, 0xFC00, OP_SBRC, F_DB},
+    {0xFE08, 0xFE00, OP_SBRS, F_DB},
+};
+
+const int NbrPatterns = sizeof(Patterns) / sizeof(Patterns[0]);
+
+// opcode -> pattern index (NbrPatterns if none), built on first use
+struct AvrDecodeTable
+{
+  uint8_t index[0x10000];
+
+  AvrDecodeTable()
+  {
+    for (unsigned op = 0; op < 0x10000; op++)
+    {
+      int n = 0;
+      while (n < NbrPatterns && (op & Patterns[n].mask) != Patterns[n].match)
+        n++;
+      index[op] = uint8_t(n);
+    }
+  }
+};
+
+// predecoded instruction:  d is Rd, r is Rr, the bit number, or the SREG bit;
+// k is the literal, displacement, I/O or data address, or (sign-extended)
+// offset
+struct AvrInst
+{
+  AvrOp    op;
+  uint8_t  d;
+  uint8_t  r;
+  uint16_t k;
+};
+
+// sign-extend the low n bits of v
+static inline uint16_t sext(unsigned v, int n)
+{
+  unsigned m = 1u << (n - 1);
+  return uint16_t(((v & ((m << 1) - 1)) ^ m) - m);
+}
+
+// decode an instruction (next is the following word, for LDS/STS); unknown
+// opcodes are NOPs
+static AvrInst decode(uint16_t op, uint16_t next)
+{
+  static const AvrDecodeTable table;
+
+  unsigned n = table.index[op];
+  if (n == unsigned(NbrPatterns)) return {OP_NOP, 0, 0, 0};
+
+  AvrInst in = {Patterns[n].op, uint8_t(op >> 4 & 0x1F), 0, 0};
+  switch (Patterns[n].fmt)
+  {
+    case F_NONE:
+    case F_D: break;
+    case F_DR: in.r = (op & 0x0F) | (op >> 5 & 0x10); break;
+    case F_DK:
+      in.d = 16 + (op >> 4 & 0x0F);
+      in.k = (op & 0x0F) | (op >> 4 & 0xF0);
+      break;
+    case F_DQ: in.k = (op & 0x07) | (op >> 7 & 0x18) | (op >> 8 & 0x20); break;
+    case F_DW: in.k = next; break;
+    case F_MOVW:
+      in.d = (op >> 4 & 0x0F) * 2;
+      in.r = (op & 0x0F) * 2;
+      break;
+    case F_ADIW:
+      in.d = 24 + (op >> 3 & 0x06);
+      in.k = (op & 0x0F) | (op >> 2 & 0x30);
+      break;
+    case F_AB:
+      in.k = op >> 3 & 0x1F;
+      in.r = op & 0x07;
+      break;
+    case F_IO: in.k = (op & 0x0F) | (op >> 5 & 0x30); break;
+    case F_K12: in.k = sext(op, 12); break;
+    case F_BR:
+      in.r = op & 0x07;
+      in.k = sext(op >> 3, 7);
+      break;
+    case F_S: in.r = op >> 4 & 0x07; break;
+    case F_DB: in.r = op & 0x07; break;
+  }
+  return in;
+}
+
+/*
+ * AVR core
+ */
+// mutable core state -- a plain struct so saveState()/restoreState() can copy
+// it whole
+struct AvrState
+{
+  static const int DataSize   = 0x260; // registers, I/O, & SRAM
+  static const int EepromSize = 512;
+  static const int NbrPins    = 6; // PB0-PB5
+
+  // CPU
+  uint16_t pc;
+  uint16_t sp;
+  uint8_t  sreg;
+  bool     sleeping;
+  bool     intDelay; // SEI/RETI:  one more instruction before an interrupt
+  unsigned cycles;   // cycles of the current instruction
+
+  // registers, I/O registers, & SRAM (data space addresses)
+  uint8_t data[DataSize];
+  uint8_t eeprom[EepromSize];
+
+  // pins
+  double  vcc = 5.0;
+  double  pinV[NbrPins];
+  uint8_t pinHigh; // input levels (pinV > vcc/2)
+
+  // timers
+  unsigned t0Pre; // prescaler counts (cycles)
+  unsigned t1Pre;
+  bool     t0Down;  // phase correct PWM down-counting
+  uint8_t  ocState; // compare outputs (OC0A etc.)
+
+  // ADC
+  unsigned adcCycles; // until the conversion completes (0 if none)
+  unsigned adcResult; // sampled at the start of the conversion
+  bool     adcFirst;  // first conversion after enabling
+};
+
+class AvrCore : public McuCore, protected AvrState
+{
+public:
+  AvrCore() { load(NULL); }
+
+  bool load(const char* pgmPath) override;
+  void reset() override;
+  void step() override;
+  int  findPin(const char* pinName) override;
+  void getPin(int pin, PinState& pinState) override;
+  void setPin(int pin, double voltage) override;
+  bool setSupply(const char* pinName, double voltage) override;
+  void saveState(std::vector<uint8_t>& state) override;
+  void restoreState(const std::vector<uint8_t>& state) override;
+
+protected:
+  static const int      FlashSize  = 8192; // bytes
+  static const int      FlashWords = FlashSize / 2;
+  static const uint8_t  PinMask    = 0x3F;
+  static const uint16_t ElfMachine = 83;       // EM_AVR
+  static const uint32_t EepromAddr = 0x810000; // ELF .eeprom
+
+  uint8_t flash[FlashSize];
+  AvrInst code[FlashWords];
+  uint8_t eepromInit[EepromSize]; // as loaded
+
+  uint8_t readData(uint16_t addr);
+  void    writeData(uint16_t addr, uint8_t v);
+  uint8_t readIo(uint8_t addr);
+  void    writeIo(uint8_t addr, uint8_t v);
+  void    setIoBit(uint8_t addr, int bit, bool set);
+
+  void    interrupt();
+  uint8_t portLevels();
+  void    timer0();
+  void    t0Count();
+  void    timer1();
+  void    t1Count();
+  void    adcStart();
+  void    adcClock();
+  void    eepromAccess(uint8_t v);
+
+  inline uint8_t& io(uint8_t addr) { return data[0x20 + addr]; }
+
+  // X, Y, & Z
+  inline uint16_t pair(int n) { return data[n] | data[n + 1] << 8; }
+  inline void     setPair(int n, uint16_t v)
+  {
+    data[n]     = uint8_t(v);
+    data[n + 1] = uint8_t(v >> 8);
+  }
+
+  inline void push(uint8_t v) { writeData(sp--, v); }
+  inline uint8_t pop() { return readData(++sp); }
+
+  inline void pushPc()
+  {
+    push(uint8_t(pc));
+    push(uint8_t(pc >> 8));
+  }
+  inline void popPc()
+  {
+    uint16_t hi = pop();
+    pc          = (hi << 8 | pop()) & (FlashWords - 1);
+  }
+
+  // skip the next instruction (two words for LDS/STS)
+  inline void skip()
+  {
+    AvrOp    op    = code[pc].op;
+    unsigned words = op == OP_LDS || op == OP_STS ? 2 : 1;
+    pc             = (pc + words) & (FlashWords - 1);
+    cycles += words;
+  }
+
+  // S, N, & Z for result r, given the other flags f
+  static inline unsigned nzs(unsigned f, uint8_t r)
+  {
+    if (r & 0x80) f |= SR_N;
+    if (!r) f |= SR_Z;
+    if ((f >> 2 ^ f >> 3) & 1) f |= SR_S; // N ^ V
+    return f;
+  }
+
+  // a + b + c with H, S, V, N, Z, & C
+  inline uint8_t add(uint8_t a, uint8_t b, unsigned c)
+  {
+    unsigned r = a + b + c;
+    unsigned f = (r > 0xFF ? SR_C : 0) |
+                 ((a & 0x0F) + (b & 0x0F) + c > 0x0F ? SR_H : 0) |
+                 (~(a ^ b) & (a ^ r) & 0x80 ? SR_V : 0);
+    sreg = uint8_t((sreg & (SR_I | SR_T)) | nzs(f, uint8_t(r)));
+    return uint8_t(r);
+  }
+
+  // a - b - c with H, S, V, N, Z, & C; with carry (SBC, SBCI, CPC), Z is only
+  // kept
+  inline uint8_t sub(uint8_t a, uint8_t b, unsigned c, bool withCarry)
+  {
+    unsigned r = unsigned(a - b - c);
+    unsigned f = (a < b + c ? SR_C : 0) |
+                 ((a & 0x0Fu) < (b & 0x0Fu) + c ? SR_H : 0) |
+                 ((a ^ b) & (a ^ r) & 0x80 ? SR_V : 0);
+    f = nzs(f, uint8_t(r));
+    if (withCarry && !(sreg & SR_Z)) f &= ~SR_Z;
+    sreg = uint8_t((sreg & (SR_I | SR_T)) | f);
+    return uint8_t(r);
+  }
+
+  // AND, OR, EOR, etc.:  S, V (cleared), N, & Z
+  inline uint8_t logic(uint8_t r)
+  {
+    sreg = uint8_t((sreg & (SR_I | SR_T | SR_H | SR_C)) | nzs(0, r));
+    return r;
+  }
+
+  // ASR, LSR, & ROR:  C is the bit shifted out, V = N ^ C
+  inline uint8_t shift(uint8_t r, unsigned c)
+  {
+    unsigned f = (c ? SR_C : 0) | ((r >> 7 ^ c) & 1 ? SR_V : 0);
+    sreg       = uint8_t((sreg & (SR_I | SR_T | SR_H)) | nzs(f, r));
+    return r;
+  }
+
+  // ADIW & SBIW:  S, V, N, Z, & C for the 16-bit result r of a
+  inline void wordFlags(uint16_t a, uint16_t r, bool subtract)
+  {
+    unsigned c = subtract ? r & ~a : ~r & a;
+    unsigned v = subtract ? a & ~r : r & ~a;
+    unsigned f = (c & 0x8000 ? SR_C : 0) | (v & 0x8000 ? SR_V : 0) |
+                 (r & 0x8000 ? SR_N : 0) | (r ? 0 : SR_Z);
+    if ((f >> 2 ^ f >> 3) & 1) f |= SR_S;
+    sreg = uint8_t((sreg & (SR_I | SR_T | SR_H)) | f);
+  }
+
+  // compare output action on oc:  1 toggle, 2 clear, 3 set
+  inline void ocAction(uint8_t oc, unsigned act)
+  {
+    if (act == 1) ocState ^= oc;
+    if (act == 2) ocState &= ~oc;
+    if (act == 3) ocState |= oc;
+  }
+
+  inline bool intPending()
+  {
+    using namespace AvrIo;
+    return (sreg & SR_I) && ((io(TIFR) & io(TIMSK)) ||
+                                (io(ADCSRA) & (ADIF | ADIE)) == (ADIF | ADIE));
+  }
+
+  // clock the timers & ADC for the current instruction's cycles
+  inline void clockPeripherals()
+  {
+    using namespace AvrIo;
+    if (io(TCCR0B) & 0x07) timer0();
+    if (io(TCCR1) & 0x0F) timer1();
+    if (adcCycles) adcClock();
+  }
+};
+
+McuCore* newAvrCore(const char* deviceName)
+{
+  if (strcmp(deviceName, "ATtiny85")) return NULL;
+  return new AvrCore;
+}
+
+// load ELF or HEX program memory (byte addresses) and the ELF .eeprom
+// section; SRAM data (.data's load address is in flash), fuses, etc. are
+// ignored.  NULL loads an erased device.
+bool AvrCore::load(const char* pgmPath)
+{
+  memset(flash, 0xFF, sizeof(flash));
+  memset(eepromInit, 0xFF, sizeof(eepromInit));
+
+  std::vector<Segment> segments;
+  bool                 isElf;
+  if (pgmPath && !loadSegments(pgmPath, ElfMachine, segments, isElf))
+    return false;
+
+  for (const Segment& seg : segments)
+    for (size_t i = 0; i < seg.bytes.size(); i++)
+    {
+      uint32_t addr = seg.addr + uint32_t(i);
+      if (addr < FlashSize)
+        flash[addr] = seg.bytes[i];
+      else if (addr - EepromAddr < EepromSize)
+        eepromInit[addr - EepromAddr] = seg.bytes[i];
+    }
+
+  for (int i = 0; i < FlashWords; i++)
+  {
+    int next = (i + 1) & (FlashWords - 1);
+    code[i]  = decode(flash[2 * i] | flash[2 * i + 1] << 8,
+        flash[2 * next] | flash[2 * next + 1] << 8);
+  }
+
+  // pins float low until set.  the external inputs aren't core state, so
+  // reset() keeps them
+  for (double& v : pinV) v = 0;
+  pinHigh = 0;
+
+  reset();
+  return true;
+}
+
+void AvrCore::reset()
+{
+  using namespace AvrIo;
+
+  memset(data, 0, sizeof(data));
+  memcpy(eeprom, eepromInit, sizeof(eeprom));
+  pc       = 0;
+  sp       = DataSize - 1; // RAMEND
+  sreg     = 0;
+  sleeping = false;
+  intDelay = false;
+
+  io(MCUSR) = 0x01; // PORF
+
+  t0Pre = t1Pre = 0;
+  t0Down        = false;
+  ocState       = 0;
+  adcCycles     = 0;
+  adcResult     = 0;
+  adcFirst      = true;
+}
+
+void AvrCore::step()
+{
+  using namespace AvrIo;
+
+  cycles = 1;
+
+  // interrupt -- vectoring takes the step
+  if (intDelay)
+    intDelay = false;
+  else if (intPending())
+  {
+    sleeping = false;
+    interrupt();
+    clockPeripherals();
+    return;
+  }
+
+  if (sleeping)
+  {
+    unsigned mode = io(MCUCR) >> 3 & 3;
+    if (mode == 0)
+      clockPeripherals(); // idle
+    else if (mode == 1 && adcCycles)
+      adcClock(); // ADC noise reduction
+    return;
+  }
+
+  const AvrInst in = code[pc];
+  pc               = (pc + 1) & (FlashWords - 1);
+
+  uint8_t* r = data; // register file
+  uint16_t addr;
+  switch (in.op)
+  {
+    case OP_NOP: break;
+    case OP_MOVW:
+      r[in.d]     = r[in.r];
+      r[in.d + 1] = r[in.r + 1];
+      break;
+    case OP_CPC: sub(r[in.d], r[in.r], sreg & SR_C, true); break;
+    case OP_SBC: r[in.d] = sub(r[in.d], r[in.r], sreg & SR_C, true); break;
+    case OP_ADD: r[in.d] = add(r[in.d], r[in.r], 0); break;
+    case OP_CPSE:
+      if (r[in.d] == r[in.r]) skip();
+      break;
+    case OP_CP: sub(r[in.d], r[in.r], 0, false); break;
+    case OP_SUB: r[in.d] = sub(r[in.d], r[in.r], 0, false); break;
+    case OP_ADC: r[in.d] = add(r[in.d], r[in.r], sreg & SR_C); break;
+    case OP_AND: r[in.d] = logic(r[in.d] & r[in.r]); break;
+    case OP_EOR: r[in.d] = logic(r[in.d] ^ r[in.r]); break;
+    case OP_OR: r[in.d] = logic(r[in.d] | r[in.r]); break;
+    case OP_MOV: r[in.d] = r[in.r]; break;
+    case OP_CPI: sub(r[in.d], uint8_t(in.k), 0, false); break;
+    case OP_SBCI:
+      r[in.d] = sub(r[in.d], uint8_t(in.k), sreg & SR_C, true);
+      break;
+    case OP_SUBI: r[in.d] = sub(r[in.d], uint8_t(in.k), 0, false); break;
+    case OP_ORI: r[in.d] = logic(r[in.d] | uint8_t(in.k)); break;
+    case OP_ANDI: r[in.d] = logic(r[in.d] & uint8_t(in.k)); break;
+    case OP_LDD_Z:
+      r[in.d] = readData(pair(30) + in.k);
+      cycles  = 2;
+      break;
+    case OP_LDD_Y:
+      r[in.d] = readData(pair(28) + in.k);
+      cycles  = 2;
+      break;
+    case OP_STD_Z:
+      writeData(pair(30) + in.k, r[in.d]);
+      cycles = 2;
+      break;
+    case OP_STD_Y:
+      writeData(pair(28) + in.k, r[in.d]);
+      cycles = 2;
+      break;
+    case OP_LDS:
+      r[in.d] = readData(in.k);
+      pc      = (pc + 1) & (FlashWords - 1);
+      cycles  = 2;
+      break;
+    case OP_LD_ZP:
+      addr    = pair(30);
+      r[in.d] = readData(addr);
+      setPair(30, addr + 1);
+      cycles = 2;
+      break;
+    case OP_LD_MZ:
+      addr = pair(30) - 1;
+      setPair(30, addr);
+      r[in.d] = readData(addr);
+      cycles  = 2;
+      break;
+    case OP_LPM:
+      r[in.d] = flash[pair(30) & (FlashSize - 1)];
+      cycles  = 3;
+      break;
+    case OP_LPM_P:
+      addr    = pair(30);
+      r[in.d] = flash[addr & (FlashSize - 1)];
+      setPair(30, addr + 1);
+      cycles = 3;
+      break;
+    case OP_LD_YP:
+      addr    = pair(28);
+      r[in.d] = readData(addr);
+      setPair(28, addr + 1);
+      cycles = 2;
+      break;
+    case OP_LD_MY:
+      addr = pair(28) - 1;
+      setPair(28, addr);
+      r[in.d] = readData(addr);
+      cycles  = 2;
+      break;
+    case OP_LD_X:
+      r[in.d] = readData(pair(26));
+      cycles  = 2;
+      break;
+    case OP_LD_XP:
+      addr    = pair(26);
+      r[in.d] = readData(addr);
+      setPair(26, addr + 1);
+      cycles = 2;
+      break;
+    case OP_LD_MX:
+      addr = pair(26) - 1;
+      setPair(26, addr);
+      r[in.d] = readData(addr);
+      cycles  = 2;
+      break;
+    case OP_POP:
+      r[in.d] = pop();
+      cycles  = 2;
+      break;
+    case OP_STS:
+      writeData(in.k, r[in.d]);
+      pc     = (pc + 1) & (FlashWords - 1);
+      cycles = 2;
+      break;
+    case OP_ST_ZP:
+      addr = pair(30);
+      writeData(addr, r[in.d]);
+      setPair(30, addr + 1);
+      cycles = 2;
+      break;
+    case OP_ST_MZ:
+      addr = pair(30) - 1;
+      setPair(30, addr);
+      writeData(addr, r[in.d]);
+      cycles = 2;
+      break;
+    case OP_ST_YP:
+      addr = pair(28);
+      writeData(addr, r[in.d]);
+      setPair(28, addr + 1);
+      cycles = 2;
+      break;
+    case OP_ST_MY:
+      addr = pair(28) - 1;
+      setPair(28, addr);
+      writeData(addr, r[in.d]);
+      cycles = 2;
+      break;
+    case OP_ST_X:
+      writeData(pair(26), r[in.d]);
+      cycles = 2;
+      break;
+    case OP_ST_XP:
+      addr = pair(26);
+      writeData(addr, r[in.d]);
+      setPair(26, addr + 1);
+      cycles = 2;
+      break;
+    case OP_ST_MX:
+      addr = pair(26) - 1;
+      setPair(26, addr);
+      writeData(addr, r[in.d]);
+      cycles = 2;
+      break;
+    case OP_PUSH:
+      push(r[in.d]);
+      cycles = 2;
+      break;
+    case OP_COM:
+      r[in.d] = uint8_t(~r[in.d]);
+      sreg = uint8_t((sreg & (SR_I | SR_T | SR_H)) | nzs(SR_C, r[in.d]));
+      break;
+    case OP_NEG: r[in.d] = sub(0, r[in.d], 0, false); break;
+    case OP_SWAP: r[in.d] = uint8_t(r[in.d] << 4 | r[in.d] >> 4); break;
+    case OP_INC:
+      r[in.d]++;
+      sreg = uint8_t((sreg & (SR_I | SR_T | SR_H | SR_C)) |
+                     nzs(r[in.d] == 0x80 ? SR_V : 0, r[in.d]));
+      break;
+    case OP_ASR:
+      r[in.d] = shift(uint8_t(r[in.d] >> 1 | (r[in.d] & 0x80)), r[in.d] & 1);
+      break;
+    case OP_LSR: r[in.d] = shift(r[in.d] >> 1, r[in.d] & 1); break;
+    case OP_ROR:
+      r[in.d] =
+          shift(uint8_t(r[in.d] >> 1 | (sreg & SR_C) << 7), r[in.d] & 1);
+      break;
+    case OP_DEC:
+      r[in.d]--;
+      sreg = uint8_t((sreg & (SR_I | SR_T | SR_H | SR_C)) |
+                     nzs(r[in.d] == 0x7F ? SR_V : 0, r[in.d]));
+      break;
+    case OP_BSET:
+      if (in.r == 7 && !(sreg & SR_I)) intDelay = true; // SEI
+      sreg |= 1 << in.r;
+      break;
+    case OP_BCLR: sreg &= ~(1 << in.r); break;
+    case OP_RET:
+      popPc();
+      cycles = 4;
+      break;
+    case OP_RETI:
+      popPc();
+      sreg |= SR_I;
+      intDelay = true;
+      cycles   = 4;
+      break;
+    case OP_SLEEP:
+      if (!(io(MCUCR) & 0x20)) break; // SE
+      sleeping = true;
+      if ((io(MCUCR) >> 3 & 3) == 1 && (io(ADCSRA) & ADEN) && !adcCycles)
+        adcStart();
+      break;
+    case OP_LPM_R0:
+      r[0]   = flash[pair(30) & (FlashSize - 1)];
+      cycles = 3;
+      break;
+    case OP_IJMP:
+      pc     = pair(30) & (FlashWords - 1);
+      cycles = 2;
+      break;
+    case OP_ICALL:
+      pushPc();
+      pc     = pair(30) & (FlashWords - 1);
+      cycles = 3;
+      break;
+    case OP_ADIW:
+      addr = pair(in.d);
+      setPair(in.d, addr + in.k);
+      wordFlags(addr, pair(in.d), false);
+      cycles = 2;
+      break;
+    case OP_SBIW:
+      addr = pair(in.d);
+      setPair(in.d, addr - in.k);
+      wordFlags(addr, pair(in.d), true);
+      cycles = 2;
+      break;
+    case OP_CBI:
+      setIoBit(uint8_t(in.k), in.r, false);
+      cycles = 2;
+      break;
+    case OP_SBIC:
+      if (!(readIo(uint8_t(in.k)) >> in.r & 1)) skip();
+      break;
+    case OP_SBI:
+      setIoBit(uint8_t(in.k), in.r, true);
+      cycles = 2;
+      break;
+    case OP_SBIS:
+      if (readIo(uint8_t(in.k)) >> in.r & 1) skip();
+      break;
+    case OP_IN: r[in.d] = readIo(uint8_t(in.k)); break;
+    case OP_OUT: writeIo(uint8_t(in.k), r[in.d]); break;
+    case OP_RJMP:
+      pc     = (pc + in.k) & (FlashWords - 1);
+      cycles = 2;
+      break;
+    case OP_RCALL:
+      pushPc();
+      pc     = (pc + in.k) & (FlashWords - 1);
+      cycles = 3;
+      break;
+    case OP_LDI: r[in.d] = uint8_t(in.k); break;
+    case OP_BRBS:
+      if (sreg >> in.r & 1)
+      {
+        pc     = (pc + in.k) & (FlashWords - 1);
+        cycles = 2;
+      }
+      break;
+    case OP_BRBC:
+      if (!(sreg >> in.r & 1))
+      {
+        pc     = (pc + in.k) & (FlashWords - 1);
+        cycles = 2;
+      }
+      break;
+    case OP_BLD:
+      if (sreg & SR_T)
+        r[in.d] |= 1 << in.r;
+      else
+        r[in.d] &= ~(1 << in.r);
+      break;
+    case OP_BST:
+      sreg = uint8_t((sreg & ~SR_T) | (r[in.d] >> in.r & 1 ? SR_T : 0));
+      break;
+    case OP_SBRC:
+      if (!(r[in.d] >> in.r & 1)) skip();
+      break;
+    case OP_SBRS:
+      if (r[in.d] >> in.r & 1) skip();
+      break;
+  }
+
+  clockPeripherals();
+}
+
+// vector to the highest priority pending interrupt; the flag is cleared
+void AvrCore::interrupt()
+{
+  using namespace AvrIo;
+
+  // timer & ADC vectors in priority order (flag 0 is the ADC)
+  static const uint8_t Vectors[][2] = {{3, OCF1A}, {4, TOV1}, {5, TOV0},
+      {8, 0}, {9, OCF1B}, {10, OCF0A}, {11, OCF0B}};
+
+  uint8_t flags = io(TIFR) & io(TIMSK);
+  for (const auto& vec : Vectors)
+  {
+    if (vec[1] ? !(flags & vec[1])
+               : (io(ADCSRA) & (ADIF | ADIE)) != (ADIF | ADIE))
+      continue;
+
+    if (vec[1])
+      io(TIFR) &= ~vec[1];
+    else
+      io(ADCSRA) &= ~ADIF;
+    pushPc();
+    sreg &= ~SR_I;
+    pc     = vec[0];
+    cycles = 4;
+    return;
+  }
+}
+
+// data space access:  registers 0x00-0x1F, I/O 0x20-0x5F, SRAM 0x60-0x25F
+uint8_t AvrCore::readData(uint16_t addr)
+{
+  if (unsigned(addr - 0x20) < 0x40) return readIo(uint8_t(addr - 0x20));
+  return addr < DataSize ? data[addr] : 0;
+}
+
+void AvrCore::writeData(uint16_t addr, uint8_t v)
+{
+  if (unsigned(addr - 0x20) < 0x40)
+    writeIo(uint8_t(addr - 0x20), v);
+  else if (addr < DataSize)
+    data[addr] = v;
+}
+
+uint8_t AvrCore::readIo(uint8_t addr)
+{
+  using namespace AvrIo;
+
+  switch (addr)
+  {
+    case PINB:
+      // digital input buffers are off for DIDR0 pins
+      return ((io(DDRB) & portLevels()) | (~io(DDRB) & pinHigh)) &
+             ~io(DIDR0) & PinMask;
+    case SPL: return uint8_t(sp);
+    case SPH: return uint8_t(sp >> 8);
+    case SREG: return sreg;
+  }
+  return io(addr);
+}
+
+void AvrCore::writeIo(uint8_t addr, uint8_t v)
+{
+  using namespace AvrIo;
+
+  switch (addr)
+  {
+    case PINB: io(PORTB) ^= v & PinMask; return;
+    case PORTB:
+    case DDRB: v &= PinMask; break;
+    case SPL: sp = (sp & 0xFF00) | v; return;
+    case SPH: sp = (sp & 0x00FF) | (v & 0x03) << 8; return;
+    case SREG: sreg = v; return;
+    case TIFR:
+    case GIFR: io(addr) &= ~v; return; // flags clear on writing 1
+    case ADCSRA:
+    {
+      // ADIF clears on writing 1; ADSC starts a conversion and stays set
+      // until it completes; clearing ADEN aborts it
+      bool start = v & ADSC;
+      v = (v & ~(ADIF | ADSC)) | (io(addr) & (ADIF | ADSC) & ~(v & ADIF));
+      if (!(v & ADEN))
+      {
+        v &= ~ADSC;
+        adcCycles = 0;
+        adcFirst  = true;
+      }
+      io(addr) = v;
+      if (start && v & ADEN && !adcCycles) adcStart();
+      return;
+    }
+    case TCCR0B:
+      // FOC0A/FOC0B:  force a compare match (non-PWM modes), no flag
+      if (v & 0xC0 && !(io(TCCR0A) & 0x01))
+      {
+        if (v & 0x80) ocAction(OC0A, io(TCCR0A) >> 6);
+        if (v & 0x40) ocAction(OC0B, io(TCCR0A) >> 4 & 3);
+      }
+      v &= 0x0F;
+      break;
+    case GTCCR:
+      // PSR0/PSR1 reset the prescalers, FOC1A/FOC1B force a compare match
+      if (v & 0x01) t0Pre = 0;
+      if (v & 0x02) t1Pre = 0;
+      if (v & 0x04 && !(io(TCCR1) & PWM1A)) ocAction(OC1A, io(TCCR1) >> 4 & 3);
+      if (v & 0x08 && !(v & PWM1B)) ocAction(OC1B, v >> 4 & 3);
+      v &= 0xF0;
+      break;
+    case EECR: eepromAccess(v); return;
+  }
+  io(addr) = v;
+}
+
+// SBI/CBI:  only the addressed bit is written (ADIF isn't cleared by writing
+// back a set flag, and only the addressed PINB bit toggles)
+void AvrCore::setIoBit(uint8_t addr, int bit, bool set)
+{
+  using namespace AvrIo;
+
+  if (addr == PINB)
+  {
+    if (set) writeIo(PINB, uint8_t(1 << bit));
+    return;
+  }
+
+  uint8_t v = readIo(addr);
+  if (addr == ADCSRA) v &= ~ADIF;
+  writeIo(addr, uint8_t(set ? v | 1 << bit : v & ~(1 << bit)));
+}
+
+// PORTB with the enabled compare outputs (Timer1's override Timer0's)
+uint8_t AvrCore::portLevels()
+{
+  using namespace AvrIo;
+
+  uint8_t out = io(PORTB);
+  auto    put = [&out](int pin, bool high) {
+    out = uint8_t(high ? out | 1 << pin : out & ~(1 << pin));
+  };
+
+  unsigned wgm  = (io(TCCR0A) & 3) | (io(TCCR0B) >> 1 & 4);
+  bool     pwm0 = wgm != 0 && wgm != 2;
+  unsigned com  = io(TCCR0A) >> 6;
+  if (com && !(pwm0 && com == 1 && !(wgm & 4))) put(0, ocState & OC0A);
+  com = io(TCCR0A) >> 4 & 3;
+  if (com && !(pwm0 && com == 1)) put(1, ocState & OC0B);
+
+  if ((com = io(TCCR1) >> 4 & 3))
+  {
+    put(1, ocState & OC1A);
+    if (com == 1 && io(TCCR1) & PWM1A) put(0, !(ocState & OC1A));
+  }
+  if ((com = io(GTCCR) >> 4 & 3))
+  {
+    put(4, ocState & OC1B);
+    if (com == 1 && io(GTCCR) & PWM1B) put(3, !(ocState & OC1B));
+  }
+  return out;
+}
+
+// clock Timer0 (system clock prescaler; external T0 clocks aren't modeled)
+void AvrCore::timer0()
+{
+  using namespace AvrIo;
+
+  static const unsigned Prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+  unsigned prescale = Prescale[io(TCCR0B) & 7];
+  if (!prescale) return;
+  for (t0Pre += cycles; t0Pre >= prescale; t0Pre -= prescale) t0Count();
+}
+
+// one Timer0 count.  a compare match sets its flag and acts on the compare
+// output per COM0x and the mode at the count after TCNT0 equals OCR0x.
+void AvrCore::t0Count()
+{
+  using namespace AvrIo;
+
+  unsigned wgm   = (io(TCCR0A) & 3) | (io(TCCR0B) >> 1 & 4);
+  bool     pwm   = wgm != 0 && wgm != 2;
+  bool     phase = (wgm & 3) == 1; // phase correct PWM (modes 1 & 5)
+  uint8_t  top   = wgm == 2 || wgm & 4 ? io(OCR0A) : 0xFF;
+  unsigned comA  = io(TCCR0A) >> 6;
+  unsigned comB  = io(TCCR0A) >> 4 & 3;
+
+  // PWM:  COM 2 clears on match (and sets at BOTTOM), COM 3 the reverse,
+  // inverted while phase correct down-counting; COM 1 toggles OC0A with
+  // OCR0A as TOP
+  auto matchAct = [&](unsigned com, bool toggleOk) -> unsigned {
+    if (!pwm) return com;
+    if (com == 1) return toggleOk ? 1 : 0;
+    return phase && t0Down ? com ^ 1 : com;
+  };
+
+  uint8_t& tcnt = io(TCNT0);
+  if (tcnt == io(OCR0A))
+  {
+    io(TIFR) |= OCF0A;
+    ocAction(OC0A, matchAct(comA, wgm & 4));
+  }
+  if (tcnt == io(OCR0B))
+  {
+    io(TIFR) |= OCF0B;
+    ocAction(OC0B, matchAct(comB, false));
+  }
+
+  if (phase)
+  {
+    if (t0Down)
+    {
+      if (!--tcnt)
+      {
+        t0Down = false;
+        io(TIFR) |= TOV0;
+      }
+    }
+    else if (++tcnt >= top)
+      t0Down = true;
+  }
+  else if (tcnt == top)
+  {
+    tcnt = 0;
+    if (wgm != 2 || top == 0xFF) io(TIFR) |= TOV0; // CTC:  at MAX only
+    if (pwm && comA >= 2) ocAction(OC0A, comA ^ 1);
+    if (pwm && comB >= 2) ocAction(OC0B, comB ^ 1);
+  }
+  else if (!++tcnt)
+    io(TIFR) |= TOV0;
+}
+
+// clock Timer1 (system clock prescaler; the PLL clock isn't modeled)
+void AvrCore::timer1()
+{
+  using namespace AvrIo;
+
+  unsigned prescale = 1u << ((io(TCCR1) & 0x0F) - 1);
+  for (t1Pre += cycles; t1Pre >= prescale; t1Pre -= prescale) t1Count();
+}
+
+// one Timer1 count.  TOP is OCR1C in PWM or CTC mode, otherwise 0xFF.  in PWM
+// mode, COM1x 1 & 2 clear OC1x on match and set it at BOTTOM, COM1x 3 the
+// reverse.
+void AvrCore::t1Count()
+{
+  using namespace AvrIo;
+
+  bool     pwmA = io(TCCR1) & PWM1A;
+  bool     pwmB = io(GTCCR) & PWM1B;
+  uint8_t  top  = pwmA || pwmB || io(TCCR1) & CTC1 ? io(OCR1C) : 0xFF;
+  unsigned comA = io(TCCR1) >> 4 & 3;
+  unsigned comB = io(GTCCR) >> 4 & 3;
+
+  auto matchAct = [](unsigned com, bool pwm) -> unsigned {
+    return pwm && com ? (com == 3 ? 3 : 2) : com;
+  };
+
+  uint8_t& tcnt = io(TCNT1);
+  if (tcnt == io(OCR1A))
+  {
+    io(TIFR) |= OCF1A;
+    ocAction(OC1A, matchAct(comA, pwmA));
+  }
+  if (tcnt == io(OCR1B))
+  {
+    io(TIFR) |= OCF1B;
+    ocAction(OC1B, matchAct(comB, pwmB));
+  }
+
+  if (tcnt == top)
+  {
+    tcnt = 0;
+    io(TIFR) |= TOV1;
+    if (pwmA && comA) ocAction(OC1A, comA == 3 ? 2 : 3);
+    if (pwmB && comB) ocAction(OC1B, comB == 3 ? 2 : 3);
+  }
+  else if (!++tcnt)
+    io(TIFR) |= TOV1;
+}
+
+// start a conversion:  sample the input now, complete after 13 ADC clocks (25
+// for the first after enabling)
+void AvrCore::adcStart()
+{
+  using namespace AvrIo;
+
+  static const int AdcPins[4] = {5, 2, 4, 3}; // ADC0-ADC3
+
+  unsigned prescale = io(ADCSRA) & 7 ? 1u << (io(ADCSRA) & 7) : 2;
+  adcCycles         = (adcFirst ? 25 : 13) * prescale;
+  adcFirst          = false;
+  io(ADCSRA) |= ADSC;
+
+  // REFS2:0 -- VCC, AREF (PB0), 1.1 V, 2.56 V
+  unsigned refs = (io(ADMUX) >> 6 & 3) | (io(ADMUX) >> 2 & 4);
+  double   vref = refs & 2 ? (refs & 4 ? 2.56 : 1.1) : refs & 1 ? pinV[0] : vcc;
+
+  unsigned mux = io(ADMUX) & 0x0F;
+  double   vin = 0;
+  if (mux < 4)
+  {
+    int pin = AdcPins[mux];
+    vin     = io(DDRB) >> pin & 1 ? (portLevels() >> pin & 1 ? vcc : 0)
+                                  : pinV[pin];
+  }
+  else if (mux == 12)
+    vin = 1.1; // VBG
+  else if (mux == 15)
+  {
+    adcResult = 300; // temperature sensor at 25 C (typical)
+    return;
+  }
+
+  double code = vref > 0 ? vin / vref * 1024 : 1023;
+  adcResult   = code < 0 ? 0 : code > 1023 ? 1023 : unsigned(code);
+}
+
+// count down the conversion; on completion store the result (ADLAR adjusted)
+// and set ADIF, and restart when free running
+void AvrCore::adcClock()
+{
+  using namespace AvrIo;
+
+  if (adcCycles > cycles)
+  {
+    adcCycles -= cycles;
+    return;
+  }
+  adcCycles = 0;
+
+  if (io(ADMUX) & 0x20)
+  {
+    io(ADCH) = uint8_t(adcResult >> 2);
+    io(ADCL) = uint8_t(adcResult << 6);
+  }
+  else
+  {
+    io(ADCH) = uint8_t(adcResult >> 8);
+    io(ADCL) = uint8_t(adcResult);
+  }
+  io(ADCSRA) = (io(ADCSRA) & ~ADSC) | ADIF;
+
+  if (io(ADCSRA) & ADATE && !(io(ADCSRB) & 7)) adcStart();
+}
+
+// EECR:  EERE reads EEDR at once; EEPE (with EEMPE set) writes it at once, so
+// EEPE always reads back clear
+void AvrCore::eepromAccess(uint8_t v)
+{
+  using namespace AvrIo;
+
+  unsigned addr = (io(EEARL) | io(EEARH) << 8) & (EepromSize - 1);
+  if (v & 0x01) io(EEDR) = eeprom[addr];
+  if (v & 0x02 && io(EECR) & 0x04)
+  {
+    unsigned mode = v >> 4 & 3; // EEPM:  erase & write, erase, write
+    if (mode == 0) eeprom[addr] = io(EEDR);
+    if (mode == 1) eeprom[addr] = 0xFF;
+    if (mode == 2) eeprom[addr] &= io(EEDR);
+  }
+  io(EECR) = v & (v & 0x02 ? 0x38 : 0x3C); // a write spends EEMPE
+}
+
+int AvrCore::findPin(const char* pinName)
+{
+  if (pinName[0] != 'P' || pinName[1] != 'B' || pinName[2] < '0' ||
+      pinName[2] >= '0' + NbrPins || pinName[3])
+    return -1;
+  return pinName[2] - '0';
+}
+
+// pin state as MDB reports it:  output pins at the port (or compare output)
+// level, inputs with the digital input disabled at their voltage, digital
+// inputs at their logic level
+void AvrCore::getPin(int pin, PinState& pinState)
+{
+  using namespace AvrIo;
+
+  bool analog      = io(DIDR0) >> pin & 1;
+  bool input       = !(io(DDRB) >> pin & 1);
+  pinState.daState = analog ? PIN_ANALOG : PIN_DIGITAL;
+  pinState.ioState = input ? PIN_INPUT : PIN_OUTPUT;
+  if (!input)
+    pinState.voltage = portLevels() >> pin & 1 ? vcc : 0;
+  else if (analog)
+    pinState.voltage = pinV[pin];
+  else
+    pinState.voltage = pinHigh >> pin & 1 ? vcc : 0;
+}
+
+void AvrCore::setPin(int pin, double voltage)
+{
+  pinV[pin] = voltage;
+  if (voltage > vcc / 2)
+    pinHigh |= 1 << pin;
+  else
+    pinHigh &= ~(1 << pin);
+}
+
+bool AvrCore::setSupply(const char* pinName, double voltage)
+{
+  if (strcmp(pinName, "VCC")) return false;
+  vcc = voltage;
+  for (int pin = 0; pin < NbrPins; pin++) setPin(pin, pinV[pin]);
+  return true;
+}
+
+void AvrCore::saveState(std::vector<uint8_t>& state)
+{
+  const uint8_t* p = (const uint8_t*)static_cast<AvrState*>(this);
+  state.assign(p, p + sizeof(AvrState));
+}
+
+void AvrCore::restoreState(const std::vector<uint8_t>& state)
+{
+  if (state.size() != sizeof(AvrState)) return;
+  memcpy(static_cast<AvrState*>(this), state.data(), sizeof(AvrState));
+}
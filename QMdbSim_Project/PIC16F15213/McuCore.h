@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * McuCore is the interface to the in-process instruction-set simulators
+ * (ISS), an alternative to MDB for devices with a native core.  A core runs
+ * the same program file (ELF or Intel HEX) that MDB would, models the CPU,
+ * memory, pin registers, and a few basic peripherals, and steps an instruction
+ * in nanoseconds rather than an MDB round trip.  Peripherals that a core
+ * doesn't model need the MDB backend (see MdbSim::setNativeCore()).
+ *
+ * McuCore::create() returns the core for a device name or NULL if there isn't
+ * one.  Cores:
+ *
+ *   Pic16Core.cpp -- PIC16F15213 (PIC16 enhanced mid-range)
+ *   AvrCore.cpp   -- ATtiny85 (AVR25)
+ */
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct PinState;
+
+// in-process MCU core interface
+class McuCore
+{
+public:
+  virtual ~McuCore() {}
+
+  // load a program file (ELF or Intel HEX) and reset
+  virtual bool load(const char* pgmPath) = 0;
+
+  // power-on reset of the core; the pin input voltages are kept
+  virtual void reset() = 0;
+
+  // execute one instruction (an interrupt vector counts as one)
+  virtual void step() = 0;
+
+  // pin index by name (-1 if none)
+  virtual int findPin(const char* pinName) = 0;
+
+  // pin state & input pin voltage by index
+  virtual void getPin(int pin, PinState& pinState) = 0;
+  virtual void setPin(int pin, double voltage)     = 0;
+
+  // set the supply voltage if pinName is the supply pin (e.g., "VDD")
+  virtual bool setSupply(const char* pinName, double voltage) = 0;
+
+  // save & restore the complete core state -- CPU, memory, peripherals, and
+  // pin inputs, but not the program -- for MdbSim::checkpoint()/rollback().
+  // the state is a plain copy of a few KB.
+  virtual void saveState(std::vector<uint8_t>& state)          = 0;
+  virtual void restoreState(const std::vector<uint8_t>& state) = 0;
+
+  // what failed (for MdbSim error messages)
+  inline const char* getErrContext() { return errContext; }
+
+  // core for the device (NULL if none)
+  static std::unique_ptr<McuCore> create(const char* deviceName);
+
+  // a loaded program segment at the file's address (ELF p_paddr or HEX
+  // address; word or byte units per toolchain)
+  struct Segment
+  {
+    uint32_t             addr;
+    std::vector<uint8_t> bytes;
+  };
+
+protected:
+  const char* errContext = "";
+
+  // read the program segments from an ELF (elfMachine) or Intel HEX file;
+  // isElf tells which addressing applies
+  bool loadSegments(const char* pgmPath, uint16_t elfMachine,
+      std::vector<Segment>& segments, bool& isElf);
+};
+
+// core factories (NULL if the device isn't supported)
+McuCore* newPic16Core(const char* deviceName);
+McuCore* newAvrCore(const char* deviceName);
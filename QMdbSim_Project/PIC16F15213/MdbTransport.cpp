@@ -0,0 +1,370 @@
+//------------------------------------------------------------------------------
+// This file is part of the QMdbSim project, a Microchip Simulator framework for
+// QSpice C-Block components.  See the GitHub repository at
+// https://github.com/robdunn4/QSpice/ for the complete project, current
+// sources, documentation, and demonstration code.
+//------------------------------------------------------------------------------
+/* Notes:
+ *
+ * Win32 and POSIX implementations of MdbTransport.  If you want to create a
+ * new Microchip device, you should not need to modify this code.
+ */
+
+#include "MdbTransport.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <Windows.h>
+
+/*
+ * Win32 transport -- CreatePipe()/CreateProcess()
+ */
+class Win32Transport : public MdbTransport
+{
+public:
+  ~Win32Transport() { close(); }
+
+  bool start(const char* mdbPath) override
+  {
+    return createPipes() && createMdbProcess(mdbPath);
+  }
+
+  bool write(const char* buf, size_t len) override
+  {
+    DWORD dwWritten;
+    if (!WriteFile(mdbStdIn_Wr, buf, DWORD(len), &dwWritten, NULL))
+    {
+      errContext = "sendBuffer(WriteFile)";
+      return false;
+    }
+    return true;
+  }
+
+  bool read(char* buf, size_t size, size_t& nbrRead) override
+  {
+    DWORD dwRead;
+    if (!ReadFile(mdbStdOut_Rd, buf, DWORD(size), &dwRead, NULL))
+    {
+      errContext = "recvBuffer (ReadFile)";
+      return false;
+    }
+    nbrRead = dwRead;
+    return true;
+  }
+
+  void close() override
+  {
+    if (mdbStdIn_Wr) CloseHandle(mdbStdIn_Wr);
+    if (mdbStdOut_Rd) CloseHandle(mdbStdOut_Rd);
+    if (mdbStdErr_Rd) CloseHandle(mdbStdErr_Rd);
+    mdbStdIn_Wr = mdbStdOut_Rd = mdbStdErr_Rd = nullptr;
+  }
+
+protected:
+  HANDLE mdbStdIn_Rd  = nullptr;
+  HANDLE mdbStdIn_Wr  = nullptr;
+  HANDLE mdbStdOut_Rd = nullptr;
+  HANDLE mdbStdOut_Wr = nullptr;
+  HANDLE mdbStdErr_Rd = nullptr;
+  HANDLE mdbStdErr_Wr = nullptr;
+
+  bool createPipes();
+  bool createMdbProcess(const char* mdbPath);
+};
+
+// create pipes for STDIN, STDOUT, and STDEERR
+bool Win32Transport::createPipes()
+{
+  SECURITY_ATTRIBUTES saAttr;
+
+  // Set the bInheritHandle flag so pipe handles are inherited.
+  saAttr.nLength              = sizeof(SECURITY_ATTRIBUTES);
+  saAttr.bInheritHandle       = TRUE;
+  saAttr.lpSecurityDescriptor = NULL;
+
+  // Create a pipe for the child process's STDOUT.
+  if (!CreatePipe(&mdbStdOut_Rd, &mdbStdOut_Wr, &saAttr, 0))
+  {
+    errContext = "StdoutRd CreatePipe";
+    return false;
+  }
+
+  // Ensure the read handle to the pipe for STDOUT is not inherited.
+  if (!SetHandleInformation(mdbStdOut_Rd, HANDLE_FLAG_INHERIT, 0))
+  {
+    errContext = "Stdout SetHandleInformation";
+    return false;
+  }
+
+  //  Create a pipe for the child process's STDERR.
+  if (!CreatePipe(&mdbStdErr_Rd, &mdbStdErr_Wr, &saAttr, 0))
+  {
+    errContext = "StderrRd CreatePipe";
+    return false;
+  }
+
+  // Ensure the read handle to the pipe for STDERR is not inherited.
+  if (!SetHandleInformation(mdbStdErr_Rd, HANDLE_FLAG_INHERIT, 0))
+  {
+    errContext = "Stderr SetHandleInformation";
+    return false;
+  }
+
+  // Create a pipe for the child process's STDIN.
+  if (!CreatePipe(&mdbStdIn_Rd, &mdbStdIn_Wr, &saAttr, 0))
+  {
+    errContext = "Stdin CreatePipe";
+    return false;
+  }
+
+  // Ensure the write handle to the pipe for STDIN is not inherited.
+  if (!SetHandleInformation(mdbStdIn_Wr, HANDLE_FLAG_INHERIT, 0))
+  {
+    errContext = "Stdin SetHandleInformation";
+    return false;
+  }
+
+  return true;
+}
+
+// launch MDB process
+bool Win32Transport::createMdbProcess(const char* mdbPath)
+{
+  PROCESS_INFORMATION piProcInfo;
+  STARTUPINFO         siStartInfo;
+  BOOL                bSuccess = FALSE;
+
+  // Set up members of the PROCESS_INFORMATION structure.
+  ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+
+  // Set up members of the STARTUPINFO structure.
+  // This structure specifies the STDIN, STDOUT, & STDERR handles for
+  // redirection.
+  ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
+  siStartInfo.cb = sizeof(STARTUPINFO);
+
+  // siStartInfo.hStdError  = mdbStdErr_Wr; // set MDB STDERR to STDERR input
+  siStartInfo.hStdError  = mdbStdOut_Wr; // set MDB STDERR to STDOUT input
+  siStartInfo.hStdOutput = mdbStdOut_Wr; // set MDB STDOUT to STDOUT input
+  siStartInfo.hStdInput  = mdbStdIn_Rd;  // set MDB STDIN to STDIN output
+  siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+  // Create the MDB child process.
+  bSuccess = CreateProcess(mdbPath, // command line
+      NULL,                         // arguments
+      NULL,                         // process security attributes
+      NULL,                         // primary thread security attributes
+      TRUE,                         // handles are inherited
+      0,                            // creation flags
+      NULL,                         // use parent's environment
+      NULL,                         // use parent's current directory
+      &siStartInfo,                 // STARTUPINFO pointer
+      &piProcInfo);                 // receives PROCESS_INFORMATION
+
+  // if an error occurs, set error and return failure
+  if (!bSuccess)
+  {
+    errContext = "CreateMdbProcess";
+    return false;
+  }
+
+  // Close handles to the child process and its primary thread.
+  // Some applications might keep these handles to monitor the status
+  // of the child process, for example.
+  CloseHandle(piProcInfo.hProcess);
+  CloseHandle(piProcInfo.hThread);
+
+  // Close handles to the stdin and stdout pipes no longer needed by the child
+  // process. If they are not explicitly closed, there is no way to recognize
+  // that the child process has ended.
+  CloseHandle(mdbStdErr_Wr);
+  CloseHandle(mdbStdOut_Wr);
+  CloseHandle(mdbStdIn_Rd);
+  mdbStdErr_Wr = mdbStdOut_Wr = mdbStdIn_Rd = nullptr;
+
+  return true;
+}
+
+std::unique_ptr<MdbTransport> MdbTransport::create()
+{
+  return std::unique_ptr<MdbTransport>(new Win32Transport);
+}
+
+std::string MdbTransport::systemError()
+{
+  LPVOID lpMsgBuf;
+  DWORD  dw = GetLastError();
+
+  // if no system error, return empty string
+  if (!dw) return std::string();
+
+  FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+                    FORMAT_MESSAGE_IGNORE_INSERTS,
+      NULL, dw, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPTSTR) &lpMsgBuf,
+      0, NULL);
+
+  // remove trailing whitespace
+  char* buf = (char*) lpMsgBuf;
+  for (int i = strlen(buf) - 1; i >= 0 && ::isspace(buf[i]); i--) buf[i] = 0;
+  std::string msg = buf;
+
+  LocalFree(lpMsgBuf);
+  return msg;
+}
+
+#else // POSIX
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <signal.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+
+/*
+ * POSIX transport -- pipe()/fork()/exec()
+ */
+class PosixTransport : public MdbTransport
+{
+public:
+  ~PosixTransport() { close(); }
+
+  bool start(const char* mdbPath) override;
+
+  bool write(const char* buf, size_t len) override
+  {
+    while (len)
+    {
+      ssize_t n = ::write(mdbStdIn, buf, len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0)
+      {
+        errContext = "sendBuffer(write)";
+        return false;
+      }
+      buf += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool read(char* buf, size_t size, size_t& nbrRead) override
+  {
+    ssize_t n;
+    do n = ::read(mdbStdOut, buf, size);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+    {
+      errContext = "recvBuffer (read)";
+      return false;
+    }
+    nbrRead = size_t(n);
+    return true;
+  }
+
+  void close() override
+  {
+    if (mdbStdIn >= 0) ::close(mdbStdIn);
+    if (mdbStdOut >= 0) ::close(mdbStdOut);
+    mdbStdIn = mdbStdOut = -1;
+
+    // reap MDB (it exits on quit or stdin EOF)
+    if (mdbPid > 0) waitpid(mdbPid, NULL, 0);
+    mdbPid = -1;
+  }
+
+protected:
+  int   mdbStdIn  = -1; // write end of MDB stdin
+  int   mdbStdOut = -1; // read end of MDB stdout/stderr
+  pid_t mdbPid    = -1;
+};
+
+bool PosixTransport::start(const char* mdbPath)
+{
+  int inPipe[2], outPipe[2];
+
+  // a dead MDB should fail writes, not kill the process
+  signal(SIGPIPE, SIG_IGN);
+
+  if (pipe(inPipe))
+  {
+    errContext = "Stdin pipe";
+    return false;
+  }
+  if (pipe(outPipe))
+  {
+    errContext = "Stdout pipe";
+    return false;
+  }
+
+  // exec status pipe -- closed by a successful exec, else gets the child's
+  // errno (so a bad MDB path fails here, as CreateProcess() does)
+  int execPipe[2];
+  if (pipe(execPipe))
+  {
+    errContext = "CreateMdbProcess(pipe)";
+    return false;
+  }
+  fcntl(execPipe[1], F_SETFD, FD_CLOEXEC);
+
+  mdbPid = fork();
+  if (mdbPid < 0)
+  {
+    errContext = "CreateMdbProcess(fork)";
+    return false;
+  }
+
+  // child:  stdin from inPipe, stdout & stderr to outPipe, then run MDB
+  if (!mdbPid)
+  {
+    dup2(inPipe[0], 0);
+    dup2(outPipe[1], 1);
+    dup2(outPipe[1], 2);
+    ::close(inPipe[0]);
+    ::close(inPipe[1]);
+    ::close(outPipe[0]);
+    ::close(outPipe[1]);
+    ::close(execPipe[0]);
+    execl(mdbPath, mdbPath, (char*) NULL);
+    int err = errno;
+    (void) !::write(execPipe[1], &err, sizeof(err));
+    _exit(127);
+  }
+
+  // parent:  close the child's ends; keep ours out of later children
+  ::close(inPipe[0]);
+  ::close(outPipe[1]);
+  ::close(execPipe[1]);
+  mdbStdIn  = inPipe[1];
+  mdbStdOut = outPipe[0];
+  fcntl(mdbStdIn, F_SETFD, FD_CLOEXEC);
+  fcntl(mdbStdOut, F_SETFD, FD_CLOEXEC);
+
+  int     err;
+  ssize_t n;
+  do n = ::read(execPipe[0], &err, sizeof(err));
+  while (n < 0 && errno == EINTR);
+  ::close(execPipe[0]);
+  if (n == sizeof(err))
+  {
+    close();
+    errno      = err;
+    errContext = "CreateMdbProcess(exec)";
+    return false;
+  }
+
+  return true;
+}
+
+std::unique_ptr<MdbTransport> MdbTransport::create()
+{
+  return std::unique_ptr<MdbTransport>(new PosixTransport);
+}
+
+std::string MdbTransport::systemError()
+{
+  if (!errno) return std::string();
+  return strerror(errno);
+}
+
+#endif
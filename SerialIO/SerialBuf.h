@@ -2,22 +2,195 @@
 #define SerialBuf_H
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-class SerialOutBuffer8 {
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <strings.h>
+#include <unistd.h>
+#define _stricmp  strcasecmp
+#define _strnicmp strncasecmp
+#endif
+
+// pattern source types
+enum SerialPattern { PAT_PRBS7, PAT_PRBS15, PAT_PRBS23, PAT_PRBS31,
+  PAT_COUNTER, PAT_FILE };
+
+/*------------------------------------------------------------------------------
+ * SerialLfsr -- PRBS generator for the ITU-T O.150 style polynomials x^n +
+ * x^m + 1 (PRBS7 = x^7+x^6+1, PRBS15 = x^15+x^14+1, PRBS23 = x^23+x^18+1,
+ * PRBS31 = x^31+x^28+1).
+ *
+ * Each new bit is b[i] = b[i-n] ^ b[i-m], so the next m bits depend only on
+ * bits already in the n-bit state register and can be made with one shift &
+ * XOR.  That's 6-28 bits per step rather than one.
+ *----------------------------------------------------------------------------*/
+class SerialLfsr {
+public:
+  void init(int order) {
+    switch (order) {
+    case 7: n = 7, m = 6; break;
+    case 15: n = 15, m = 14; break;
+    case 23: n = 23, m = 18; break;
+    default: n = 31, m = 28; break;
+    }
+    state = (uint32_t(1) << n) - 1;   // any non-zero seed will do
+  }
+
+  // next bits (<= 32) of the sequence, first bit in the MSb
+  uint32_t next(int bits) {
+    uint64_t word = 0;
+    while (bits > 0) {
+      int      k     = bits < m ? bits : m;
+      uint32_t chunk = ((state >> (n - k)) ^ (state >> (m - k))) & mask(k);
+      state          = ((state << k) | chunk) & mask(n);
+      word           = (word << k) | chunk;
+      bits -= k;
+    }
+    return uint32_t(word);
+  }
+
+protected:
+  static inline uint32_t mask(int bits) {
+    return uint32_t((uint64_t(1) << bits) - 1);
+  }
+
+  int      n = 31, m = 28;   // polynomial orders
+  uint32_t state = 1;        // last n bits, newest in bit 0
+};
+
+/*------------------------------------------------------------------------------
+ * SerialFileMap -- read-only memory-mapped binary file.  The file is sent as
+ * a bit stream, MSb of each byte first, and wraps at the end so it can be
+ * repeated for as long as the simulation runs.
+ *----------------------------------------------------------------------------*/
+class SerialFileMap {
+public:
+  ~SerialFileMap() { close(); }
+
+  bool open(const char *path) {
+    close();
+#ifdef _WIN32
+    hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0) {
+      hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (hMap)
+        data = (const uint8_t *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+      size = size_t(fileSize.QuadPart);
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (!fstat(fd, &st) && st.st_size > 0) {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) data = (const uint8_t *)p, size = st.st_size;
+    }
+    ::close(fd);
+#endif
+    if (!data) close();
+    return data != nullptr;
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (hMap) CloseHandle(hMap);
+    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+    hMap  = NULL;
+    hFile = INVALID_HANDLE_VALUE;
+#else
+    if (data) munmap((void *)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+    pos  = 0;
+  }
+
+  inline size_t fileSize() const { return size; }
+
+  // next bits (<= 32) of the file, first bit in the MSb
+  uint32_t next(int bits) {
+    uint64_t word = 0;
+    while (bits > 0) {
+      if (!avail) {   // next byte, wrapping at end of file
+        cur   = data ? data[pos] : 0;
+        avail = 8;
+        if (++pos >= size) pos = 0;
+      }
+      int k = bits < avail ? bits : avail;
+      word  = (word << k) | ((cur >> (avail - k)) & ((1u << k) - 1));
+      avail -= k;
+      bits -= k;
+    }
+    return uint32_t(word);
+  }
+
+protected:
+#ifdef _WIN32
+  HANDLE hFile = INVALID_HANDLE_VALUE;
+  HANDLE hMap  = NULL;
+#endif
+  const uint8_t *data  = nullptr;
+  size_t         size  = 0;
+  size_t         pos   = 0;   // next byte
+  uint8_t        cur   = 0;   // current byte
+  int            avail = 0;   // bits left in current byte
+};
+
+/*------------------------------------------------------------------------------
+ * SerialOutStream -- streaming serial output.  Frames of 1-32 bits are shifted
+ * out MSb first from a pattern source (PRBS, memory-mapped file, or a frame
+ * counter).  The next frame is loaded as soon as the last bit of the current
+ * frame is sent so the stream can run for millions of bits.
+ *----------------------------------------------------------------------------*/
+class SerialOutStream {
 public:
-  // set buffer value
-  void serialStart(uint8_t val) {
-    buf       = val;
-    bitCnt    = 0;
-    underflow = false;
+  // set up the pattern source.  pattern is PRBS7, PRBS15, PRBS23, PRBS31,
+  // COUNTER, or a binary file path.  returns false for an unknown PRBS (PRBS31
+  // is used) or if the file can't be opened.
+  bool init(const char *pattern, int bits) {
+    frameBits = bits < 1 ? 8 : bits > 32 ? 32 : bits;
+    if (!pattern || !*pattern) pattern = "PRBS7";
+
+    if (!_strnicmp(pattern, "PRBS", 4)) {
+      int order = atoi(pattern + 4);
+      type      = order == 7    ? PAT_PRBS7
+                  : order == 15 ? PAT_PRBS15
+                  : order == 23 ? PAT_PRBS23
+                                : PAT_PRBS31;
+      lfsr.init(order);
+      return order == 7 || order == 15 || order == 23 || order == 31;
+    }
+    if (!_stricmp(pattern, "COUNTER")) {
+      type = PAT_COUNTER;
+      return true;
+    }
+    type = PAT_FILE;
+    return file.open(pattern);
+  }
+
+  // start a new frame
+  void serialStart() {
+    buf    = nextFrame();
+    bitCnt = 0;
   }
 
-  // get next buffer bit
+  // get next bit, loading the next frame after the last bit of this one
   bool serialOut() {
-    if (underflow) return false;
-    bool outBit = buf & 0x80;
+    bool outBit = (buf >> (frameBits - 1)) & 1;
     buf <<= 1;
-    underflow |= ++bitCnt > bufBits;
+    bitsSent++;
+    if (++bitCnt >= frameBits) serialStart();
     return outBit;
   }
 
@@ -25,14 +198,29 @@ public:
   void serialEnd() { /* nothing to do? */
   }
 
-  // may be useful later
-  bool isUnderflow() { return underflow; }
+  inline uint64_t getBitsSent() const { return bitsSent; }
+  inline int      getFrameBits() const { return frameBits; }
+  inline int      getType() const { return type; }
 
 protected:
-  const uint8_t bufBits   = 8;
-  uint8_t       buf       = 0;
-  uint8_t       bitCnt    = 0;
-  bool          underflow = true;
+  uint32_t nextFrame() {
+    switch (type) {
+    case PAT_COUNTER:
+      return uint32_t(counter++) &
+             uint32_t((uint64_t(1) << frameBits) - 1);
+    case PAT_FILE: return file.next(frameBits);
+    default: return lfsr.next(frameBits);
+    }
+  }
+
+  SerialLfsr    lfsr;
+  SerialFileMap file;
+  int           type      = PAT_PRBS7;
+  int           frameBits = 8;
+  uint32_t      buf       = 0;
+  int           bitCnt    = 0;
+  uint64_t      counter   = 0;
+  uint64_t      bitsSent  = 0;
 };
 
 #if 0
@@ -12,7 +12,7 @@
 
 // versioning
 #define PROGRAM_NAME    "SerialOut"
-#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_VERSION "v0.2"
 #define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
 
 union uData {
@@ -67,23 +67,21 @@ void msg(int lineNbr, const char *fmt, ...) {
 #define EDGE_RISING  true
 
 struct InstData {
-  bool             lastClk = LOW;
-  bool             lastEn  = HIGH;
-  bool             lastDSO = LOW;
-  int              testCtr = 0;
-  SerialOutBuffer8 sBuf;
+  bool            lastClk = LOW;
+  bool            lastEn  = HIGH;
+  bool            lastDSO = LOW;
+  SerialOutStream sBuf;
 };
 
-unsigned int testData[] = {
-    0x88, 0x11, 0x55, 0xaa, 0xde, 0xad, 0xbe, 0xef, 0x00};
-
 extern "C" __declspec(dllexport) void serialout(
     InstData **opaque, double t, uData *data) {
-  double  CLK  = data[0].d;   // input
-  double  CS   = data[1].d;   // input
-  double  VCC  = data[2].d;   // input
-  double  TEST = data[3].d;   // input
-  double &DSO  = data[4].d;   // output
+  double      CLK       = data[0].d;     // input
+  double      CS        = data[1].d;     // input
+  double      VCC       = data[2].d;     // input
+  double      TEST      = data[3].d;     // input
+  const char *PATTERN   = data[4].str;   // attribute
+  int         FRAMEBITS = data[5].i;     // attribute
+  double     &DSO       = data[6].d;     // output
 
   InstData *inst = *opaque;
 
@@ -93,15 +91,21 @@ extern "C" __declspec(dllexport) void serialout(
       msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
       std::terminate();
     }
+
+    if (!inst->sBuf.init(PATTERN, FRAMEBITS))
+      msg(__LINE__, "Pattern=\"%s\" is not valid or can't be opened.\n",
+          PATTERN);
+    msg(__LINE__, "Pattern=\"%s\", FrameBits=%d.\n",
+        PATTERN && *PATTERN ? PATTERN : "PRBS7", inst->sBuf.getFrameBits());
   }
 
   /*------------------------------------------------------------------------------
    * Process:
    * (1) Wait for CS to go low.
    * (2) If already low and goes high, stop output.
-   * (3) Latch test voltage on first enable (this is our test data).
+   * (3) Start a new frame from the pattern source on each enable.
    * (4) Write one bit on each falling clock edge.
-   * (5) When buffer is empty, output low.
+   * (5) When the frame is done, continue with the next frame.
    *----------------------------------------------------------------------------*/
 
   const bool enableState  = LOW;            // active low
@@ -124,9 +128,7 @@ extern "C" __declspec(dllexport) void serialout(
 
   if (enabled != inst->lastEn) {
     inst->lastEn = enabled;
-    // latch test data -- we'll use the testData defined above
-    inst->sBuf.serialStart(testData[inst->testCtr]);
-    if (inst->testCtr < sizeof(testData) / sizeof(testData[0])) inst->testCtr++;
+    inst->sBuf.serialStart();
   }
 
   // clock data out on configured edge of clock
@@ -142,6 +144,8 @@ extern "C" __declspec(dllexport) void serialout(
 }
 
 extern "C" __declspec(dllexport) void Destroy(struct InstData *inst) {
+  if (inst) msg(__LINE__, "%llu bits sent.\n", inst->sBuf.getBitsSent());
+
   //   free(inst);
   delete inst;
 }
@@ -0,0 +1,219 @@
+/*==============================================================================
+ * UartIO.h -- UART code common to transmitter & receiver devices (frame
+ * format, bit clock scheduling & data FIFO).
+ *============================================================================*/
+
+#ifndef UARTIO_H
+#define UARTIO_H
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include "PinIO.h"
+#include "SpiIO.h"
+
+void msg(int lineNbr, const char *fmt, ...);   // fwd decl for debugging
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const double       eternity        = 1.7e308;   // end of the 'verse
+const unsigned int UartBaudDef     = 9600;      // default baud rate
+const unsigned int UartDataBitsDef = 8;         // default data bits
+const unsigned int UartStopBitsDef = 2;   // default stop (half-bits) = 1 bit
+
+/*------------------------------------------------------------------------------
+ * Parity selection.  The attribute values are 0=none, 1=odd, 2=even.  (Note
+ * the "PAR_" prefix -- PinIO.h already claims NONE.)
+ *----------------------------------------------------------------------------*/
+enum UartParity { PAR_NONE, PAR_ODD, PAR_EVEN };
+
+/*------------------------------------------------------------------------------
+ * UartConfig -- frame format & baud rate.  Stop bits are kept in half-bit
+ * units so that 1.5 stop bits can be scheduled exactly.
+ *----------------------------------------------------------------------------*/
+struct UartConfig {
+  unsigned int baud         = UartBaudDef;
+  uint8_t      dataBits     = UartDataBitsDef;
+  UartParity   parity       = PAR_NONE;
+  uint8_t      stopHalfBits = UartStopBitsDef;   // 2, 3, or 4
+
+  // validate the component attributes; invalid values are replaced with the
+  // defaults (and a message)
+  void init(int baudAttr, int dataBitsAttr, int parityAttr, double stopAttr) {
+    if (baudAttr < 1) {
+      msg(__LINE__, "Baud=%d is not valid.  Using default baud=%d.\n",
+          baudAttr, UartBaudDef);
+      baudAttr = UartBaudDef;
+    }
+    baud = baudAttr;
+
+    if (dataBitsAttr < 5 || dataBitsAttr > 9) {
+      msg(__LINE__,
+          "DataBits=%d is not valid.  Valid values are 5-9.  Using default "
+          "DataBits=%d.\n",
+          dataBitsAttr, UartDataBitsDef);
+      dataBitsAttr = UartDataBitsDef;
+    }
+    dataBits = dataBitsAttr;
+
+    if (parityAttr < PAR_NONE || parityAttr > PAR_EVEN) {
+      msg(__LINE__,
+          "Parity=%d is not valid.  Valid values are 0 (none), 1 (odd), 2 "
+          "(even).  Using no parity.\n",
+          parityAttr);
+      parityAttr = PAR_NONE;
+    }
+    parity = UartParity(parityAttr);
+
+    int halfBits = int(stopAttr * 2.0 + 0.5);
+    if (halfBits < 2 || halfBits > 4) {
+      msg(__LINE__,
+          "StopBits=%g is not valid.  Valid values are 1, 1.5, 2.  Using 1 "
+          "stop bit.\n",
+          stopAttr);
+      halfBits = UartStopBitsDef;
+    }
+    stopHalfBits = halfBits;
+  }
+
+  // # of stop bits in the frame word -- 1.5 stop bits sends two stop bits with
+  // the last one cut to a half-bit time
+  inline uint8_t stopBits() const { return (stopHalfBits + 1) / 2; }
+
+  // # of bits in the frame word (start + data + parity + stop)
+  inline uint8_t frameBits() const {
+    return 1 + dataBits + (parity != PAR_NONE) + stopBits();
+  }
+
+  // frame length in half-bit times
+  inline uint32_t frameHalfBits() const {
+    return 2 * (1 + dataBits + (parity != PAR_NONE)) + stopHalfBits;
+  }
+
+  inline double bitTime() const { return 1.0 / baud; }
+
+  // parity bit for the data bits of val
+  bool parityBit(uint32_t val) const {
+    bool odd = false;   // true if an odd number of data bits is set
+    for (uint8_t i = 0; i < dataBits; i++) odd ^= bool((val >> i) & 1);
+    return parity == PAR_EVEN ? odd : !odd;
+  }
+
+  // build the frame word for SerialBuffer::startIO().  SerialBuffer shifts
+  // out of the MSb, UARTs send the data LSb first, so the bits are packed in
+  // transmission order:  start (MSb), data (LSb first), parity, stop (LSb).
+  uint32_t buildFrame(uint32_t val) const {
+    uint32_t frame = 0;   // start bit
+    for (uint8_t i = 0; i < dataBits; i++)
+      frame = (frame << 1) | ((val >> i) & 1);
+    if (parity != PAR_NONE) frame = (frame << 1) | parityBit(val);
+    for (uint8_t i = 0; i < stopBits(); i++) frame = (frame << 1) | 1;
+    return frame;
+  }
+};
+
+/*------------------------------------------------------------------------------
+ * BitClock -- drift-free tick clock locked to a start time.  Tick times are
+ * calculated from the tick count (see CBlockBasics5 calcTickTime()) rather
+ * than accumulated so rounding errors don't build up over long transfers.
+ *----------------------------------------------------------------------------*/
+class BitClock {
+public:
+  void init(double ticksPerSec) {
+    tickFreq = ticksPerSec;
+    stop();
+  }
+
+  // lock tick 0 to simulation time t
+  void start(double t) {
+    t0      = t;
+    tick    = 0;
+    running = true;
+  }
+
+  void stop() { running = false; }
+
+  // advance the next scheduled event by ticks
+  void advance(uint32_t ticks) { tick += ticks; }
+
+  // schedule the next event at an absolute tick count
+  void setTick(uint64_t toTick) { tick = toTick; }
+
+  inline uint64_t getTick() const { return tick; }
+  inline bool     isRunning() const { return running; }
+  inline double   nextTime() const {
+    return running ? t0 + tick / tickFreq : eternity;
+  }
+
+protected:
+  double   tickFreq = 1.0;
+  double   t0       = 0.0;
+  uint64_t tick     = 0;
+  bool     running  = false;
+};
+
+/*------------------------------------------------------------------------------
+ * UartFifo -- fixed-size ring buffer of data words (bytes, or 9-bit words).
+ * The capacity must be a power of 2.
+ *----------------------------------------------------------------------------*/
+class UartFifo {
+public:
+  static const uint32_t capacity = 4096;
+
+  inline bool     isEmpty() const { return head == tail; }
+  inline bool     isFull() const { return count() == capacity; }
+  inline uint32_t count() const { return head - tail; }
+  inline uint32_t space() const { return capacity - count(); }
+
+  bool push(uint16_t val) {
+    if (isFull()) return false;
+    buf[head++ & (capacity - 1)] = val;
+    return true;
+  }
+
+  uint16_t pop() {
+    if (isEmpty()) return 0;
+    return buf[tail++ & (capacity - 1)];
+  }
+
+  // top up the FIFO from a binary file.  wide=true reads little-endian 16-bit
+  // words (for 9-bit data), otherwise bytes.  returns false at end of file.
+  bool fill(FILE *file, bool wide) {
+    if (!file) return false;
+    while (!isFull()) {
+      uint8_t b[2];
+      size_t  n = wide ? 2 : 1;
+      if (fread(b, 1, n, file) != n) return false;
+      push(wide ? uint16_t(b[0] | (b[1] << 8)) : b[0]);
+    }
+    return true;
+  }
+
+  // load hex words from a string, e.g., "55 AA 0D 0A".  returns # of words.
+  uint32_t fill(const char *hex) {
+    uint32_t words = 0;
+    while (hex && *hex && !isFull()) {
+      char         *end;
+      unsigned long val = strtoul(hex, &end, 16);
+      if (end == hex) {   // skip separators
+        hex++;
+        continue;
+      }
+      push(uint16_t(val));
+      words++;
+      hex = end;
+    }
+    return words;
+  }
+
+protected:
+  uint16_t buf[capacity];
+  uint32_t head = 0;
+  uint32_t tail = 0;
+};
+
+#endif   // UARTIO_H
+/*==============================================================================
+ * End of UartIO.h
+ *============================================================================*/
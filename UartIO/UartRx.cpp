@@ -0,0 +1,346 @@
+/*==============================================================================
+ * UartRx.cpp -- UART receiver device.
+ *============================================================================*/
+// Note:  Compile with MS VC
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <thread>
+
+#include "PinIO.h"
+#include "SpiIO.h"
+#include "UartIO.h"
+
+// versioning for messages
+#define PROGRAM_NAME    "UartRx"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+#define msleep(msecs)                                                          \
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs))
+
+void msg(int lineNbr, const char *fmt, ...) {
+  msleep(30);
+  fflush(stdout);
+  fprintf(stdout, PROGRAM_INFO " (@%d) ", lineNbr);
+  va_list args = {0};
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  fflush(stdout);
+  msleep(30);
+}
+
+/*------------------------------------------------------------------------------
+ * uData -- union overlay for passed port/attribute data.
+ *----------------------------------------------------------------------------*/
+union uData {
+  bool                   b;
+  char                   c;
+  unsigned char          uc;
+  short                  s;
+  unsigned short         us;
+  int                    i;
+  unsigned int           ui;
+  float                  f;
+  double                 d;
+  long long int          i64;
+  unsigned long long int ui64;
+  char                  *str;
+  unsigned char         *bytes;
+};
+
+// #undef pin names lest they collide with names in any header file(s) you might
+// include.  (Note:  Port/attribute changes may change this list.)
+#undef RX
+#undef VCC
+#undef RDY
+#undef ERR
+
+/*------------------------------------------------------------------------------
+ * Components may use the uData array of ports/attributes passed by QSpice in
+ * several places.  If the ports/attributes are changed, the array offsets
+ * change.  For convenience, I #define it here so that later changes to
+ * ports/attributes require code changes only here.
+ *----------------------------------------------------------------------------*/
+#define UDATA(data)                                                            \
+  double      RX         = data[0].d;                                          \
+  double      VCC        = data[1].d;                                          \
+  int         BAUD       = data[2].i;                                          \
+  int         DATABITS   = data[3].i;                                          \
+  int         PARITY     = data[4].i;                                          \
+  double      STOPBITS   = data[5].d;                                          \
+  int         OVERSAMPLE = data[6].i;                                          \
+  const char *LOGFILE    = data[7].str;                                        \
+  double     &RDY        = data[8].d;                                          \
+  double     &ERR        = data[9].d;
+
+/*------------------------------------------------------------------------------
+ * Per instance data structure.  Allocated in evalutation function.
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  PinIn          rxPinIn;               // RX pin
+  PinOut         rdyPinOut;             // word received
+  PinOut         errPinOut;             // parity/framing error on last word
+  UartConfig     cfg;                   // frame format & baud rate
+  BitClock       bitClk;                // sample tick clock
+  FILE          *logFile = nullptr;     // received data log (if any)
+  char          *logBuf  = nullptr;     // log file stream buffer
+  uint8_t        ticksPerBit;           // 2, or 16 if oversampling
+  uint8_t        nbrSamples;            // samples (votes) per bit
+  const uint8_t *sampleTicks;           // sample tick offsets within a bit
+  bool           receiving = false;     // true between start & stop bits
+  uint8_t        bitIdx    = 0;         // frame bit being sampled (0=start)
+  uint8_t        sampleIdx = 0;         // sample within the bit
+  uint8_t        votes     = 0;         // high samples for the bit
+  uint16_t       rxData    = 0;         // data bits received
+  bool           parityErr = false;     // parity error in current frame
+  double         startT    = 0;         // start bit edge time
+  double         lastT     = 0;         // last evaluation time
+  double         lastRX    = 0;         // RX voltage at last evaluation
+  double         incrT     = 0;         // time to next sample (last eval)
+};
+
+/*------------------------------------------------------------------------------
+ * Sample points as tick offsets within a bit.  Without oversampling, the tick
+ * clock runs at 2x baud and the single sample is mid-bit.  With 16x
+ * oversampling, the bit is majority-voted from the three middle samples like
+ * the classic 16550 UART -- only those three ticks force timesteps.
+ *----------------------------------------------------------------------------*/
+const uint8_t sampleTicks2x[]  = {1};
+const uint8_t sampleTicks16x[] = {7, 8, 9};
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const size_t RxLogBufSize = 65536;   // log file stream buffer size
+const double RxEdgeTolDiv = 1024;    // start edge step = bit time / this
+
+/*------------------------------------------------------------------------------
+ * Fwd decls
+ *----------------------------------------------------------------------------*/
+void scheduleSample(InstData &inst);
+bool processBit(InstData &inst, bool bit, uData *data);
+
+/*------------------------------------------------------------------------------
+ * uartrx() -- evaluation function called by QSpice.
+ *
+ * Idle until RX falls.  The start bit edge time is interpolated from the RX
+ * threshold crossing between the last and current evaluations (Trunc() keeps
+ * that step short) and the sample tick clock is locked to it.  The only forced
+ * timesteps are then the sample points.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void uartrx(
+    InstData **opaque, double t, uData *data) {
+  UDATA(data);
+
+  InstData *inst = *opaque;
+
+  if (!inst) {
+    // first time, VCC is 0.0V so delay until VCC is something valid...
+    if (VCC == 0.0) return;
+
+    *opaque = inst = new InstData();
+    if (!inst) {   // terminate with prejudice
+      msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
+      std::terminate();
+    }
+
+    // set up frame format & sampling from attributes
+    inst->cfg.init(BAUD, DATABITS, PARITY, STOPBITS);
+    if (OVERSAMPLE) {
+      inst->ticksPerBit = 16;
+      inst->sampleTicks = sampleTicks16x;
+      inst->nbrSamples  = sizeof(sampleTicks16x) / sizeof(sampleTicks16x[0]);
+    } else {
+      inst->ticksPerBit = 2;
+      inst->sampleTicks = sampleTicks2x;
+      inst->nbrSamples  = sizeof(sampleTicks2x) / sizeof(sampleTicks2x[0]);
+    }
+    inst->bitClk.init(double(inst->ticksPerBit) * inst->cfg.baud);
+
+    // open the log file; a large stream buffer keeps the writes cheap
+    if (LOGFILE && *LOGFILE) {
+      if ((inst->logFile = fopen(LOGFILE, "w"))) {
+        inst->logBuf = new char[RxLogBufSize];
+        setvbuf(inst->logFile, inst->logBuf, _IOFBF, RxLogBufSize);
+        fprintf(inst->logFile, "# time(s) data flags\n");
+      } else msg(__LINE__, "Unable to open LogFile=\"%s\".\n", LOGFILE);
+    }
+
+    // configure pins
+    inst->rxPinIn = PinIn(VCC, RX);
+    RDY = (inst->rdyPinOut = PinOut(VCC, PinState::LOW)).getStateV();
+    ERR = (inst->errPinOut = PinOut(VCC, PinState::LOW)).getStateV();
+    inst->lastT  = t;
+    inst->lastRX = RX;
+
+    // debug info
+    msg(__LINE__,
+        "Baud=%d, DataBits=%d, Parity=%d, StopBits=%g, Oversample=%d.\n",
+        inst->cfg.baud, inst->cfg.dataBits, inst->cfg.parity,
+        inst->cfg.stopHalfBits / 2.0, OVERSAMPLE ? 16 : 1);
+    return;
+  }
+
+  // set PinIn states from inputs
+  inst->rxPinIn.setState(RX);
+
+  RDY = inst->rdyPinOut.getStateV();
+  ERR = inst->errPinOut.getStateV();
+
+  // falling edge while idle is a start bit; lock the tick clock to the
+  // interpolated threshold crossing
+  if (!inst->receiving && inst->rxPinIn.isFalling()) {
+    double vTh   = VCC / 2.0;
+    double edgeT = t;
+    if (inst->lastRX != RX)
+      edgeT = inst->lastT + (t - inst->lastT) * (inst->lastRX - vTh) /
+          (inst->lastRX - RX);
+
+    inst->startT    = edgeT;
+    inst->receiving = true;
+    inst->bitIdx    = 0;
+    inst->sampleIdx = 0;
+    inst->votes     = 0;
+    inst->rxData    = 0;
+    inst->parityErr = false;
+    inst->bitClk.start(edgeT);
+    scheduleSample(*inst);
+
+    RDY = inst->rdyPinOut.setLow().getStateV();
+  }
+
+  inst->lastT  = t;
+  inst->lastRX = RX;
+
+  if (!inst->receiving) {
+    inst->incrT = eternity;
+    return;
+  }
+
+  // sample now?
+  if (t < inst->bitClk.nextTime()) {
+    inst->incrT = inst->bitClk.nextTime() - t;
+    return;
+  }
+
+  inst->votes += inst->rxPinIn.isHigh();
+  if (++inst->sampleIdx >= inst->nbrSamples) {
+    bool bit        = inst->votes * 2 > inst->nbrSamples;
+    inst->sampleIdx = 0;
+    inst->votes     = 0;
+    if (!processBit(*inst, bit, data)) {
+      // frame done (or false start) -- back to idle
+      inst->receiving = false;
+      inst->bitClk.stop();
+      inst->incrT = eternity;
+      return;
+    }
+    inst->bitIdx++;
+  }
+
+  scheduleSample(*inst);
+  inst->incrT = inst->bitClk.nextTime() - t;
+}
+
+/*------------------------------------------------------------------------------
+ * MaxExtStepSize() -- step to the next sample point
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) double MaxExtStepSize(InstData *inst) {
+  if (!inst || inst->incrT <= 0) return eternity;
+  return inst->incrT;
+}
+
+/*------------------------------------------------------------------------------
+ * Trunc() -- force simulation to trigger on sample points and, while idle,
+ * shorten the step in which RX crosses the threshold so that the start bit
+ * edge interpolation is accurate.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Trunc(
+    InstData *inst, double t, uData *data, double *timestep) {
+  UDATA(data);
+
+  if (!inst) return;
+
+  if (!inst->receiving) {
+    double ttol = inst->cfg.bitTime() / RxEdgeTolDiv;
+    if (inst->rxPinIn.isHigh() && RX <= VCC / 2.0 && *timestep > ttol)
+      *timestep = ttol;
+    return;
+  }
+
+  double nextT = inst->bitClk.nextTime();
+  if (t < nextT && *timestep > nextT - t) *timestep = nextT - t;
+}
+
+/*------------------------------------------------------------------------------
+ * scheduleSample() -- set the tick clock to the current bit/sample point.
+ *----------------------------------------------------------------------------*/
+void scheduleSample(InstData &inst) {
+  inst.bitClk.setTick(uint64_t(inst.bitIdx) * inst.ticksPerBit +
+      inst.sampleTicks[inst.sampleIdx]);
+}
+
+/*------------------------------------------------------------------------------
+ * processBit() -- handle a sampled bit.  Returns false when the frame is done
+ * (stop bit sampled) or the start bit was a glitch.
+ *----------------------------------------------------------------------------*/
+bool processBit(InstData &inst, bool bit, uData *data) {
+  UDATA(data);
+
+  const uint8_t dataBits  = inst.cfg.dataBits;
+  const uint8_t parityIdx = dataBits + 1;
+  const uint8_t stopIdx   = parityIdx + (inst.cfg.parity != PAR_NONE);
+
+  // start bit -- must still be low at mid-bit or it was a glitch
+  if (inst.bitIdx == 0) return !bit;
+
+  // data bits, LSb first
+  if (inst.bitIdx <= dataBits) {
+    inst.rxData |= uint16_t(bit) << (inst.bitIdx - 1);
+    return true;
+  }
+
+  // parity bit
+  if (inst.bitIdx < stopIdx) {
+    inst.parityErr = bit != inst.cfg.parityBit(inst.rxData);
+    return true;
+  }
+
+  // first stop bit -- frame is done.  (A receiver doesn't need to wait out
+  // extra stop bits; the next start edge can't come any sooner.)
+  bool framingErr = !bit;
+
+  RDY = inst.rdyPinOut.setHigh().getStateV();
+  ERR = inst.errPinOut.setState(inst.parityErr || framingErr).getStateV();
+
+  if (inst.logFile)
+    fprintf(inst.logFile, "%.12e 0x%03X%s%s\n", inst.startT, inst.rxData,
+        inst.parityErr ? " PE" : "", framingErr ? " FE" : "");
+
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy() -- called by QSpice when simulation ends.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(struct InstData *inst) {
+  if (inst && inst->logFile) fclose(inst->logFile);   // flushes the buffer
+  if (inst) delete[] inst->logBuf;
+
+  // delete per-instance data allocated in the evaluation function
+  delete inst;
+}
+
+/*------------------------------------------------------------------------------
+ * int DllMain() must exist and return 1 for a process to load the .DLL
+ * See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more
+ * information.
+ *----------------------------------------------------------------------------*/
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) {
+  return 1;
+}
+/*==============================================================================
+ * End of UartRx.cpp
+ *============================================================================*/
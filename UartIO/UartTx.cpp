@@ -0,0 +1,238 @@
+/*==============================================================================
+ * UartTx.cpp -- UART transmitter device.
+ *============================================================================*/
+// Note:  Compile with MS VC
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <thread>
+
+#include "PinIO.h"
+#include "SpiIO.h"
+#include "UartIO.h"
+
+// versioning for messages
+#define PROGRAM_NAME    "UartTx"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+#define msleep(msecs)                                                          \
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs))
+
+void msg(int lineNbr, const char *fmt, ...) {
+  msleep(30);
+  fflush(stdout);
+  fprintf(stdout, PROGRAM_INFO " (@%d) ", lineNbr);
+  va_list args = {0};
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  fflush(stdout);
+  msleep(30);
+}
+
+/*------------------------------------------------------------------------------
+ * uData -- union overlay for passed port/attribute data.
+ *----------------------------------------------------------------------------*/
+union uData {
+  bool                   b;
+  char                   c;
+  unsigned char          uc;
+  short                  s;
+  unsigned short         us;
+  int                    i;
+  unsigned int           ui;
+  float                  f;
+  double                 d;
+  long long int          i64;
+  unsigned long long int ui64;
+  char                  *str;
+  unsigned char         *bytes;
+};
+
+// #undef pin names lest they collide with names in any header file(s) you might
+// include.  (Note:  Port/attribute changes may change this list.)
+#undef EN
+#undef VCC
+#undef TX
+
+/*------------------------------------------------------------------------------
+ * Components may use the uData array of ports/attributes passed by QSpice in
+ * several places.  If the ports/attributes are changed, the array offsets
+ * change.  For convenience, I #define it here so that later changes to
+ * ports/attributes require code changes only here.
+ *----------------------------------------------------------------------------*/
+#define UDATA(data)                                                            \
+  double      EN       = data[0].d;                                            \
+  double      VCC      = data[1].d;                                            \
+  int         BAUD     = data[2].i;                                            \
+  int         DATABITS = data[3].i;                                            \
+  int         PARITY   = data[4].i;                                            \
+  double      STOPBITS = data[5].d;                                            \
+  const char *TXFILE   = data[6].str;                                          \
+  const char *TXDATA   = data[7].str;                                          \
+  double     &TX       = data[8].d;
+
+/*------------------------------------------------------------------------------
+ * Per instance data structure.  Allocated in evalutation function.
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  PinIn        enPinIn;             // enable signal (active low)
+  PinOut       txPinOut;            // TX pin
+  SerialBuffer sBuf;                // frame shift register
+  UartConfig   cfg;                 // frame format & baud rate
+  UartFifo     fifo;                // data waiting to be sent
+  BitClock     bitClk;              // half-bit tick clock
+  FILE        *txFile  = nullptr;   // TxFile data source (if any)
+  bool         inFrame = false;     // true while a frame is being sent
+  double       incrT   = 0;         // time to next bit boundary (last eval)
+};
+
+/*------------------------------------------------------------------------------
+ * Fwd decls
+ *----------------------------------------------------------------------------*/
+bool loadFrame(InstData &inst);
+
+/*------------------------------------------------------------------------------
+ * uarttx() -- evaluation function called by QSpice.
+ *
+ * Bit boundaries are scheduled on a drift-free half-bit tick clock (half-bit
+ * ticks so that 1.5 stop bits land exactly).  The clock is locked to the time
+ * that EN goes low and keeps running across back-to-back frames.  The only
+ * forced timesteps are the bit boundaries themselves.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void uarttx(
+    InstData **opaque, double t, uData *data) {
+  UDATA(data);
+
+  InstData *inst = *opaque;
+
+  if (!inst) {
+    // first time, VCC is 0.0V so delay until VCC is something valid...
+    if (VCC == 0.0) return;
+
+    *opaque = inst = new InstData();
+    if (!inst) {   // terminate with prejudice
+      msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
+      std::terminate();
+    }
+
+    // set up frame format from attributes
+    inst->cfg.init(BAUD, DATABITS, PARITY, STOPBITS);
+    inst->bitClk.init(2.0 * inst->cfg.baud);
+
+    // set up data source -- TxFile if given, else TxData hex string
+    if (TXFILE && *TXFILE) {
+      if (!(inst->txFile = fopen(TXFILE, "rb")))
+        msg(__LINE__, "Unable to open TxFile=\"%s\".\n", TXFILE);
+      inst->fifo.fill(inst->txFile, inst->cfg.dataBits > 8);
+    } else inst->fifo.fill(TXDATA);
+
+    // set up pins; TX idles high (mark)
+    inst->enPinIn = PinIn(VCC, EN);
+    TX = (inst->txPinOut = PinOut(VCC, PinState::HIGH)).getStateV();
+
+    // already enabled?  start the bit clock now
+    if (inst->enPinIn.isLow()) inst->bitClk.start(t);
+
+    // debug info
+    msg(__LINE__, "Baud=%d, DataBits=%d, Parity=%d, StopBits=%g, Words=%d.\n",
+        inst->cfg.baud, inst->cfg.dataBits, inst->cfg.parity,
+        inst->cfg.stopHalfBits / 2.0, inst->fifo.count());
+  }
+
+  // set PinIn states from inputs
+  inst->enPinIn.setState(EN);
+
+  // start the bit clock on the falling edge of EN (unless finishing a frame)
+  if (inst->enPinIn.isFalling() && !inst->inFrame) inst->bitClk.start(t);
+
+  TX = inst->txPinOut.getStateV();
+
+  // bit boundary now?
+  if (t < inst->bitClk.nextTime()) {
+    inst->incrT = inst->bitClk.nextTime() - t;
+    return;
+  }
+
+  // start a new frame if the last one is done
+  if (!inst->inFrame || inst->sBuf.isDone()) {
+    if (inst->enPinIn.isHigh() || !loadFrame(*inst)) {
+      // disabled or out of data -- idle until EN falls again
+      inst->inFrame = false;
+      inst->bitClk.stop();
+      TX          = inst->txPinOut.setIdle().getStateV();
+      inst->incrT = eternity;
+      return;
+    }
+  }
+
+  // send the next bit; the last stop bit is a half-bit for 1.5 stop bits
+  TX = inst->txPinOut.setState(inst->sBuf.getBitOut()).getStateV();
+  inst->sBuf.setBitIn(false);
+  bool lastBit = inst->sBuf.isDone();
+  inst->bitClk.advance(lastBit && (inst->cfg.stopHalfBits & 1) ? 1 : 2);
+
+  inst->incrT = inst->bitClk.nextTime() - t;
+}
+
+/*------------------------------------------------------------------------------
+ * MaxExtStepSize() -- step to the next bit boundary
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) double MaxExtStepSize(InstData *inst) {
+  if (!inst || inst->incrT <= 0) return eternity;
+  return inst->incrT;
+}
+
+/*------------------------------------------------------------------------------
+ * Trunc() -- force simulation to trigger on timed bit boundaries
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Trunc(
+    InstData *inst, double t, uData *data, double *timestep) {
+  if (!inst) return;
+
+  double nextT = inst->bitClk.nextTime();
+  if (t < nextT && *timestep > nextT - t) *timestep = nextT - t;
+}
+
+/*------------------------------------------------------------------------------
+ * loadFrame() -- load the next data word into the frame shift register.
+ * Returns false if there is no more data.
+ *----------------------------------------------------------------------------*/
+bool loadFrame(InstData &inst) {
+  // refill from the file when the FIFO runs low
+  if (inst.txFile && inst.fifo.count() < UartFifo::capacity / 2)
+    if (!inst.fifo.fill(inst.txFile, inst.cfg.dataBits > 8)) {
+      fclose(inst.txFile);
+      inst.txFile = nullptr;
+    }
+
+  if (inst.fifo.isEmpty()) return false;
+
+  inst.sBuf.startIO(
+      inst.cfg.buildFrame(inst.fifo.pop()), inst.cfg.frameBits());
+  inst.inFrame = true;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy() -- called by QSpice when simulation ends.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(struct InstData *inst) {
+  if (inst && inst->txFile) fclose(inst->txFile);
+
+  // delete per-instance data allocated in the evaluation function
+  delete inst;
+}
+
+/*------------------------------------------------------------------------------
+ * int DllMain() must exist and return 1 for a process to load the .DLL
+ * See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more
+ * information.
+ *----------------------------------------------------------------------------*/
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) {
+  return 1;
+}
+/*==============================================================================
+ * End of UartTx.cpp
+ *============================================================================*/
@@ -0,0 +1,277 @@
+/*==============================================================================
+ * VcdDump.cpp -- Digital channel logger.  Writes an IEEE-1364 VCD file (e.g.,
+ * for viewing in GTKWave).
+ *============================================================================*/
+// Note:  Compile with MS VC
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+#include "VcdIO.h"
+
+// versioning for messages
+#define PROGRAM_NAME    "VcdDump"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+#define msleep(msecs)                                                          \
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs))
+
+void msg(int lineNbr, const char *fmt, ...) {
+  msleep(30);
+  fflush(stdout);
+  fprintf(stdout, PROGRAM_INFO " (@%d) ", lineNbr);
+  va_list args = {0};
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  fflush(stdout);
+  msleep(30);
+}
+
+/*------------------------------------------------------------------------------
+ * uData -- union overlay for passed port/attribute data.
+ *----------------------------------------------------------------------------*/
+union uData {
+  bool                   b;
+  char                   c;
+  unsigned char          uc;
+  short                  s;
+  unsigned short         us;
+  int                    i;
+  unsigned int           ui;
+  float                  f;
+  double                 d;
+  long long int          i64;
+  unsigned long long int ui64;
+  char                  *str;
+  unsigned char         *bytes;
+};
+
+/*------------------------------------------------------------------------------
+ * QSpice exports.  ForKeeps is false for trial steps that QSpice may reject.
+ * (Older QSpice versions don't set it.)
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) const bool *ForKeeps = 0;
+
+// #undef pin names lest they collide with names in any header file(s) you might
+// include.  (Note:  Port/attribute changes may change this list.)
+#undef VCC
+
+/*------------------------------------------------------------------------------
+ * Components may use the uData array of ports/attributes passed by QSpice in
+ * several places.  If the ports/attributes are changed, the array offsets
+ * change.  For convenience, I #define it here so that later changes to
+ * ports/attributes require code changes only here.
+ *
+ * The channel input ports D0-D15 are data[0]-data[15].  (Add ports & bump
+ * MaxChannels for more.)
+ *----------------------------------------------------------------------------*/
+#define UDATA(data)                                                            \
+  double      VCC      = data[16].d;                                           \
+  const char *VCDFILE  = data[17].str;                                         \
+  int         CHANNELS = data[18].i;                                           \
+  const char *NAMES    = data[19].str;                                         \
+  const char *BUSES    = data[20].str;
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const int    MaxChannels = 16;      // # of channel input ports
+const double TimeRes     = 1e-12;   // VCD time resolution (seconds)
+const char  *TimeScale   = "1ps";   // ...and the matching $timescale
+
+/*------------------------------------------------------------------------------
+ * Per instance data structure.  Allocated in evalutation function.
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  VcdWriter vcd;                    // buffered VCD file writer
+  VcdVar    vars[MaxChannels];      // wires & buses
+  int       nbrVars   = 0;          // # of vars
+  int       channels  = 0;          // # of channels logged
+  uint64_t  lastState = 0;          // bit-packed channel states
+  uint64_t  lastTime  = 0;          // last time stamp written
+  uint64_t  changeCnt = 0;          // # of value changes written
+};
+
+/*------------------------------------------------------------------------------
+ * Fwd decls
+ *----------------------------------------------------------------------------*/
+void initVars(InstData &inst, const char *names, const char *buses);
+void writeChanges(InstData &inst, uint64_t state, uint64_t changed);
+
+/*------------------------------------------------------------------------------
+ * readChannels() -- threshold the channel inputs at VCC/2 (as PinIn does) and
+ * pack them into a state word, channel n in bit n.
+ *----------------------------------------------------------------------------*/
+inline uint64_t readChannels(const uData *data, int channels, double vTh) {
+  uint64_t state = 0;
+  for (int i = 0; i < channels; i++)
+    state |= uint64_t(data[i].d > vTh) << i;
+  return state;
+}
+
+/*------------------------------------------------------------------------------
+ * vcddump() -- evaluation function called by QSpice.
+ *
+ * The channel states are packed into one word and XORed with the last word.
+ * If nothing changed (the usual case), that's all the work done this step.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void vcddump(
+    InstData **opaque, double t, uData *data) {
+  UDATA(data);
+
+  InstData *inst = *opaque;
+
+  if (!inst) {
+    // first time, VCC is 0.0V so delay until VCC is something valid...
+    if (VCC == 0.0) return;
+
+    *opaque = inst = new InstData();
+    if (!inst) {   // terminate with prejudice
+      msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
+      std::terminate();
+    }
+
+    if (CHANNELS < 1 || CHANNELS > MaxChannels) {
+      msg(__LINE__, "Channels=%d is not valid.  Using %d channels.\n",
+          CHANNELS, MaxChannels);
+      CHANNELS = MaxChannels;
+    }
+    inst->channels = CHANNELS;
+
+    initVars(*inst, NAMES, BUSES);
+
+    if (!inst->vcd.open(VCDFILE)) {
+      msg(__LINE__, "Unable to create VCD file \"%s\".\n", VCDFILE);
+      return;
+    }
+
+    // header & initial values
+    inst->lastState = readChannels(data, inst->channels, VCC / 2.0);
+    inst->lastTime  = uint64_t(llround(t / TimeRes));
+    inst->vcd.header("qspice", TimeScale, inst->vars, inst->nbrVars);
+    inst->vcd.putTime(inst->lastTime);
+    inst->vcd.put("$dumpvars\n");
+    writeChanges(*inst, inst->lastState, ~uint64_t(0));
+    inst->vcd.put("$end\n");
+
+    // debug info
+    msg(__LINE__, "Logging %d channels (%d vars) to \"%s\".\n", inst->channels,
+        inst->nbrVars, VCDFILE);
+    return;
+  }
+
+  if (!inst->vcd.isOpen()) return;
+
+  // log accepted steps only -- a trial step may be rejected and QSpice backs
+  // up to an earlier time
+  if (ForKeeps && !*ForKeeps) return;
+
+  uint64_t state   = readChannels(data, inst->channels, VCC / 2.0);
+  uint64_t changed = state ^ inst->lastState;
+  if (!changed) return;
+
+  // only one time stamp per time resolution tick and never backward (VCD time
+  // stamps must increase) -- a change seen at an earlier time is merged into
+  // the last time stamp
+  uint64_t time = uint64_t(llround(t / TimeRes));
+  if (time > inst->lastTime) inst->vcd.putTime(inst->lastTime = time);
+
+  writeChanges(*inst, state, changed);
+  inst->lastState = state;
+}
+
+/*------------------------------------------------------------------------------
+ * writeChanges() -- write the value changes for the vars with changed bits.
+ *----------------------------------------------------------------------------*/
+void writeChanges(InstData &inst, uint64_t state, uint64_t changed) {
+  for (int i = 0; i < inst.nbrVars; i++) {
+    const VcdVar &var = inst.vars[i];
+    if (!(changed & var.mask)) continue;
+    if (var.width == 1) inst.vcd.putBit(state & var.mask, var.id);
+    else
+      inst.vcd.putVector((state & var.mask) >> var.lsb, var.width, var.id);
+    inst.changeCnt++;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * initVars() -- build the var list from the Names & Buses attributes.
+ *
+ * Names is a whitespace-separated list of channel names in channel order
+ * (default D0, D1, ...).  Buses is a whitespace-separated list of NAME=lo:hi
+ * groups of adjacent channels logged as one vector (hi is the MSb).  Channels
+ * in a bus aren't also logged as wires.
+ *----------------------------------------------------------------------------*/
+void initVars(InstData &inst, const char *names, const char *buses) {
+  uint64_t inBus = 0;   // channels claimed by buses
+
+  // buses first
+  while (buses && *buses) {
+    char name[32];
+    int  lo, hi, n = 0;
+    if (sscanf(buses, " %31[^= \t]=%d:%d%n", name, &lo, &hi, &n) != 3) break;
+    buses += n;
+    if (lo > hi) std::swap(lo, hi);
+    if (lo < 0 || hi >= inst.channels) {
+      msg(__LINE__, "Bus %s=%d:%d is out of range.  Ignored.\n", name, lo, hi);
+      continue;
+    }
+    VcdVar &var = inst.vars[inst.nbrVars];
+    strcpy(var.name, name);
+    var.lsb   = lo;
+    var.width = hi - lo + 1;
+    var.mask  = ((~uint64_t(0)) >> (64 - var.width)) << lo;
+    vcdMakeId(var.id, inst.nbrVars++);
+    inBus |= var.mask;
+    if (inst.nbrVars == MaxChannels) break;
+  }
+
+  // wires for everything else
+  for (int ch = 0; ch < inst.channels; ch++) {
+    char name[32];
+    int  n = 0;
+    if (!names || sscanf(names, " %31s%n", name, &n) != 1)
+      snprintf(name, sizeof(name), "D%d", ch);
+    if (names) names += n;
+
+    if (inBus & (uint64_t(1) << ch) || inst.nbrVars == MaxChannels) continue;
+
+    VcdVar &var = inst.vars[inst.nbrVars];
+    strcpy(var.name, name);
+    var.lsb   = ch;
+    var.width = 1;
+    var.mask  = uint64_t(1) << ch;
+    vcdMakeId(var.id, inst.nbrVars++);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy() -- called by QSpice when simulation ends.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(struct InstData *inst) {
+  if (inst && inst->vcd.isOpen())
+    msg(__LINE__, "Closing VCD file.  %llu value changes written.\n",
+        inst->changeCnt);
+
+  // delete per-instance data allocated in the evaluation function (closing
+  // the VCD file flushes the buffer)
+  delete inst;
+}
+
+/*------------------------------------------------------------------------------
+ * int DllMain() must exist and return 1 for a process to load the .DLL
+ * See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more
+ * information.
+ *----------------------------------------------------------------------------*/
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) {
+  return 1;
+}
+/*==============================================================================
+ * End of VcdDump.cpp
+ *============================================================================*/
@@ -0,0 +1,301 @@
+/*==============================================================================
+ * VcdIO.h -- IEEE-1364 Value Change Dump (VCD) file support common to the VCD
+ * components (signal definitions, buffered writer & reader).
+ *============================================================================*/
+
+#ifndef VCDIO_H
+#define VCDIO_H
+
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+void msg(int lineNbr, const char *fmt, ...);   // fwd decl for debugging
+
+/*------------------------------------------------------------------------------
+ * VcdVar -- a VCD variable:  a single wire or a bus (vector) of adjacent
+ * channel bits.  The mask selects the variable's bits in the packed channel
+ * state word.
+ *----------------------------------------------------------------------------*/
+struct VcdVar {
+  char     name[32];   // signal name
+  char     id[8];      // VCD identifier code
+  uint64_t mask;       // channel bits in packed state word
+  uint8_t  lsb;        // first channel
+  uint8_t  width;      // # of channels (1 = wire)
+};
+
+// VCD identifier codes are printable ASCII ('!' through '~').  one character
+// is plenty for our channel counts but use two to be safe
+inline void vcdMakeId(char *id, int idx) {
+  const int range = '~' - '!' + 1;
+  if (idx < range) {
+    id[0] = char('!' + idx);
+    id[1] = '\0';
+  } else {
+    id[0] = char('!' + idx % range);
+    id[1] = char('!' + idx / range);
+    id[2] = '\0';
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * VcdWriter -- buffered VCD file writer.  Value changes are formatted directly
+ * into a large memory buffer which is written to the file only when full so
+ * the per-change cost is a few bytes of copying.
+ *----------------------------------------------------------------------------*/
+class VcdWriter {
+public:
+  VcdWriter() {}
+  ~VcdWriter() { close(); }
+
+  bool open(const char *path) {
+    file = fopen(path, "wb");
+    return file != nullptr;
+  }
+
+  void close() {
+    if (!file) return;
+    flush();
+    fclose(file);
+    file = nullptr;
+  }
+
+  inline bool isOpen() const { return file != nullptr; }
+
+  void flush() {
+    if (file && len) fwrite(buf, 1, len, file);
+    len = 0;
+  }
+
+  // write the header through $enddefinitions; timescale is, e.g., "1ps"
+  void header(const char *module, const char *timescale, const VcdVar *vars,
+      int nbrVars) {
+    put("$version QSpice VcdDump $end\n$timescale ");
+    put(timescale);
+    put(" $end\n$scope module ");
+    put(module);
+    put(" $end\n");
+    for (int i = 0; i < nbrVars; i++) {
+      char line[96];
+      if (vars[i].width == 1)
+        snprintf(line, sizeof(line), "$var wire 1 %s %s $end\n", vars[i].id,
+            vars[i].name);
+      else
+        snprintf(line, sizeof(line), "$var wire %d %s %s [%d:0] $end\n",
+            vars[i].width, vars[i].id, vars[i].name, vars[i].width - 1);
+      put(line);
+    }
+    put("$upscope $end\n$enddefinitions $end\n");
+  }
+
+  // write a time stamp ("#1234")
+  void putTime(uint64_t time) {
+    char  tmp[24];
+    char *p = tmp + sizeof(tmp);
+    *--p    = '\n';
+    do {
+      *--p = char('0' + time % 10);
+      time /= 10;
+    } while (time);
+    *--p = '#';
+    put(p, tmp + sizeof(tmp) - p);
+  }
+
+  // write a scalar value change ("1!")
+  void putBit(bool val, const char *id) {
+    reserve(8);
+    buf[len++] = val ? '1' : '0';
+    while (*id) buf[len++] = *id++;
+    buf[len++] = '\n';
+  }
+
+  // write a vector value change ("b0101 !"), MSb first
+  void putVector(uint64_t val, int width, const char *id) {
+    reserve(width + 8);
+    buf[len++] = 'b';
+    for (int i = width - 1; i >= 0; i--)
+      buf[len++] = (val >> i) & 1 ? '1' : '0';
+    buf[len++] = ' ';
+    while (*id) buf[len++] = *id++;
+    buf[len++] = '\n';
+  }
+
+  void put(const char *str) { put(str, strlen(str)); }
+
+  void put(const char *str, size_t n) {
+    reserve(n);
+    if (n > sizeof(buf)) {   // too big to buffer
+      fwrite(str, 1, n, file);
+      return;
+    }
+    memcpy(buf + len, str, n);
+    len += n;
+  }
+
+protected:
+  // make room for n bytes
+  inline void reserve(size_t n) {
+    if (len + n > sizeof(buf)) flush();
+  }
+
+  FILE  *file = nullptr;
+  size_t len  = 0;
+  char   buf[65536];
+};
+
+/*------------------------------------------------------------------------------
+ * VcdEvent -- the states of all channels from a point in time on.  A stimulus
+ * is a time-sorted array of these so that the state at any time is a single
+ * lookup.
+ *----------------------------------------------------------------------------*/
+struct VcdEvent {
+  double   time;    // event time (seconds)
+  uint64_t state;   // bit-packed channel states
+};
+
+typedef std::vector<VcdEvent> VcdEventList;
+
+/*------------------------------------------------------------------------------
+ * VcdReader -- loads the value changes of a VCD file into an event list.
+ * Variables are assigned to channels in declaration order (a bus takes width
+ * adjacent channels) up to maxChannels.  x & z values are read as 0.
+ *----------------------------------------------------------------------------*/
+class VcdReader {
+public:
+  ~VcdReader() {
+    if (file) fclose(file);
+  }
+
+  // returns # of channels used or -1 if the file couldn't be opened
+  int load(const char *path, VcdEventList &events, VcdVar *vars, int maxVars,
+      int maxChannels) {
+    if (!(file = fopen(path, "rb"))) return -1;
+
+    double   scale    = 1e-12;   // seconds per VCD time unit
+    int      nbrVars  = 0;
+    int      channels = 0;
+    uint64_t state    = 0;
+    char     tok[256];
+
+    while (next(tok, sizeof(tok))) {
+      if (*tok == '$') {
+        if (!strcmp(tok, "$timescale")) scale = readTimescale();
+        else if (!strcmp(tok, "$var")) {
+          VcdVar var;
+          if (!readVar(var)) continue;
+          if (find(var.id, vars, nbrVars)) continue;   // same signal, new scope
+          if (nbrVars == maxVars || channels + var.width > maxChannels) {
+            msg(__LINE__, "Too many channels.  %s not loaded.\n", var.name);
+            continue;
+          }
+          var.lsb  = channels;
+          var.mask = ((~uint64_t(0)) >> (64 - var.width)) << channels;
+          channels += var.width;
+          vars[nbrVars++] = var;
+        } else if (!strcmp(tok, "$dumpvars") || !strcmp(tok, "$dumpall") ||
+                   !strcmp(tok, "$dumpon") || !strcmp(tok, "$dumpoff") ||
+                   !strcmp(tok, "$end"))
+          continue;   // value changes follow -- nothing to skip
+        else skipToEnd();
+      } else if (*tok == '#') {
+        double time = strtoull(tok + 1, nullptr, 10) * scale;
+        if (events.empty() || events.back().time != time)
+          events.push_back({time, state});
+      } else if (*tok == 'b' || *tok == 'B') {
+        uint64_t val = 0;
+        for (const char *p = tok + 1; *p; p++) val = (val << 1) | (*p == '1');
+        if (!next(tok, sizeof(tok))) break;
+        apply(events, state, find(tok, vars, nbrVars), val);
+      } else if (*tok == 'r' || *tok == 'R') {
+        next(tok, sizeof(tok));   // real values aren't supported
+      } else if (strchr("01xXzZ", *tok)) {
+        apply(events, state, find(tok + 1, vars, nbrVars), *tok == '1');
+      }
+    }
+
+    fclose(file);
+    file = nullptr;
+    return channels;
+  }
+
+protected:
+  // read the next whitespace-separated token; false at end of file
+  bool next(char *tok, size_t size) {
+    int c;
+    while ((c = getc(file)) != EOF && isspace(c));
+    if (c == EOF) return false;
+    size_t n = 0;
+    do {
+      if (n < size - 1) tok[n++] = char(c);
+    } while ((c = getc(file)) != EOF && !isspace(c));
+    tok[n] = '\0';
+    return true;
+  }
+
+  void skipToEnd() {
+    char tok[256];
+    while (next(tok, sizeof(tok)) && strcmp(tok, "$end"));
+  }
+
+  // "$timescale 10 ns $end" or "$timescale 10ns $end"
+  double readTimescale() {
+    char   tok[256], unit[256] = "";
+    double mult = 1.0;
+    while (next(tok, sizeof(tok)) && strcmp(tok, "$end")) {
+      char *end;
+      double val = strtod(tok, &end);
+      if (end != tok) mult = val;
+      if (*end) strcpy(unit, end);
+    }
+    static const struct {
+      const char *unit;
+      double      secs;
+    } units[] = {{"s", 1.0}, {"ms", 1e-3}, {"us", 1e-6}, {"ns", 1e-9},
+        {"ps", 1e-12}, {"fs", 1e-15}};
+    for (const auto &u : units)
+      if (!strcmp(unit, u.unit)) return mult * u.secs;
+    msg(__LINE__, "Unknown $timescale unit \"%s\".  Using 1ps.\n", unit);
+    return 1e-12;
+  }
+
+  // "$var wire 8 # data [7:0] $end"
+  bool readVar(VcdVar &var) {
+    char tok[256];
+    int  n = 0;
+    var    = {};
+    while (next(tok, sizeof(tok)) && strcmp(tok, "$end")) {
+      switch (n++) {
+      case 1: var.width = uint8_t(atoi(tok)); break;
+      case 2: snprintf(var.id, sizeof(var.id), "%s", tok); break;
+      case 3: snprintf(var.name, sizeof(var.name), "%s", tok); break;
+      }
+    }
+    return n >= 4 && var.width >= 1 && var.width <= 64;
+  }
+
+  static const VcdVar *find(const char *id, const VcdVar *vars, int nbrVars) {
+    for (int i = 0; i < nbrVars; i++)
+      if (!strcmp(id, vars[i].id)) return &vars[i];
+    return nullptr;
+  }
+
+  // set var's channels to val in the current (last) event
+  static void apply(VcdEventList &events, uint64_t &state, const VcdVar *var,
+      uint64_t val) {
+    if (!var) return;
+    state = (state & ~var->mask) | ((val << var->lsb) & var->mask);
+    if (events.empty()) events.push_back({0.0, state});
+    events.back().state = state;
+  }
+
+  FILE *file = nullptr;
+};
+
+#endif   // VCDIO_H
+/*==============================================================================
+ * End of VcdIO.h
+ *============================================================================*/
@@ -0,0 +1,279 @@
+/*==============================================================================
+ * VcdPlay.cpp -- Digital stimulus player.  Drives up to 64 outputs from a VCD
+ * or CSV test vector file.
+ *============================================================================*/
+// Note:  Compile with MS VC
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+
+#include "VcdIO.h"
+
+// versioning for messages
+#define PROGRAM_NAME    "VcdPlay"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+#define msleep(msecs)                                                          \
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs))
+
+void msg(int lineNbr, const char *fmt, ...) {
+  msleep(30);
+  fflush(stdout);
+  fprintf(stdout, PROGRAM_INFO " (@%d) ", lineNbr);
+  va_list args = {0};
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  fflush(stdout);
+  msleep(30);
+}
+
+/*------------------------------------------------------------------------------
+ * uData -- union overlay for passed port/attribute data.
+ *----------------------------------------------------------------------------*/
+union uData {
+  bool                   b;
+  char                   c;
+  unsigned char          uc;
+  short                  s;
+  unsigned short         us;
+  int                    i;
+  unsigned int           ui;
+  float                  f;
+  double                 d;
+  long long int          i64;
+  unsigned long long int ui64;
+  char                  *str;
+  unsigned char         *bytes;
+};
+
+// #undef pin names lest they collide with names in any header file(s) you might
+// include.  (Note:  Port/attribute changes may change this list.)
+#undef VCC
+
+/*------------------------------------------------------------------------------
+ * Components may use the uData array of ports/attributes passed by QSpice in
+ * several places.  If the ports/attributes are changed, the array offsets
+ * change.  For convenience, I #define it here so that later changes to
+ * ports/attributes require code changes only here.
+ *
+ * The channel output ports Q0-Q63 follow the attributes.  Only the first
+ * Channels outputs are written so the symbol needs only that many ports.
+ *----------------------------------------------------------------------------*/
+#define UDATA(data)                                                            \
+  double      VCC      = data[0].d;                                            \
+  const char *VECFILE  = data[1].str;                                          \
+  int         CHANNELS = data[2].i;                                            \
+  double      TIMEUNIT = data[3].d;                                            \
+  uData      *Q        = &data[4];
+
+/*------------------------------------------------------------------------------
+ * Constants
+ *----------------------------------------------------------------------------*/
+const double eternity    = 1.7e308;   // end of the 'verse
+const int    MaxChannels = 64;        // # of channel output ports
+
+/*------------------------------------------------------------------------------
+ * Per instance data structure.  Allocated in evalutation function.
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  VcdEventList events;             // time-sorted channel states
+  size_t       nbrEvents = 0;      // # of events in file
+  size_t       cursor    = 0;      // current event
+  int          channels  = 0;      // # of outputs driven
+  double       incrT     = 0;      // time to next event (last eval)
+};
+
+/*------------------------------------------------------------------------------
+ * Fwd decls
+ *----------------------------------------------------------------------------*/
+bool loadVectors(InstData &inst, const char *path, double timeUnit);
+int  loadCsv(const char *path, VcdEventList &events, double timeUnit);
+
+/*------------------------------------------------------------------------------
+ * seekEvent() -- move the cursor to the last event at or before time t.
+ *
+ * Simulation time normally moves forward one event at a time so the cursor
+ * checks the current & next events first.  A rollback (QSpice retrying a
+ * smaller timestep after Trunc()) or a long step falls back to a binary
+ * search.  The event list has a sentinel at eternity so cursor+1 always
+ * exists.
+ *----------------------------------------------------------------------------*/
+inline void seekEvent(InstData &inst, double t) {
+  const VcdEventList &ev = inst.events;
+  size_t             &i  = inst.cursor;
+
+  if (t >= ev[i].time) {
+    if (t < ev[i + 1].time) return;
+    if (i + 2 < ev.size() && t < ev[i + 2].time) {
+      i++;
+      return;
+    }
+  }
+
+  auto it = std::upper_bound(ev.begin(), ev.end(), t,
+      [](double t, const VcdEvent &e) { return t < e.time; });
+  i = it == ev.begin() ? 0 : size_t(it - ev.begin()) - 1;
+}
+
+/*------------------------------------------------------------------------------
+ * vcdplay() -- evaluation function called by QSpice.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void vcdplay(
+    InstData **opaque, double t, uData *data) {
+  UDATA(data);
+
+  InstData *inst = *opaque;
+
+  if (!inst) {
+    // first time, VCC is 0.0V so delay until VCC is something valid...
+    if (VCC == 0.0) return;
+
+    *opaque = inst = new InstData();
+    if (!inst) {   // terminate with prejudice
+      msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
+      std::terminate();
+    }
+
+    if (CHANNELS < 1 || CHANNELS > MaxChannels) {
+      msg(__LINE__, "Channels=%d is not valid.  Valid values are 1-%d.\n",
+          CHANNELS, MaxChannels);
+      CHANNELS = CHANNELS < 1 ? 1 : MaxChannels;
+    }
+    inst->channels = CHANNELS;
+
+    if (TIMEUNIT <= 0) TIMEUNIT = 1.0;
+    if (!loadVectors(*inst, VECFILE, TIMEUNIT))
+      msg(__LINE__, "Unable to load \"%s\".  Outputs held low.\n", VECFILE);
+
+    // debug info
+    msg(__LINE__, "Loaded %zu events from \"%s\".\n", inst->nbrEvents,
+        VECFILE);
+  }
+
+  seekEvent(*inst, t);
+
+  uint64_t state = inst->events[inst->cursor].state;
+  for (int i = 0; i < inst->channels; i++)
+    Q[i].d = (state >> i) & 1 ? VCC : 0.0;
+
+  inst->incrT = inst->events[inst->cursor + 1].time - t;
+}
+
+/*------------------------------------------------------------------------------
+ * MaxExtStepSize() -- step exactly to the next event
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) double MaxExtStepSize(InstData *inst) {
+  if (!inst || inst->incrT <= 0) return eternity;
+  return inst->incrT;
+}
+
+/*------------------------------------------------------------------------------
+ * Trunc() -- force simulation to trigger on event times
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Trunc(
+    InstData *inst, double t, uData *data, double *timestep) {
+  if (!inst) return;
+
+  double nextT = inst->events[inst->cursor + 1].time;
+  if (t < nextT && *timestep > nextT - t) *timestep = nextT - t;
+}
+
+/*------------------------------------------------------------------------------
+ * loadVectors() -- load the vector file (.csv files as CSV, anything else as
+ * VCD), sort it, and add the leading (all low) & trailing sentinel events.
+ *----------------------------------------------------------------------------*/
+bool loadVectors(InstData &inst, const char *path, double timeUnit) {
+  VcdEventList &ev = inst.events;
+  int           channels;
+
+  const char *ext = path ? strrchr(path, '.') : nullptr;
+  if (ext && !_stricmp(ext, ".csv")) channels = loadCsv(path, ev, timeUnit);
+  else if (path) {
+    VcdVar    vars[MaxChannels] = {};
+    VcdReader vcd;
+    channels = vcd.load(path, ev, vars, MaxChannels, MaxChannels);
+    for (int i = 0; i < channels && vars[i].width; i++) {
+      if (vars[i].lsb >= inst.channels) break;
+      msg(__LINE__, "Q%d-Q%d: %s\n", vars[i].lsb,
+          vars[i].lsb + vars[i].width - 1, vars[i].name);
+    }
+  } else channels = -1;
+
+  if (channels > inst.channels)
+    msg(__LINE__, "%d channels in file.  Only %d are driven.\n", channels,
+        inst.channels);
+
+  // VCD files are in time order; CSV rows might not be.  keep the last row
+  // for any duplicated time.
+  std::stable_sort(ev.begin(), ev.end(),
+      [](const VcdEvent &a, const VcdEvent &b) { return a.time < b.time; });
+  auto last = std::unique(ev.rbegin(), ev.rend(),
+      [](const VcdEvent &a, const VcdEvent &b) { return a.time == b.time; });
+  ev.erase(ev.begin(), last.base());
+
+  inst.nbrEvents = ev.size();
+  if (ev.empty() || ev.front().time > 0) ev.insert(ev.begin(), {0.0, 0});
+  ev.push_back({eternity, ev.back().state});
+
+  return channels >= 0;
+}
+
+/*------------------------------------------------------------------------------
+ * loadCsv() -- load a CSV file of rows:  time, ch0, ch1, ...  Time is in
+ * TimeUnit seconds.  Channel values are 0 or 1 (anything non-zero is 1).
+ * Lines that don't start with a number (headers, comments) are skipped.
+ * Returns the # of channels or -1 if the file couldn't be opened.
+ *----------------------------------------------------------------------------*/
+int loadCsv(const char *path, VcdEventList &events, double timeUnit) {
+  FILE *file = fopen(path, "r");
+  if (!file) return -1;
+
+  static char line[4096];
+  int         channels = 0;
+
+  while (fgets(line, sizeof(line), file)) {
+    char  *p, *end;
+    double time = strtod(line, &end);
+    if (end == line) continue;
+
+    uint64_t state = 0;
+    int      ch    = 0;
+    for (p = end; ch < MaxChannels; ch++) {
+      while (*p == ',' || *p == ' ' || *p == '\t') p++;
+      unsigned long val = strtoul(p, &end, 0);
+      if (end == p) break;
+      state |= uint64_t(val != 0) << ch;
+      p = end;
+    }
+    if (ch > channels) channels = ch;
+    events.push_back({time * timeUnit, state});
+  }
+
+  fclose(file);
+  return channels;
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy() -- called by QSpice when simulation ends.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(struct InstData *inst) {
+  // delete per-instance data allocated in the evaluation function
+  delete inst;
+}
+
+/*------------------------------------------------------------------------------
+ * int DllMain() must exist and return 1 for a process to load the .DLL
+ * See https://docs.microsoft.com/en-us/windows/win32/dlls/dllmain for more
+ * information.
+ *----------------------------------------------------------------------------*/
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) {
+  return 1;
+}
+/*==============================================================================
+ * End of VcdPlay.cpp
+ *============================================================================*/
@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * I2sSrc.cpp -- QSpice C-Block component to stream *.WAV file data onto an
+ * I2S/TDM digital audio bus (bus master:  drives BCLK, LRCLK, & SD).
+ *
+ * 2026.10.19 - v0.1 initial version.
+ *
+ * Copyright © 2026 Robert Dunn.  Licensed for use under the GNU GPLv3.0.
+ ******************************************************************************/
+// The code was compiled with Microsoft VC:
+//   * Run from within "C:\Program Files\Microsoft Visual Studio\2022\
+//     Community\VC\Auxiliary\Build\vcvars32.bat" command line environment
+//   * cl /std:c++17 /EHsc /LD i2ssrc.cpp /link /PDBSTRIPPED /out:i2ssrc.dll
+//
+
+#include "wavsrc.h"
+#include <cstdlib>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <thread>
+
+#define PROGRAM_NAME    "I2sSrc"
+#define PROGRAM_VERSION "v0.1"
+#define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
+
+/*------------------------------------------------------------------------------
+ * Standard QSpice type overlay for data passed in the uData parameter.
+ *----------------------------------------------------------------------------*/
+union uData {
+  bool                   b;
+  char                   c;
+  unsigned char          uc;
+  short                  s;
+  unsigned short         us;
+  int                    i;
+  unsigned int           ui;
+  float                  f;
+  double                 d;
+  long long int          i64;
+  unsigned long long int ui64;
+  char                  *str;
+  unsigned char         *bytes;
+};
+
+// for convenience when ports/attributes are changed, generate a temporary C/C++
+// template and copy uData offsets here (with trailing "/" continuation chars).
+#define UDATA_DEFS                                                             \
+  double      VCC      = data[0].d;                                            \
+  const char *filename = data[1].str;                                          \
+  int         loops    = data[2].i;                                            \
+  int         slotBits = data[3].i;                                            \
+  int         slots    = data[4].i;                                            \
+  int         format   = data[5].i;                                            \
+  double     &BCLK     = data[6].d;                                            \
+  double     &LRCLK    = data[7].d;                                            \
+  double     &SD       = data[8].d;
+
+// #undef pin names lest they collide with names in any header file(s) you might
+// include.
+#undef VCC
+#undef BCLK
+#undef LRCLK
+#undef SD
+
+/*------------------------------------------------------------------------------
+ * constants
+ *----------------------------------------------------------------------------*/
+#define FMT_I2S 0   // Philips I2S:  data delayed one BCLK, WS low = left
+#define FMT_LJ  1   // left-justified:  no delay, WS high = left
+
+const int    MaxSlots = 8;        // TDM slots per frame
+const double forever  = 1e308;    // heat death of the universe?
+
+/*------------------------------------------------------------------------------
+ * Per-instance data
+ *----------------------------------------------------------------------------*/
+struct InstData {
+  WavReader wav        = {};           // WAV file reader
+  bool      fileOpen   = false;        // false = closed or error
+  int       maxLoops   = 0;            // number of times to loop through file
+  int       loopCnt    = 0;            // number of loops so far
+  uint32_t  sampleCnt  = 0;            // samples read in this loop
+  int       slotBits   = 32;           // bits per slot (16, 24, or 32)
+  int       slots      = 2;            // slots per frame
+  int       frameBits  = 64;           // slots * slotBits
+  int       dataDelay  = 1;            // BCLKs from frame sync to slot MSb
+  bool      lrIdle     = false;        // LRCLK state for first (left) slot
+  uint32_t  cur[MaxSlots]  = {};       // this frame's slot data (MSb-aligned)
+  uint32_t  prev[MaxSlots] = {};       // last frame's (for delayed bits)
+  double    tickFreq   = 1;            // BCLK half-period ticks per second
+  double    t0         = 0;            // simulation time of tick 0
+  uint64_t  tick       = 0;            // next BCLK edge tick
+  double    incrT      = 0;            // time to next BCLK edge (last eval)
+  double    vHigh      = 0;            // output high voltage
+  bool      bclk       = false;        // output states
+  bool      lrclk      = false;
+  bool      sd         = false;
+};
+
+/*------------------------------------------------------------------------------
+ * forward decls
+ *----------------------------------------------------------------------------*/
+void initInst(InstData &inst, double t, uData *data);
+void loadFrame(InstData &inst);
+
+// simulation time of the next BCLK edge with minimal rounding error
+inline double nextEdgeTime(const InstData &inst) {
+  return inst.t0 + inst.tick / inst.tickFreq;
+}
+
+/*------------------------------------------------------------------------------
+ * msg() -- send text to QSpice Output window
+ *----------------------------------------------------------------------------*/
+// msleep() isn't available in standard libraries...
+#define msleep(msecs)                                                          \
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs))
+
+void msg(int lineNbr, const char *fmt, ...) {
+  msleep(30);
+  fflush(stdout);
+  fprintf(stdout, PROGRAM_INFO " (@%d) ", lineNbr);
+  va_list args = {0};
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  fflush(stdout);
+  msleep(30);
+}
+
+/*------------------------------------------------------------------------------
+ * i2ssrc() -- QSpice "evaluation function"
+ *
+ * BCLK edges are scheduled on a drift-free tick clock (two ticks per BCLK
+ * period, edge time = tick / tickFreq).  SD & LRCLK change on the falling edge
+ * (even ticks) and the receiver samples on the rising edge (odd ticks).  The
+ * serial data comes straight from the decoded samples -- no intermediate
+ * analog signal or bit-slicing components per bit.
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void i2ssrc(
+    InstData **opaque, double t, uData *data) {
+  // port/attribute offsets/definitions
+  UDATA_DEFS;
+
+  InstData *inst = *opaque;
+
+  if (!inst) {
+    // first time, VCC is 0.0V so delay until VCC is something valid...
+    if (VCC == 0.0) return;
+
+    // construct instance
+    inst = *opaque = new InstData;
+    if (!inst) {   // terminate with extreme prejudice
+      msg(__LINE__, "Unable to allocate memory.  Terminating simulation.\n");
+      std::exit(1);
+    }
+
+    // remaining initialization
+    initInst(*inst, t, data);
+  }
+
+  // BCLK edge now?
+  if (t >= nextEdgeTime(*inst)) {
+    int bitPos = int((inst->tick / 2) % inst->frameBits);
+
+    if (inst->tick & 1) inst->bclk = true;   // rising edge:  receiver samples
+    else {
+      // falling edge:  new frame?
+      if (!bitPos) loadFrame(*inst);
+
+      // LRCLK -- 50% duty word select for 2 slots, else 1-BCLK frame sync
+      if (inst->slots == 2)
+        inst->lrclk = inst->lrIdle ^ (bitPos >= inst->slotBits);
+      else inst->lrclk = !bitPos;
+
+      // SD -- bit positions before the data delay belong to the last frame
+      int       pos  = bitPos - inst->dataDelay;
+      uint32_t *slot = inst->cur;
+      if (pos < 0) {
+        pos += inst->frameBits;
+        slot = inst->prev;
+      }
+      inst->sd   = (slot[pos / inst->slotBits] << (pos % inst->slotBits)) >> 31;
+      inst->bclk = false;
+    }
+
+    inst->tick++;
+  }
+
+  inst->incrT = nextEdgeTime(*inst) - t;
+
+  BCLK  = inst->bclk * inst->vHigh;
+  LRCLK = inst->lrclk * inst->vHigh;
+  SD    = inst->sd * inst->vHigh;
+}
+
+/*------------------------------------------------------------------------------
+ * DllMain() -- required DLL entry point, return 1 on success
+ *----------------------------------------------------------------------------*/
+int __stdcall DllMain(void *module, unsigned int reason, void *reserved) {
+  return 1;
+}
+
+/*------------------------------------------------------------------------------
+ * Destroy() -- end of simulation calls this for cleanup
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Destroy(InstData *inst) {
+  if (inst) wavClose(inst->wav);
+
+  // release the per-instance memory
+  delete inst;
+}
+
+/*------------------------------------------------------------------------------
+ * MaxExtStepSize() -- step to the next BCLK edge
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) double MaxExtStepSize(InstData *inst) {
+  if (!inst || inst->incrT <= 0) return forever;
+  return inst->incrT;
+}
+
+/*------------------------------------------------------------------------------
+ * Trunc() -- limit timestep to next BCLK edge
+ *----------------------------------------------------------------------------*/
+extern "C" __declspec(dllexport) void Trunc(
+    InstData *inst, double t, uData *data, double *timestep) {
+  if (!inst) return;
+
+  double nextT = nextEdgeTime(*inst);
+  if (t < nextT && *timestep > nextT - t) *timestep = nextT - t;
+}
+
+/*------------------------------------------------------------------------------
+ * initInst() -- validate attributes, open input file, etc.
+ *----------------------------------------------------------------------------*/
+void initInst(InstData &inst, double t, uData *data) {
+  // port/attribute offsets/definitions
+  UDATA_DEFS;
+
+  if (slotBits != 16 && slotBits != 24 && slotBits != 32) {
+    msg(__LINE__, "Invalid SlotBits=%d.  Must be 16, 24, or 32.  Using 32.\n",
+        slotBits);
+    slotBits = 32;
+  }
+
+  if (slots < 2 || slots > MaxSlots) {
+    msg(__LINE__, "Invalid Slots=%d.  Must be 2-%d.  Using 2.\n", slots,
+        MaxSlots);
+    slots = 2;
+  }
+
+  if (format != FMT_I2S && format != FMT_LJ) {
+    msg(__LINE__,
+        "Invalid Format=%d.  Must be 0 (I2S) or 1 (LJ).  Using I2S.\n", format);
+    format = FMT_I2S;
+  }
+
+  inst.slotBits  = slotBits;
+  inst.slots     = slots;
+  inst.frameBits = slots * slotBits;
+  inst.dataDelay = format == FMT_I2S ? 1 : 0;
+  inst.lrIdle    = format == FMT_LJ;
+  inst.vHigh     = VCC;
+  inst.maxLoops  = loops < 1 ? INT_MAX : loops;   // technically not infinity
+
+  msg(__LINE__, "Reading WAV file \"%s\", loops=%d\n", filename, loops);
+
+  // open the WAV file & parse through to the start of the sample data
+  switch (wavOpen(inst.wav, filename)) {
+  case WavOK:
+    inst.fileOpen = true;
+    break;
+  case WavBadOpen:
+    msg(__LINE__, "Unable to open WAV file \"%s\".\n", filename);
+    break;
+  case WavBadRead:
+    msg(__LINE__, "Unexpected error reading WAV file \"%s\".\n", filename);
+    break;
+  default:
+    msg(__LINE__, "Unsupported WAV format in file \"%s\".\n", filename);
+  }
+
+  // the frame rate is the WAV sample rate (default 48KHz if no file) -- the
+  // bus keeps clocking zeros after the data runs out
+  int fs        = inst.fileOpen ? inst.wav.samplesPerSec : 48000;
+  inst.tickFreq = 2.0 * fs * inst.frameBits;
+  inst.t0       = t;
+
+  msg(__LINE__,
+      "Format=%s, Slots=%d, SlotBits=%d, Fs=%dHz, BCLK=%gHz.\n",
+      format == FMT_I2S ? "I2S" : "LJ", slots, slotBits, fs,
+      inst.tickFreq / 2.0);
+}
+
+/*------------------------------------------------------------------------------
+ * loadFrame() -- read the next sample frame into the slot words.  Samples are
+ * MSb-aligned in 32-bit words so that a 24-bit sample in a 32-bit slot is
+ * zero-padded and a 24-bit sample in a 16-bit slot is truncated.  Mono files
+ * are sent on both channels; slots beyond the file channels are zero.
+ *----------------------------------------------------------------------------*/
+void loadFrame(InstData &inst) {
+  for (int i = 0; i < inst.slots; i++) {
+    inst.prev[i] = inst.cur[i];
+    inst.cur[i]  = 0;
+  }
+
+  if (!inst.fileOpen) return;
+
+  // end of data?  loop or close
+  if (inst.sampleCnt >= inst.wav.nbrSamples) {
+    inst.sampleCnt = 0;
+    if (++inst.loopCnt >= inst.maxLoops || !wavRewind(inst.wav)) {
+      wavClose(inst.wav);
+      inst.fileOpen = false;
+      return;
+    }
+  }
+
+  int     shift = 32 - inst.wav.bitsPerSample;
+  int32_t val;
+  for (int ch = 0; ch < inst.wav.nbrChannels; ch++) {
+    if (!wavReadSample(inst.wav, val)) {
+      msg(__LINE__, "Unexpected error reading WAV file.\n");
+      wavClose(inst.wav);
+      inst.fileOpen = false;
+      return;
+    }
+    inst.cur[ch] = uint32_t(val) << shift;
+  }
+  if (inst.wav.nbrChannels == 1) inst.cur[1] = inst.cur[0];
+
+  inst.sampleCnt++;
+}
+/*==============================================================================
+ * End of I2sSrc.cpp
+ *============================================================================*/
@@ -4,6 +4,7 @@
  *
  * 2024.04.29 - v0.2 added support for 24-bit PCM.
  * 2024.05.11 - v0.3 revised sample timing & normalization factor.
+ * 2026.10.19 - v0.4 moved WAV file decoding to WavSrc.h (shared with I2sSrc).
  *
  * Copyright © 2023-2024 Robert Dunn.  Licensed for use under the GNU GPLv3.0.
  ******************************************************************************/
@@ -20,7 +21,7 @@
 #include <time.h>
 
 #define PROGRAM_NAME    "WavSrc"
-#define PROGRAM_VERSION "v0.3"
+#define PROGRAM_VERSION "v0.4"
 #define PROGRAM_INFO    PROGRAM_NAME " " PROGRAM_VERSION
 
 /*
@@ -77,34 +78,27 @@ const char *MsgBadOpen =
  * forward decls
  ******************************************************************************/
 struct InstData;
-void           initInst(InstData &, uData *);
-void           getSample(InstData &, double, const char *);
-typedef double SampleFunc(InstData &, const char *);
-SampleFunc     getSample16;
-SampleFunc     getSample24;
+void   initInst(InstData &, uData *);
+void   getSample(InstData &, double, const char *);
+double getChannel(InstData &, const char *);
 
 /*******************************************************************************
  * Per-instance data.  The QSpice template generator gives this structure a
  * unique name based on the C-Block mocule name for reasons that excape me.
  ******************************************************************************/
 struct InstData {
-  FILE       *file;             // file stream pointer for WAV data
-  int         fileState;        // 0 = closed; -1 = error; 1 = open
-  fpos_t      startOfData;      // file position of start of data for looping
-  uint32_t    sampleCnt;        // # of samples read so far
-  uint32_t    nbrSamples;       // # of samples in file
-  int         bytesPerSample;   // bytes in each data sample
-  double      lastCh1;   // last normalized value read/output of channel 1
-  double      lastCh2;   // last normalized value read/output of channel 2
-  double      nextSampleTime;   // time to fetch next sample
-  double      nextSampleIncr;   // simulation time increment for next sample
-  double      maxAmplitude;   // max input amplitude for normalization to +/-1.0
-  double      sampleTimeIncr;   // 1 / sample frequency
-  int         nbrChannels;      // number of channels per sample
-  int         maxLoops;         // number of times to loop through samples
-  int         loopCnt;          // number of loops so far
-  double      gain;             // output gain to apply to normalized values
-  SampleFunc *getSample;        // pointer to sampling function
+  WavReader wav;              // WAV file reader (file & format info)
+  int       fileState;        // 0 = closed; -1 = error; 1 = open
+  uint32_t  sampleCnt;        // # of samples read so far
+  double    lastCh1;          // last normalized value read/output of channel 1
+  double    lastCh2;          // last normalized value read/output of channel 2
+  double    nextSampleTime;   // time to fetch next sample
+  double    nextSampleIncr;   // simulation time increment for next sample
+  double    maxAmplitude;     // max input amplitude for normalization to +/-1.0
+  double    sampleTimeIncr;   // 1 / sample frequency
+  int       maxLoops;         // number of times to loop through samples
+  int       loopCnt;          // number of loops so far
+  double    gain;             // output gain to apply to normalized values
 };
 
 /*------------------------------------------------------------------------------
@@ -191,7 +185,7 @@ extern "C" __declspec(dllexport) void Trunc(
  *----------------------------------------------------------------------------*/
 extern "C" __declspec(dllexport) void Destroy(InstData *inst) {
   msg("Closing WAV file.\n");
-  fclose(inst->file);
+  wavClose(inst->wav);
   free(inst);
 }
 
@@ -210,148 +204,40 @@ void initInst(InstData &inst, uData *data) {
 
   msg("Reading WAV file \"%s\", loops=%d, gain=%f\n", filename, loops, gain);
 
-  // open the WAV file
-  if (!(bool)(inst.file = fopen(filename, "rb"))) {
+  // open the WAV file & parse through to the start of the sample data
+  switch (wavOpen(inst.wav, filename)) {
+  case WavOK:
+    break;
+  case WavBadOpen:
     msg(MsgBadOpen, filename);
     return;
-  }
-
-  // read file header info
-  size_t             bytes;
-  WavFileHeaderChunk fileHdr;
-
-  bytes = fread(&fileHdr, 1, sizeof(fileHdr), inst.file);
-  if (bytes != sizeof(fileHdr)) {
-    fclose(inst.file);
-    msg(MsgBadRead, filename);
-    return;
-  }
-
-  // check header for supported file type
-  if (memcmp(fileHdr.groupID, "RIFF", 4) ||
-      memcmp(fileHdr.riffType, "WAVE", 4)) {
-    fclose(inst.file);
-    msg(MsgBadFormat, filename);
-    return;
-  }
-
-  // grab next chunk header -- should be a format chunk...
-  WavChunkHeader chunkHdr;
-  bytes = fread(&chunkHdr, 1, sizeof(chunkHdr), inst.file);
-  if (bytes != sizeof(chunkHdr)) {
+  case WavBadRead:
     msg(MsgBadRead, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // verify that it is a format chunk
-  if (memcmp(chunkHdr.format, "fmt ", 4)) {
-    msg(MsgBadFormat, filename);
-    fclose(inst.file);
     return;
-  }
-
-  // verify that the format chunk size is acceptable/expected
-  switch (chunkHdr.chunkSize) {
-  case 16:
-  case 18:
-  case 40:
-    break;
   default:
     msg(MsgBadFormat, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // read/save format chunk data in instance data
-  WavFmtChunk fmtChunk;
-  bytes = fread(&fmtChunk, 1, chunkHdr.chunkSize, inst.file);
-  if (bytes != chunkHdr.chunkSize) {
-    msg(MsgBadRead, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // validate allowed format -- only PCM is supported for now
-  if (fmtChunk.fmtCode != FmtPCM) {
-    msg(MsgBadFormat, filename);
-    fclose(inst.file);
     return;
   }
 
-  // only mono or stereo allowed
-  if (fmtChunk.nbrChannels > 2) {
-    msg(MsgBadFormat, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // set amplitude nomalization for bit depth -- commented code remains for
-  // possible component enhancements
-  switch (fmtChunk.bitsPerSample) {
-    //	case 8: maxAmplitude = 0x7F; break;
-  case 16:
-    // inst.maxAmplitude   = 0x7fff;
-    inst.maxAmplitude   = 0x8000;
-    inst.getSample      = getSample16;
-    inst.bytesPerSample = 2;
-    break;
-    //	case 20: inst.maxAmplitude = 0x07FFFF; break;
-  case 24:
-    // inst.maxAmplitude   = 0x7FFFFF;
-    inst.maxAmplitude   = 0x800000;
-    inst.getSample      = getSample24;
-    inst.bytesPerSample = 3;
-    break;
-    //	case 32: inst.maxAmplitude = 0x7FFFFFFF; break;
-  default:
-    msg(MsgBadFormat, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // finally, get the data chunk (should be next)
-  bytes = fread(&chunkHdr, 1, sizeof(chunkHdr), inst.file);
-  if (bytes != sizeof(chunkHdr)) {
-    msg(MsgBadRead, filename);
-    fclose(inst.file);
-    return;
-  }
-
-  // if not "data", not expected/handled
-  if (memcmp(chunkHdr.format, "data", 4)) {
-    msg(MsgBadFormat, filename);
-    fclose(inst.file);
-    return;
-  }
+  // set amplitude nomalization for bit depth (16- or 24-bit)
+  inst.maxAmplitude = 1 << (inst.wav.bitsPerSample - 1);
 
   // save values in instance data
-  inst.nbrChannels = fmtChunk.nbrChannels;
-  inst.nbrSamples = chunkHdr.chunkSize / inst.bytesPerSample / inst.nbrChannels;
-  inst.sampleTimeIncr = 1.0 / fmtChunk.samplesPerSec;
+  inst.sampleTimeIncr = 1.0 / inst.wav.samplesPerSec;
   inst.nextSampleTime = 0.0;
   inst.nextSampleIncr = inst.sampleTimeIncr;
   inst.maxLoops = loops < 1 ? INT_MAX : loops;   // technically not infinity
   inst.lastCh1 = inst.lastCh2 = 0.0;
   inst.gain                   = gain;
 
-  // in theory, the file is positioned at the start of the sample data.  save
-  // the position for looping...
-  if (fgetpos(inst.file, &inst.startOfData)) {
-    msg(MsgBadRead, filename);
-    fclose(inst.file);
-    inst.lastCh1 = inst.lastCh2 = 0.0;
-    return;
-  }
-
   // in theory, we're ready to start reading samples
   inst.fileState = FileOpen;
 
   // msg("Using WAV file=\"%s\", loops=%d, gain=%f\n", filename, loops, gain);
   msg("WAV Metadata: # of Channels=%d, Bit Depth=%d, Sample Rate=%dHz, # of "
       "Samples=%d\n",
-      inst.nbrChannels, inst.bytesPerSample * 8, fmtChunk.samplesPerSec,
-      inst.nbrSamples);
+      inst.wav.nbrChannels, inst.wav.bitsPerSample, inst.wav.samplesPerSec,
+      inst.wav.nbrSamples);
 }
 
 /*------------------------------------------------------------------------------
@@ -364,14 +250,14 @@ void getSample(InstData &inst, double t, const char *filename) {
   if (inst.fileState != FileOpen) return;
 
   // have we reached the end of data?
-  if (inst.sampleCnt >= inst.nbrSamples) {
+  if (inst.sampleCnt >= inst.wav.nbrSamples) {
     // a loop finished
     inst.loopCnt++;
     inst.sampleCnt = 0;
 
     // do we have more loops to do?
     if (inst.loopCnt >= inst.maxLoops) {
-      fclose(inst.file);
+      wavClose(inst.wav);
       inst.fileState = FileClosed;
       // we won't be reading again anytime soon
       inst.nextSampleTime = inst.nextSampleIncr = 1e308;
@@ -379,36 +265,34 @@ void getSample(InstData &inst, double t, const char *filename) {
     }
 
     // reposition file to start of data for looping
-    if (fsetpos(inst.file, &inst.startOfData)) {
-      fclose(inst.file);
+    if (!wavRewind(inst.wav)) {
+      wavClose(inst.wav);
       inst.fileState = FileClosed;
       return;
     }
   }
 
   // get first channel sample
-  inst.lastCh1 = inst.lastCh2 = inst.getSample(inst, filename);
+  inst.lastCh1 = inst.lastCh2 = getChannel(inst, filename);
 
   // if stereo, get the other channel sample
-  if (inst.nbrChannels == 2) inst.lastCh2 = inst.getSample(inst, filename);
+  if (inst.wav.nbrChannels == 2) inst.lastCh2 = getChannel(inst, filename);
 
   // calculate next sample time adjusting for loop count
-  inst.nextSampleTime = ((inst.loopCnt * inst.nbrSamples) + ++inst.sampleCnt) *
+  inst.nextSampleTime =
+      ((inst.loopCnt * inst.wav.nbrSamples) + ++inst.sampleCnt) *
       inst.sampleTimeIncr;
   inst.nextSampleIncr = inst.nextSampleTime - t;
 }
 
 /*------------------------------------------------------------------------------
- * getSample16() - gets the next 16-bit value from the file and normalizes it
- * to +/-1.0.
+ * getChannel() - gets the next single-channel sample from the file and
+ * normalizes it to +/-1.0.
  *----------------------------------------------------------------------------*/
-// TODO:  Combine getSample16() & getSample24() and eliminate function
-// indirection?
-double getSample16(InstData &inst, const char *filename) {
-  int16_t sampleVal;
+double getChannel(InstData &inst, const char *filename) {
+  int32_t sampleVal;
 
-  int bytes = fread(&sampleVal, 1, sizeof(int16_t), inst.file);
-  if (bytes < sizeof(sampleVal)) {
+  if (!wavReadSample(inst.wav, sampleVal)) {
     inst.fileState = FileError;
     msg(MsgBadRead, filename);
     return 0.0;
@@ -420,34 +304,6 @@ double getSample16(InstData &inst, const char *filename) {
 
   return retVal;
 }
-
-/*------------------------------------------------------------------------------
- * getSample24() - gets the next 24-bit value from the file and normalizes it
- * to +/-1.0.
- *----------------------------------------------------------------------------*/
-double getSample24(InstData &inst, const char *filename) {
-  // PCM data is in Intel native/little-endian format... twiddle the bits...
-  union {
-    int32_t i32;
-    int8_t  b[4];
-  } buf;
-
-  // read 24-bit sample bytes
-  if (fread(&buf, 1, 3, inst.file) != 3) {
-    inst.fileState = FileError;
-    msg(MsgBadRead, filename);
-    return 0.0;
-  }
-
-  // set high byte for sign extension
-  buf.b[3] = buf.b[2] & 0x80 ? 0xff : 0x00;
-
-  // normalize & limit
-  double retVal = buf.i32 / inst.maxAmplitude;
-  retVal        = std::max(std::min(retVal, 1.0), -1.0);
-
-  return retVal;
-}
 /*==============================================================================
  * EOF WavSrc.cpp
  *============================================================================*/
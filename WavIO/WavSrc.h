@@ -8,6 +8,8 @@
 #define WAVSRC_H_
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 
 struct WavFileHeaderChunk {
   char    groupID[4];    // "RIFF"
@@ -62,6 +64,114 @@ union WavDataChunk {
 };
 typedef WavDataChunk *pWavDataChunk;
 
+/*
+ * WAV file reader -- the decoding path shared by WavSrc and the components
+ * that reuse it (e.g., I2sSrc).  Parses through the fmt chunk to the start of
+ * the sample data and returns raw, sign-extended PCM samples.
+ */
+enum WavStatus { WavOK, WavBadOpen, WavBadRead, WavBadFormat };
+
+struct WavReader {
+  FILE    *file;             // file stream pointer for WAV data
+  fpos_t   startOfData;      // file position of start of data for looping
+  uint32_t nbrSamples;       // # of samples (per channel) in file
+  int32_t  samplesPerSec;    // sample rate
+  int      nbrChannels;      // number of channels per sample
+  int      bitsPerSample;    // 16 or 24
+  int      bytesPerSample;   // bytes in each data sample
+};
+typedef WavReader *pWavReader;
+
+/*
+ * wavOpen() -- opens the file & positions it at the start of the sample data.
+ * on failure, the file is closed and the error status returned.
+ */
+inline WavStatus wavOpen(WavReader &rdr, const char *filename) {
+  WavFileHeaderChunk fileHdr;
+  WavChunkHeader     chunkHdr;
+  WavFmtChunk        fmtChunk;
+  WavStatus          status = WavOK;
+
+  // open the WAV file
+  if (!(rdr.file = fopen(filename, "rb"))) return WavBadOpen;
+
+  // read file header info & check for supported file type
+  if (fread(&fileHdr, 1, sizeof(fileHdr), rdr.file) != sizeof(fileHdr))
+    status = WavBadRead;
+  else if (memcmp(fileHdr.groupID, "RIFF", 4) ||
+           memcmp(fileHdr.riffType, "WAVE", 4))
+    status = WavBadFormat;
+
+  // next chunk header should be a format chunk of an expected size
+  else if (fread(&chunkHdr, 1, sizeof(chunkHdr), rdr.file) != sizeof(chunkHdr))
+    status = WavBadRead;
+  else if (memcmp(chunkHdr.format, "fmt ", 4) ||
+           (chunkHdr.chunkSize != 16 && chunkHdr.chunkSize != 18 &&
+               chunkHdr.chunkSize != 40))
+    status = WavBadFormat;
+
+  // read format chunk data -- only 16/24-bit, mono/stereo PCM is supported
+  else if (fread(&fmtChunk, 1, chunkHdr.chunkSize, rdr.file) !=
+           chunkHdr.chunkSize)
+    status = WavBadRead;
+  else if (fmtChunk.fmtCode != FmtPCM || fmtChunk.nbrChannels > 2 ||
+           (fmtChunk.bitsPerSample != 16 && fmtChunk.bitsPerSample != 24))
+    status = WavBadFormat;
+
+  // finally, get the data chunk (should be next)
+  else if (fread(&chunkHdr, 1, sizeof(chunkHdr), rdr.file) != sizeof(chunkHdr))
+    status = WavBadRead;
+  else if (memcmp(chunkHdr.format, "data", 4))
+    status = WavBadFormat;
+
+  // save the position of the start of the sample data for looping
+  else if (fgetpos(rdr.file, &rdr.startOfData))
+    status = WavBadRead;
+
+  if (status != WavOK) {
+    fclose(rdr.file);
+    rdr.file = 0;
+    return status;
+  }
+
+  rdr.nbrChannels    = fmtChunk.nbrChannels;
+  rdr.samplesPerSec  = fmtChunk.samplesPerSec;
+  rdr.bitsPerSample  = fmtChunk.bitsPerSample;
+  rdr.bytesPerSample = fmtChunk.bitsPerSample / 8;
+  rdr.nbrSamples = chunkHdr.chunkSize / rdr.bytesPerSample / rdr.nbrChannels;
+  return WavOK;
+}
+
+/*
+ * wavRewind() -- reposition to the start of the sample data for looping
+ */
+inline bool wavRewind(WavReader &rdr) {
+  return !fsetpos(rdr.file, &rdr.startOfData);
+}
+
+/*
+ * wavReadSample() -- read the next single-channel sample.  PCM data is in
+ * Intel native/little-endian format; the value is sign-extended to 32 bits
+ * (i.e., +/-0x8000 full scale for 16-bit, +/-0x800000 for 24-bit).
+ */
+inline bool wavReadSample(WavReader &rdr, int32_t &val) {
+  uint8_t b[3];
+
+  if (fread(b, 1, rdr.bytesPerSample, rdr.file) != (size_t)rdr.bytesPerSample)
+    return false;
+
+  // 24-bit samples are assembled in the high bytes; the shift sign-extends
+  if (rdr.bytesPerSample == 2) val = (int16_t)(b[0] | (b[1] << 8));
+  else
+    val = (int32_t)((b[0] << 8) | (b[1] << 16) | ((uint32_t)b[2] << 24)) >> 8;
+  return true;
+}
+
+inline void wavClose(WavReader &rdr) {
+  if (rdr.file) fclose(rdr.file);
+  rdr.file = 0;
+}
+
 #endif /* WAVSRC_H_ */
 /*==============================================================================
  * EOF WavSrc.h